@@ -0,0 +1,162 @@
+/* Yash: yet another shell */
+/* arena.c: bump allocator for short-lived objects */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "arena.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "util.h"
+
+
+#if DEBUG_ARENA   /* For debugging */
+# define DEBUG_COUNT(counter) ((void) (counter)++)
+# include <stdio.h>
+static unsigned long allocation_count, chunk_count;
+static unsigned long start_xmalloc_count, start_xrealloc_count;
+static unsigned heap_count_depth;
+unsigned long xmalloc_count, xrealloc_count;
+#else
+# define DEBUG_COUNT(counter) ((void) 0)
+#endif
+
+
+/* type that has the strictest alignment requirement */
+typedef union arenaalign_T {
+    long double ld;
+    intmax_t i;
+    void *p;
+    void (*f)(void);
+} arenaalign_T;
+
+/* memory chunk from which objects are allocated */
+struct arenachunk_T {
+    struct arenachunk_T *prev; /* the chunk used before this one */
+    size_t size;               /* number of bytes in `data' */
+    arenaalign_T data[];
+};
+
+/* The size of normal chunks.
+ * An object larger than this is allocated in a chunk of its own. */
+#define ARENA_CHUNK_SIZE 4096
+
+static void add_chunk(arena_T *a, size_t size)
+    __attribute__((nonnull));
+
+
+/* Allocates `size' bytes in the arena.
+ * The result is suitably aligned for any type. It remains valid until the
+ * arena is released to a mark taken before this allocation. */
+void *arena_alloc(arena_T *a, size_t size)
+{
+    size = mul(add(size, sizeof (arenaalign_T) - 1) / sizeof (arenaalign_T),
+	    sizeof (arenaalign_T));
+    if (a->chunk == NULL || a->chunk->size - a->used < size)
+	add_chunk(a, size);
+
+    void *result = (char *) a->chunk->data + a->used;
+    a->used += size;
+    DEBUG_COUNT(allocation_count);
+    return result;
+}
+
+/* Makes a new chunk that has at least `size' bytes available as the current
+ * chunk of the arena. */
+void add_chunk(arena_T *a, size_t size)
+{
+    struct arenachunk_T *chunk;
+    if (size <= ARENA_CHUNK_SIZE && a->spare != NULL) {
+	chunk = a->spare;
+	a->spare = NULL;
+    } else {
+	if (size < ARENA_CHUNK_SIZE)
+	    size = ARENA_CHUNK_SIZE;
+	chunk = xmallocs(sizeof *chunk, size, 1);
+	chunk->size = size;
+	DEBUG_COUNT(chunk_count);
+    }
+    chunk->prev = a->chunk;
+    a->chunk = chunk;
+    a->used = 0;
+}
+
+/* Copies at most `maxlen' characters of wide string `s' into the arena.
+ * The copy is always null-terminated. */
+wchar_t *arena_wcsndup(arena_T *a, const wchar_t *s, size_t maxlen)
+{
+    size_t len = xwcsnlen(s, maxlen);
+    wchar_t *result = arena_alloc(a, mul(add(len, 1), sizeof *result));
+    result[len] = L'\0';
+    return wmemcpy(result, s, len);
+}
+
+/* Copies `size' bytes from `p' into the arena. */
+void *arena_memdup(arena_T *a, const void *p, size_t size)
+{
+    return memcpy(arena_alloc(a, size), p, size);
+}
+
+/* Frees all the objects allocated in the arena after `mark' was taken.
+ * One normal chunk is kept for reuse. */
+void arena_release(arena_T *a, const arenamark_T *mark)
+{
+    while (a->chunk != mark->chunk) {
+	struct arenachunk_T *chunk = a->chunk;
+	assert(chunk != NULL);
+	a->chunk = chunk->prev;
+	if (a->spare == NULL && chunk->size == ARENA_CHUNK_SIZE)
+	    a->spare = chunk;
+	else
+	    free(chunk);
+    }
+    a->used = mark->used;
+}
+
+#if DEBUG_ARENA
+
+/* Starts or stops counting the heap allocations made by `xmalloc' and
+ * `xrealloc'. The counts are printed with the statistics of the arena when the
+ * outermost count stops. This function is used in debugging. */
+void arena_count_heap(const arena_T *a, bool start)
+{
+    if (start) {
+	if (heap_count_depth++ == 0) {
+	    start_xmalloc_count = xmalloc_count;
+	    start_xrealloc_count = xrealloc_count;
+	}
+	return;
+    }
+
+    assert(heap_count_depth > 0);
+    if (--heap_count_depth > 0)
+	return;
+    fprintf(stderr, "DEBUG: arena id=%p: %lu allocations, "
+	    "%lu chunk mallocs; heap: %lu mallocs, %lu reallocs\n",
+	    (void *) a, allocation_count, chunk_count,
+	    xmalloc_count - start_xmalloc_count,
+	    xrealloc_count - start_xrealloc_count);
+    allocation_count = chunk_count = 0;
+}
+
+#endif /* DEBUG_ARENA */
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -0,0 +1,77 @@
+/* Yash: yet another shell */
+/* arena.h: bump allocator for short-lived objects */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_ARENA_H
+#define YASH_ARENA_H
+
+#include <stddef.h>
+#include "util.h"
+
+
+/* If DEBUG_ARENA is defined non-zero in util.h, statistics of the arena and of
+ * the heap allocations made during word expansion are printed after each
+ * expansion. */
+
+/* An arena allocates objects by bumping a pointer in a chunk of memory.
+ * Objects cannot be freed one by one. Instead, all the objects allocated after
+ * a mark are freed at once when the arena is released to the mark. */
+typedef struct arena_T {
+    struct arenachunk_T *chunk;   /* the current chunk (or NULL) */
+    size_t used;                  /* number of bytes used in `chunk' */
+    struct arenachunk_T *spare;   /* a free chunk kept for reuse */
+} arena_T;
+#define ARENA_INIT { NULL, 0, NULL }
+
+/* A position in an arena. */
+typedef struct arenamark_T {
+    struct arenachunk_T *chunk;
+    size_t used;
+} arenamark_T;
+
+extern void *arena_alloc(arena_T *a, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern wchar_t *arena_wcsndup(arena_T *a, const wchar_t *s, size_t maxlen)
+    __attribute__((nonnull,malloc,warn_unused_result));
+extern void *arena_memdup(arena_T *a, const void *p, size_t size)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static inline arenamark_T arena_mark(const arena_T *a)
+    __attribute__((nonnull,pure));
+extern void arena_release(arena_T *a, const arenamark_T *mark)
+    __attribute__((nonnull));
+
+#if DEBUG_ARENA
+extern void arena_count_heap(const arena_T *a, _Bool start)
+    __attribute__((nonnull));
+# define ARENA_COUNT_HEAP(a, start) arena_count_heap(a, start)
+#else
+# define ARENA_COUNT_HEAP(a, start) ((void) 0)
+#endif
+
+
+/* Returns the current position of the arena, to which the arena can be
+ * released later. */
+arenamark_T arena_mark(const arena_T *a)
+{
+    return (arenamark_T) { a->chunk, a->used };
+}
+
+
+#endif /* YASH_ARENA_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -164,7 +164,7 @@ void init_builtin(void)
     DEFBUILTIN("bg", fg_builtin, BI_MANDATORY, bg_help, bg_syntax,
 	    help_option);
     DEFBUILTIN("wait", wait_builtin, BI_MANDATORY, wait_help, wait_syntax,
-	    help_option);
+	    wait_options);
     DEFBUILTIN("disown", disown_builtin, BI_ELECTIVE, disown_help,
 	    disown_syntax, all_help_options);
 
@@ -193,7 +193,9 @@ void init_builtin(void)
     DEFBUILTIN("type", command_builtin, BI_MANDATORY, type_help, type_syntax,
 	    command_options);
     DEFBUILTIN("times", times_builtin, BI_SPECIAL, times_help, times_syntax,
-	    help_option);
+	    times_options);
+    DEFBUILTIN("parmap", parmap_builtin, BI_EXTENSION, parmap_help,
+	    parmap_syntax, parmap_options);
 
     /* defined in "yash.c" */
     DEFBUILTIN("exit", exit_builtin, BI_SPECIAL, exit_help, exit_syntax,
@@ -299,14 +301,16 @@ int too_many_operands_error(size_t max_accepted_operand_count)
 /* This function is called when an error occurred while executing a special
  * built-in. If `posixly_correct' and `special_builtin_executed' are true and
  * `is_interactive_now' is false, `exit_shell_with_status' is called with
- * `exitstatus'. Otherwise, this function just returns `exitstatus'. */
+ * `exitstatus' (or only the subshell exits if it is executed in the shell
+ * process). Otherwise, this function just returns `exitstatus'. */
 /* Even though this function is called only while executing a special built-in,
  * checking `special_builtin_executed' is necessary because
  * `exit_shell_with_status' should not be called if the special built-in is
  * being executed indirectly by a non-special built-in. */
 int special_builtin_error(int exitstatus)
 {
-    if (posixly_correct && special_builtin_executed && !is_interactive_now)
+    if (posixly_correct && special_builtin_executed && !is_interactive_now
+	    && !exit_inline_subshell(exitstatus))
 	exit_shell_with_status(exitstatus);
     return exitstatus;
 }
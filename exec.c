@@ -30,15 +30,20 @@
 # include <paths.h>
 #endif
 #include <signal.h>
+#if HAVE_POSIX_SPAWN
+# include <spawn.h>
+#endif
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/times.h>
 #include <unistd.h>
 #include <wchar.h>
 #include "alias.h"
+#include "arena.h"
 #include "builtin.h"
 #include "expand.h"
 #if YASH_ENABLE_HISTORY
@@ -57,7 +62,10 @@
 #include "variable.h"
 #include "xfnmatch.h"
 #include "yash.h"
-#if YASH_ENABLE_DOUBLE_BRACKET
+#if YASH_ENABLE_PRINTF
+# include "builtins/printf.h"
+#endif
+#if YASH_ENABLE_DOUBLE_BRACKET || YASH_ENABLE_TEST
 # include "builtins/test.h"
 #endif
 #if YASH_ENABLE_LINEEDIT
@@ -115,6 +123,14 @@ typedef struct commandinfo_T {
 #define ci_builtin  value.builtin
 #define ci_function value.function
 
+/* result of command search cached in a simple command whose command name is a
+ * literal word */
+struct cmdcache_T {
+    unsigned long generation;  /* value of `cmdsearch_generation' */
+    bool posix;                /* value of `posixly_correct' */
+    commandinfo_T info;
+};
+
 /* result of `fork_and_wait' */
 typedef struct fork_and_wait_T {
     pid_t cpid;       /* child process ID */
@@ -127,6 +143,7 @@ typedef enum exception_T {
     E_RETURN,
     E_BREAK_ITERATION,
     E_CONTINUE_ITERATION,
+    E_EXIT_SUBSHELL,
 } exception_T;
 
 /* state of currently executed loop */
@@ -137,6 +154,111 @@ typedef struct execstate_T {
     bool iterating;         /* true when iterative execution is ongoing */
 } execstate_T;
 
+/* function call in a tail position deferred to `exec_function_body' */
+typedef struct tailcall_T {
+    command_T *body;  /* body of the function to call (NULL if none) */
+    void **args;      /* arguments to the function */
+} tailcall_T;
+
+/* state of the shell that a subshell executed in the shell process may change
+ * and that has to be restored afterwards */
+typedef struct inlineinfo_T {
+    plist_T names;  /* names of variables that may be assigned */
+    bool chdir;     /* true if the working directory may be changed */
+    bool umask;     /* true if the umask may be changed */
+    bool forks;     /* true if a child process may be created */
+} inlineinfo_T;
+
+/* operation of an instruction of bytecode (see `run_bytecode') */
+typedef enum opcode_T {
+    OP_END,             /* end of the code */
+    OP_JUMP,            /* jump to `target' */
+    OP_JUMP_IF_SUCCESS, /* jump to `target' if `laststatus' is zero */
+    OP_JUMP_IF_FAILURE, /* jump to `target' if `laststatus' is non-zero */
+    OP_CHECK,           /* jump to `target' if `need_break' is true */
+    OP_COMMANDS,        /* execute the pipeline `command' */
+    OP_ASYNC,           /* execute the pipelines asynchronously */
+    OP_SIMPLE,          /* execute the simple command `simple' */
+    OP_LINENO,          /* start executing the command `command' */
+    OP_AFTER,           /* finish executing the command `command' */
+    OP_SUPPRESS,        /* save and set the suppression of "errexit" */
+    OP_RESTORE,         /* restore the suppression of "errexit" */
+    OP_NEGATE,          /* negate `laststatus' */
+    OP_SET_SUCCESS,     /* set `laststatus' to zero */
+    OP_HANDLE_SIGNALS,  /* handle pending signals */
+    OP_LOOP_ENTER,      /* enter a loop */
+    OP_LOOP_CHECK,      /* jump to `target' to break or `target2' to continue */
+    OP_LOOP_LEAVE,      /* leave a loop */
+    OP_SAVE_STATUS,     /* save `laststatus' in the slot */
+    OP_CLEAR_STATUS,    /* set the status in the slot to zero */
+    OP_LOAD_STATUS,     /* set `laststatus' to the status in the slot */
+    OP_JUMP_IF_ZERO,    /* jump to `target' if the status in the slot is 0 */
+    OP_JUMP_IF_NONZERO, /* jump to `target' unless the status in the slot is 0*/
+    OP_FOR_BEGIN,       /* expand the words of the for command `command' */
+    OP_FOR_NEXT,        /* assign the next word or jump to `target' if none */
+    OP_FOR_END,         /* free the words that were not assigned */
+    OP_CASE_BEGIN,      /* expand the word of the case command `command' */
+    OP_CASE_MATCH,      /* jump to `target' if the word matches `pattern' */
+    OP_CASE_END,        /* free the expanded word */
+} opcode_T;
+
+/* kind of a word of a compiled simple command (see `classify_word') */
+typedef enum wordkind_T {
+    WK_EXPAND,   /* needs the full word expansion */
+    WK_LITERAL,  /* expands to the word itself */
+    WK_PARAM,    /* "$name", which expands to the value of the variable */
+} wordkind_T;
+
+/* simple command compiled with the kinds of its words */
+typedef struct simplecommand_T {
+    command_T *command;
+    wordkind_T kinds[];  /* one for each word of the command */
+} simplecommand_T;
+
+/* instruction of bytecode */
+typedef struct insn_T {
+    opcode_T opcode;
+    unsigned slot;            /* index of the slot used by the instruction */
+    size_t target, target2;   /* indices of the instructions to jump to */
+    union {
+	command_T *command;
+	const pipeline_T *pipelines;
+	const wordunit_T *pattern;
+	simplecommand_T *simple;
+    } operand;
+} insn_T;
+
+/* bytecode compiled from a command (see `compile_command') */
+struct bytecode_T {
+    unsigned slotcount;  /* number of slots used by the instructions */
+    insn_T insns[];      /* instructions terminated by `OP_END' */
+};
+
+/* temporary value used while running bytecode */
+typedef union slot_T {
+    struct {
+	bool see, ser;   /* saved `suppresserrexit' and `suppresserrreturn' */
+    } suppress;
+    int status;
+    struct {
+	void **words;    /* expanded words of the for command */
+	int count;       /* number of `words' */
+	int index;       /* index of the next word to assign */
+	bool exit;       /* true if the shell should exit after the loop */
+    } forloop;
+    wchar_t *word;       /* expanded word of the case command */
+} slot_T;
+
+/* state of compilation of bytecode */
+typedef struct compiler_T {
+    struct bytecode_T *code;
+    size_t length, capacity;  /* number of instructions in and size of `code' */
+    size_t *labels;           /* indices of instructions that labels point to */
+    size_t labelcount, labelcapacity;
+    unsigned slotcount;
+} compiler_T;
+#define NO_LABEL SIZE_MAX
+
 static void exec_pipelines(const pipeline_T *p, bool finally_exit);
 static void exec_pipelines_async(const pipeline_T *p)
     __attribute__((nonnull));
@@ -156,17 +278,27 @@ static inline void next_pipe(pipeinfo_T *pi, bool next)
     __attribute__((nonnull));
 static inline void connect_pipes(pipeinfo_T *pi)
     __attribute__((nonnull));
+static bool is_inlinable_stage(const command_T *cs, inlineinfo_T *info)
+    __attribute__((nonnull,warn_unused_result));
+static void exec_last_command_in_process(
+	command_T *cs, int fd, inlineinfo_T *info)
+    __attribute__((nonnull(1)));
 
 static void exec_one_command(command_T *c, bool finally_exit)
     __attribute__((nonnull));
-static void exec_simple_command(const command_T *c, bool finally_exit)
+static void exec_simple_command(command_T *c, bool finally_exit)
     __attribute__((nonnull));
 static bool exec_simple_command_without_words(const command_T *c)
     __attribute__((nonnull,warn_unused_result));
-static bool exec_simple_command_with_words(
-	const command_T *c, int argc, void **argv, bool finally_exit)
-    __attribute__((nonnull,warn_unused_result));
+static bool exec_simple_command_with_words(command_T *c,
+	int argc, void **argv, char *const *mbswords, bool finally_exit)
+    __attribute__((nonnull(1,3),warn_unused_result));
 static void print_xtrace(void *const *argv);
+static const commandinfo_T *get_cached_command(const command_T *c)
+    __attribute__((nonnull,pure));
+static void cache_command(
+	command_T *c, const commandinfo_T *ci, unsigned long generation)
+    __attribute__((nonnull));
 static void search_command(
 	const char *restrict name, const wchar_t *restrict wname,
 	commandinfo_T *restrict ci, enum srchcmdtype_T type)
@@ -176,10 +308,21 @@ static inline bool is_special_builtin(const char *cmdname)
 static bool command_not_found_handler(void *const *argv)
     __attribute__((nonnull));
 static wchar_t **invoke_simple_command(const commandinfo_T *ci,
-	int argc, char *argv0, void **argv, bool finally_exit)
-    __attribute__((nonnull,warn_unused_result));
-static void exec_external_program(
-	const char *path, int argc, char *argv0, void **argv, char **envs)
+	int argc, char *argv0, void **argv, char *const *mbswords,
+	bool finally_exit)
+    __attribute__((nonnull(1,3,4),warn_unused_result));
+static void exec_external_program(const char *path, int argc, char *argv0,
+	void **argv, char *const *mbswords, char **envs)
+    __attribute__((nonnull(1,3,4,6)));
+#if HAVE_POSIX_SPAWN
+static bool spawn_and_wait(const char *path, int argc, char *argv0,
+	void **argv, char *const *mbswords, char **envs, fork_and_wait_T *faw)
+    __attribute__((nonnull(1,3,4,6,7),warn_unused_result));
+#endif
+static void to_mbs_argv(char **mbsargv, int argc, char *argv0,
+	void **argv, char *const *mbswords)
+    __attribute__((nonnull(1,3,4)));
+static void print_exec_error(int errnum, const char *path, const char *argv0)
     __attribute__((nonnull));
 static inline int xexecve(
 	const char *path, char *const *argv, char *const *envp)
@@ -190,6 +333,13 @@ static void exec_fall_back_on_sh(
 static void exec_function_body(
 	command_T *body, void *const *args, bool finally_exit, bool complete)
     __attribute__((nonnull));
+static bool is_tail_call(const command_T *c)
+    __attribute__((nonnull,pure));
+static bool is_in_tail_position(const command_T *c, const command_T *body)
+    __attribute__((nonnull,pure));
+static bool is_in_tail_position_of_lists(
+	const command_T *c, const and_or_T *a)
+    __attribute__((nonnull(1),pure));
 
 static void exec_nonsimple_command(command_T *c, bool finally_exit)
     __attribute__((nonnull));
@@ -204,11 +354,116 @@ static void exec_case(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
 static void exec_funcdef(const command_T *c, bool finally_exit)
     __attribute__((nonnull));
+static void exec_coproc(command_T *c, bool finally_exit)
+    __attribute__((nonnull));
+static int move_to_high_fd(int fd);
 
 static fork_and_wait_T fork_and_wait(sigtype_T sigtype)
     __attribute__((warn_unused_result));
 static void become_child(sigtype_T sigtype);
 
+static wchar_t *substitute_file_contents(const redir_T *r)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static int copy_file_to_stdout(const redir_T *r)
+    __attribute__((nonnull));
+static wchar_t *substitute_in_process(const and_or_T *cmds)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wchar_t *read_command_substitution_output(int fd)
+    __attribute__((malloc,warn_unused_result));
+static bool is_pure_and_or_lists(const and_or_T *a, unsigned depth)
+    __attribute__((warn_unused_result));
+static bool is_pure_command(const command_T *c, unsigned depth)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_pure_simple_command(const command_T *c, unsigned depth)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_pure_builtin(main_T *body)
+    __attribute__((nonnull,const,warn_unused_result));
+static bool is_pure_redirections(const redir_T *r)
+    __attribute__((warn_unused_result));
+static bool is_pure_words(void *const *words)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_pure_word(const wordunit_T *w)
+    __attribute__((warn_unused_result));
+static bool is_pure_paramexp(const paramexp_T *p)
+    __attribute__((nonnull,warn_unused_result));
+static bool search_literal_command(const command_T *c, commandinfo_T *ci)
+    __attribute__((nonnull,warn_unused_result));
+
+static bool exec_subshell_in_process(command_T *c)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_inlining_possible(void)
+    __attribute__((pure,warn_unused_result));
+static bool exec_inline(command_T *c, bool subshell, inlineinfo_T *info)
+    __attribute__((nonnull));
+static bool is_inlinable_and_or_lists(
+	const and_or_T *a, inlineinfo_T *info, unsigned depth)
+    __attribute__((nonnull(2),warn_unused_result));
+static bool is_inlinable_command(
+	const command_T *c, inlineinfo_T *info, unsigned depth)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_inlinable_simple_command(
+	const command_T *c, inlineinfo_T *info, unsigned depth)
+    __attribute__((nonnull,warn_unused_result));
+static bool is_inlinable_builtin(
+	main_T *body, const command_T *c, inlineinfo_T *info)
+    __attribute__((nonnull,warn_unused_result));
+static bool add_inline_operands(
+	const command_T *c, bool unset, inlineinfo_T *info)
+    __attribute__((nonnull,warn_unused_result));
+static bool add_inline_variable(inlineinfo_T *info, wchar_t *name)
+    __attribute__((nonnull,warn_unused_result));
+
+static bool exec_compiled_command(command_T *c)
+    __attribute__((nonnull));
+static void compile_function_body(command_T *body)
+    __attribute__((nonnull));
+static bool is_compilable_command(const command_T *c)
+    __attribute__((nonnull,pure));
+static struct bytecode_T *compile_command(command_T *c)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static void compile_nonsimple_command(compiler_T *comp, command_T *c)
+    __attribute__((nonnull));
+static void compile_and_or_lists(compiler_T *comp, const and_or_T *a)
+    __attribute__((nonnull(1)));
+static void compile_pipelines(compiler_T *comp, const pipeline_T *p)
+    __attribute__((nonnull));
+static void compile_commands(compiler_T *comp, command_T *c)
+    __attribute__((nonnull));
+static simplecommand_T *compile_simple_command(command_T *c)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static wordkind_T classify_word(const command_T *c, size_t index)
+    __attribute__((nonnull,pure));
+static void compile_condition(compiler_T *comp, const and_or_T *a)
+    __attribute__((nonnull));
+static void compile_if(compiler_T *comp, const command_T *c)
+    __attribute__((nonnull));
+static void compile_for(compiler_T *comp, command_T *c)
+    __attribute__((nonnull));
+static void compile_while(compiler_T *comp, const command_T *c)
+    __attribute__((nonnull));
+static void compile_case(compiler_T *comp, command_T *c)
+    __attribute__((nonnull));
+static void compile_loop_check(
+	compiler_T *comp, size_t breaklabel, size_t continuelabel)
+    __attribute__((nonnull));
+static insn_T *emit(compiler_T *comp, opcode_T opcode)
+    __attribute__((nonnull));
+static unsigned new_slot(compiler_T *comp)
+    __attribute__((nonnull));
+static size_t new_label(compiler_T *comp)
+    __attribute__((nonnull));
+static void place_label(compiler_T *comp, size_t label)
+    __attribute__((nonnull));
+static void run_bytecode(const struct bytecode_T *code)
+    __attribute__((nonnull));
+static void exec_compiled_simple_command(const simplecommand_T *sc)
+    __attribute__((nonnull));
+static bool expand_compiled_words(const simplecommand_T *sc,
+	int *restrict argcp, void ***restrict argvp)
+    __attribute__((nonnull));
+static bool is_directly_callable_builtin(const commandinfo_T *ci)
+    __attribute__((nonnull,pure));
+
 static int exec_iteration(void *const *commands, const char *codename)
     __attribute__((nonnull));
 
@@ -224,6 +479,14 @@ int exitstatus = -1;  // -1 if not executing the EXIT trap
 /* the process ID of the last asynchronous list */
 pid_t lastasyncpid;
 
+/* This value is incremented whenever the result of command search may change,
+ * that is, when a function is defined or unset, $PATH is changed, or the
+ * command hashtable is modified. */
+unsigned long cmdsearch_generation;
+
+/* numbers of child processes created by `fork' and `posix_spawn' */
+static unsigned long fork_count, spawn_count;
+
 /* This flag is set to true while the shell is executing the condition of an if-
  * statement, an and-or list, etc. to suppress the effect of the "errexit" and
  * "errreturn" options. */
@@ -234,6 +497,19 @@ static execstate_T execstate;
 /* exceptional jump to be done (other than "break") */
 static exception_T exception;
 
+/* level of nested subshells that are executed in the shell process */
+static unsigned inline_subshell_level = 0;
+/* exit status of the subshell that is being left by `E_EXIT_SUBSHELL' */
+static int inline_subshell_status;
+
+/* body of the function being executed (NULL if none) */
+static const command_T *tailcall_body;
+/* true if a function call in a tail position of `tailcall_body' can be
+ * deferred to `exec_function_body' */
+static bool tailcall_deferrable;
+/* function call that has been deferred */
+static tailcall_T tailcall;
+
 /* This flag is set when a special built-in is executed as such. */
 bool special_builtin_executed;
 
@@ -294,6 +570,47 @@ void cancel_return(void)
 	exception = E_NONE;
 }
 
+/* Returns true iff a subshell is being executed in the shell process. */
+bool is_in_inline_subshell(void)
+{
+    return inline_subshell_level > 0;
+}
+
+/* If a subshell is being executed in the shell process, makes it exit with the
+ * specified status and returns true. If `status' is negative, `laststatus' is
+ * used. If not in such a subshell, does nothing and returns false. */
+bool exit_inline_subshell(int status)
+{
+    if (inline_subshell_level == 0)
+	return false;
+
+    inline_subshell_status = (status >= 0 ? status : laststatus) & 0xFF;
+    exception = E_EXIT_SUBSHELL;
+    return true;
+}
+
+/* Starts executing commands as if in a subshell executed in the shell process.
+ * Until the matching `leave_inline_subshell' call, the "exit" built-in and the
+ * "errexit" option end the subshell rather than the shell. */
+void enter_inline_subshell(void)
+{
+    inline_subshell_level++;
+}
+
+/* Ends the subshell started by `enter_inline_subshell'.
+ * If the subshell was left by `E_EXIT_SUBSHELL', `laststatus' is set to its
+ * exit status. Any exception is cleared. */
+void leave_inline_subshell(void)
+{
+    assert(inline_subshell_level > 0);
+    inline_subshell_level--;
+
+    /* Any exception ends at the boundary of the subshell. */
+    if (exception == E_EXIT_SUBSHELL)
+	laststatus = inline_subshell_status;
+    exception = E_NONE;
+}
+
 /* Returns true iff we're breaking/continuing/returning now. */
 bool need_break(void)
 {
@@ -368,7 +685,9 @@ void exec_pipelines_async(const pipeline_T *p)
 	ps->pr_pid = cpid;
 	ps->pr_status = JS_RUNNING;
 	ps->pr_statuscode = 0;
-	ps->pr_name = pipelines_to_wcs(p);
+	ps->pr_name = NULL; // The name is made from `pr_pipelines' when needed.
+	ps->pr_command = NULL;
+	ps->pr_pipelines = pipesdup(p);
 
 	job->j_pgid = doing_job_control_now ? cpid : 0;
 	job->j_status = JS_RUNNING;
@@ -407,6 +726,16 @@ void exec_commands(command_T *const cs, exec_T type)
 	goto done;
     }
 
+    /* decide whether to execute the last command in the shell process */
+    inlineinfo_T info;
+    bool lastpipe = false, inline_last = false;
+    if (type != E_ASYNC && !short_circuit && !doing_job_control_now) {
+	if (shopt_lastpipe)
+	    lastpipe = true;
+	else if (shopt_inlinesubshell)
+	    lastpipe = inline_last = is_inlinable_stage(cs, &info);
+    }
+
     /* fork a child process for each command in the pipeline */
     pid_t pgid = 0;
     pipeinfo_T pipe = PIPEINFO_INIT;
@@ -414,12 +743,24 @@ void exec_commands(command_T *const cs, exec_T type)
     command_T *c;
     process_T *p;
     int forkstatus = Exit_SUCCESS;
+    int lastfd = -1;
     for (c = cs, p = job->j_procs; c != NULL; c = c->next, p++) {
 	bool is_last = c->next == NULL;
 	next_pipe(&pipe, !is_last);
 
 	if (is_last && short_circuit)
 	    goto exec_one_command; /* skip forking */
+	if (is_last && lastpipe) {
+	    /* The command is executed after the job is established. */
+	    lastfd = pipe.pi_fromprevfd, pipe.pi_fromprevfd = -1;
+	    p->pr_pid = 0;
+	    p->pr_status = JS_DONE;
+	    p->pr_statuscode = Exit_SUCCESS;
+	    p->pr_name = NULL;
+	    p->pr_command = NULL;
+	    p->pr_pipelines = NULL;
+	    break;
+	}
 
 	sigtype_T sigtype = (type == E_ASYNC) ? t_quitint : 0;
 	pid_t pid = fork_and_reset(pgid, type == E_NORMAL, sigtype);
@@ -439,12 +780,16 @@ exec_one_command: /* child process */
 	    p->pr_status = JS_RUNNING;
 	    // p->pr_statuscode = ?; // The process is still running.
 	    p->pr_name = NULL; // The actual name is given later.
+	    p->pr_command = NULL;
+	    p->pr_pipelines = NULL;
 	} else {
 	    /* parent process: fork failed */
 	    p->pr_pid = 0;
 	    p->pr_status = JS_DONE;
 	    p->pr_statuscode = forkstatus = Exit_NOEXEC;
 	    p->pr_name = NULL;
+	    p->pr_command = NULL;
+	    p->pr_pipelines = NULL;
 	}
     }
 
@@ -461,6 +806,10 @@ exec_one_command: /* child process */
     job->j_nonotify = false;
     job->j_pcount = count;
     set_active_job(job);
+    if (lastpipe) {
+	exec_last_command_in_process(cs, lastfd, inline_last ? &info : NULL);
+	goto done;
+    }
     if (type != E_ASYNC) {
 	wait_for_job(ACTIVE_JOBNO, doing_job_control_now, false, false);
 	if (doing_job_control_now)
@@ -475,9 +824,9 @@ exec_one_command: /* child process */
 	notify_signaled_job(ACTIVE_JOBNO);
 	remove_job(ACTIVE_JOBNO);
     } else {
-	/* name the job processes */
+	/* name the job processes (the names are made when needed) */
 	for (c = cs, p = job->j_procs; c != NULL; c = c->next, p++)
-	    p->pr_name = command_to_wcs(c, false);
+	    p->pr_command = comsdup(c);
 
 	/* remember the suspended job */
 	add_job(type == E_NORMAL || shopt_curasync);
@@ -504,8 +853,11 @@ size_t number_of_commands_in_pipeline(const command_T *c)
  * exit or return if applicable. */
 void apply_errexit_errreturn(const command_T *c)
 {
-    if (is_errexit_condition() && is_err_condition_for(c))
+    if (is_errexit_condition() && is_err_condition_for(c)) {
+	if (exit_inline_subshell(laststatus))
+	    return;
 	exit_shell_with_status(laststatus);
+    }
     if (is_errreturn_condition() && is_err_condition_for(c))
 	exception = E_RETURN;
 }
@@ -553,6 +905,7 @@ bool is_err_condition_for(const command_T *c)
 	case CT_BRACKET:
 #endif
 	case CT_FUNCDEF:
+	case CT_COPROC:
 	    return true;
 	case CT_GROUP:
 	case CT_IF:
@@ -605,6 +958,7 @@ void next_pipe(pipeinfo_T *pi, bool next)
 		goto fail;
 	    }
 	}
+	apply_pipe_size(pi->pi_tonextfds[PIPE_OUT]);
     } else {
 	pi->pi_tonextfds[PIPE_IN] = pi->pi_tonextfds[PIPE_OUT] = -1;
     }
@@ -630,6 +984,60 @@ void connect_pipes(pipeinfo_T *pi)
 	xclose(pi->pi_tonextfds[PIPE_IN]);
 }
 
+/* Checks if the last command of the specified pipeline can be executed in the
+ * shell process as if it were in a subshell. The command must consist of
+ * built-ins only so that executing it without forking saves a child process.
+ * If successful, `*info' is filled for `exec_inline'. */
+bool is_inlinable_stage(const command_T *cs, inlineinfo_T *info)
+{
+    if (!is_inlining_possible())
+	return false;
+
+    while (cs->next != NULL)
+	cs = cs->next;
+
+    *info = (inlineinfo_T) { .chdir = false, .umask = false, .forks = false, };
+    pl_init(&info->names);
+    if (is_inlinable_command(cs, info, 0) && !info->chdir && !info->forks)
+	return true;
+    plfree(pl_toary(&info->names), free);
+    return false;
+}
+
+/* Executes the last command of the pipeline `cs' in the shell process with the
+ * standard input redirected from `fd', which is closed in this function.
+ * The active job must contain the other commands of the pipeline, which must
+ * have been started.
+ * If `info' is non-NULL, the command is executed as if in a subshell (see
+ * `exec_inline'). Otherwise, the effects of the command remain in the shell.
+ * `laststatus' is set to the exit status of the pipeline. */
+void exec_last_command_in_process(command_T *cs, int fd, inlineinfo_T *info)
+{
+    /* The job is detached from the job list while the command is executed so
+     * that the command cannot see the job by the "jobs" or "wait" built-in or
+     * a job specification. Its processes are still updated by `do_wait', so
+     * their status is not lost if the command starts another job. */
+    job_T *job = detach_active_job();
+    command_T *c = cs;
+    for (process_T *p = job->j_procs; c->next != NULL; c = c->next, p++)
+	p->pr_command = comsdup(c);
+
+    savefd_T *savefd;
+    redirect_stdin_from_pipe(fd, &savefd);
+    if (info != NULL)
+	exec_inline(c, false, info);
+    else
+	exec_one_command(c, false);
+    undo_redirections(savefd);
+
+    set_detached_active_job(job);
+    job->j_procs[job->j_pcount - 1].pr_statuscode = laststatus;
+    wait_for_job(ACTIVE_JOBNO, false, false, false);
+    laststatus = calc_status_of_job(job);
+    notify_signaled_job(ACTIVE_JOBNO);
+    remove_job(ACTIVE_JOBNO);
+}
+
 /* Executes the command. */
 void exec_one_command(command_T *c, bool finally_exit)
 {
@@ -660,14 +1068,16 @@ void exec_one_command(command_T *c, bool finally_exit)
 }
 
 /* Executes the simple command. */
-void exec_simple_command(const command_T *c, bool finally_exit)
+void exec_simple_command(command_T *c, bool finally_exit)
 {
     lastcmdsubstatus = Exit_SUCCESS;
 
     /* expand the command words */
     int argc;
     void **argv;
-    if (!expand_line(c->c_words, &argc, &argv)) {
+    char **mbswords;
+    if (!expand_command_words(
+		c->c_words, c->c_mbswords, &argc, &argv, &mbswords)) {
 	laststatus = Exit_EXPERROR;
 	goto done;
     }
@@ -678,11 +1088,12 @@ void exec_simple_command(const command_T *c, bool finally_exit)
     if (argc == 0)
 	finally_exit |= exec_simple_command_without_words(c);
     else
-	finally_exit |=
-	    exec_simple_command_with_words(c, argc, argv, finally_exit);
+	finally_exit |= exec_simple_command_with_words(
+		c, argc, argv, mbswords, finally_exit);
 
     /* cleanup */
 done1:
+    free(mbswords);
     plfree(argv, free);
 done:
     if (finally_exit)
@@ -699,7 +1110,7 @@ bool exec_simple_command_without_words(const command_T *c)
     last_assign = c->c_assigns;
     if (!ok) {
 	laststatus = Exit_ASSGNERR;
-	return !is_interactive_now;
+	return !is_interactive_now && !exit_inline_subshell(-1);
     }
 
     /* done? */
@@ -728,15 +1139,22 @@ bool exec_simple_command_without_words(const command_T *c)
  * `argv' must be a NULL-terminated array of pointers to wide strings that are
  * the results of the word expansion on the simple command being executed.
  * `argc' must be the number of words in `argv', which must be at least 1.
+ * `mbswords' is NULL or an array of `argc' pointers, each of which is NULL or
+ * the multibyte form of the corresponding element of `argv' that is used
+ * instead of converting the wide string (see `expand_command_words').
  * If `finally_exit' is true, the shell process may be replaced by the command
  * process. However, this function still may return in some cases.
  * Returns true if the shell should exit. */
-bool exec_simple_command_with_words(
-	const command_T *c, int argc, void **argv, bool finally_exit)
+bool exec_simple_command_with_words(command_T *c,
+	int argc, void **argv, char *const *mbswords, bool finally_exit)
 {
     assert(argc > 0);
 
-    char *argv0 = malloc_wcstombs(argv[0]);
+    char *argv0;
+    if (mbswords != NULL && mbswords[0] != NULL)
+	argv0 = xstrdup(mbswords[0]);
+    else
+	argv0 = malloc_wcstombs(argv[0]);
     if (argv0 == NULL)
 	argv0 = xstrdup("");
 
@@ -745,7 +1163,8 @@ bool exec_simple_command_with_words(
     if (!open_redirections(c->c_redirs, &savefd)) {
 	/* On redirection error, the command is not executed. */
 	laststatus = Exit_REDIRERR;
-	if (posixly_correct && !is_interactive_now && is_special_builtin(argv0))
+	if (posixly_correct && !is_interactive_now && is_special_builtin(argv0)
+		&& !exit_inline_subshell(-1))
 	    finally_exit = true;
 	goto done;
     }
@@ -753,8 +1172,13 @@ bool exec_simple_command_with_words(
     last_assign = c->c_assigns;
 
     /* check if the command is a special built-in or function */
+    unsigned long generation = cmdsearch_generation;
+    const commandinfo_T *cached = get_cached_command(c);
     commandinfo_T cmdinfo;
-    search_command(argv0, argv[0], &cmdinfo, SCT_BUILTIN | SCT_FUNCTION);
+    if (cached != NULL)
+	cmdinfo = *cached;
+    else
+	search_command(argv0, argv[0], &cmdinfo, SCT_BUILTIN | SCT_FUNCTION);
     special_builtin_executed = (cmdinfo.type == CT_SPECIALBUILTIN);
 
     /* open a temporary variable environment */
@@ -767,13 +1191,16 @@ bool exec_simple_command_with_words(
 	/* On assignment error, the command is not executed. */
 	print_xtrace(NULL);
 	laststatus = Exit_ASSGNERR;
-	if (!is_interactive_now)
+	if (!is_interactive_now && !exit_inline_subshell(-1))
 	    finally_exit = true;
 	goto done1;
     }
     print_xtrace(argv);
 
     /* find command path */
+    if (cmdinfo.type == CT_SUBSTITUTIVEBUILTIN
+	    && generation != cmdsearch_generation)
+	cmdinfo.type = CT_NONE;  /* $PATH was changed by the assignments */
     if (cmdinfo.type == CT_NONE) {
 	search_command(argv0, argv[0], &cmdinfo,
 		SCT_EXTERNAL | SCT_BUILTIN | SCT_CHECK);
@@ -786,10 +1213,27 @@ bool exec_simple_command_with_words(
 	    }
 	}
     }
+    if (cached == NULL && generation == cmdsearch_generation)
+	cache_command(c, &cmdinfo, generation);
+
+    /* A function call in a tail position is executed after the calling
+     * function returns so that the C stack and the variable environment do not
+     * grow. If the shell is to exit after the calling function, the call
+     * cannot be deferred, so the called function is executed without
+     * `finally_exit' to allow deferring tail calls in it. */
+    if (cmdinfo.type == CT_FUNCTION && is_tail_call(c)) {
+	if (tailcall_deferrable && !finally_exit) {
+	    tailcall.body = comsdup(cmdinfo.ci_function);
+	    tailcall.args = pldup(&argv[1], copyaswcs);
+	    laststatus = Exit_SUCCESS;
+	    goto done1;
+	}
+	finally_exit = false;
+    }
 
     /* execute! */
     wchar_t **namep = invoke_simple_command(&cmdinfo, argc, argv0, argv,
-	    finally_exit && /* !temp && */ savefd == NULL);
+	    mbswords, finally_exit && /* !temp && */ savefd == NULL);
     if (namep != NULL)
 	*namep = command_to_wcs(c, false);
 
@@ -970,6 +1414,37 @@ void search_command(
     return;
 }
 
+/* Returns the result of command search cached in the specified simple command.
+ * Returns NULL if the command has no cache or the cache is out of date. */
+const commandinfo_T *get_cached_command(const command_T *c)
+{
+    const struct cmdcache_T *cache = c->c_cmdcache;
+    if (cache == NULL || cache->generation != cmdsearch_generation
+	    || cache->posix != posixly_correct)
+	return NULL;
+    return &cache->info;
+}
+
+/* Saves the result of command search in the specified simple command so that
+ * it can be reused until `cmdsearch_generation' changes.
+ * The result is cached only if the command name is a literal word and the
+ * command is a built-in or function. External commands are searched for on
+ * every execution because their executability must be checked each time. */
+void cache_command(
+	command_T *c, const commandinfo_T *ci, unsigned long generation)
+{
+    if (ci->type == CT_NONE || ci->type == CT_EXTERNALPROGRAM)
+	return;
+    if (!is_literal_command_word(c, 0))
+	return;
+
+    if (c->c_cmdcache == NULL)
+	c->c_cmdcache = xmalloc(sizeof *c->c_cmdcache);
+    c->c_cmdcache->generation = generation;
+    c->c_cmdcache->posix = posixly_correct;
+    c->c_cmdcache->info = *ci;
+}
+
 /* Returns true iff the specified command is a special built-in. */
 bool is_special_builtin(const char *cmdname)
 {
@@ -1015,9 +1490,10 @@ bool command_not_found_handler(void *const *argv)
 }
 
 /* Invokes the simple command. */
-/* `argv0' is the multibyte version of `argv[0]' */
-wchar_t **invoke_simple_command(
-	const commandinfo_T *ci, int argc, char *argv0, void **argv,
+/* `argv0' is the multibyte version of `argv[0]'
+ * `mbswords' is passed to `exec_external_program'. */
+wchar_t **invoke_simple_command(const commandinfo_T *ci,
+	int argc, char *argv0, void **argv, char *const *mbswords,
 	bool finally_exit)
 {
     assert(plcount(argv) == (size_t) argc);
@@ -1029,14 +1505,22 @@ wchar_t **invoke_simple_command(
 	xerror(0, Ngt("no such command `%s'"), argv0);
 	laststatus = Exit_NOTFOUND;
 	break;
-    case CT_EXTERNALPROGRAM:
+    case CT_EXTERNALPROGRAM:;
+	/* The environment is made before forking so that the array is cached
+	 * in the shell process and reused by later commands. */
+	char **envs = get_environment();
 	if (!finally_exit) {
+#if HAVE_POSIX_SPAWN
+	    if (spawn_and_wait(ci->ci_path, argc, argv0, argv, mbswords, envs,
+			&faw))
+		break;
+#endif
 	    faw = fork_and_wait(t_leave);
 	    if (faw.cpid != 0)
 		break;
 	    finally_exit = true;
 	}
-	exec_external_program(ci->ci_path, argc, argv0, argv, environ);
+	exec_external_program(ci->ci_path, argc, argv0, argv, mbswords, envs);
 	break;
     case CT_ELECTIVEBUILTIN:
 	if (posixly_correct) {
@@ -1074,34 +1558,23 @@ wchar_t **invoke_simple_command(
  *  argc:  number of strings in `argv'
  *  argv0: multibyte version of `argv[0]'
  *  argv:  pointer to an array of pointers to wide strings that are passed to
- *         the program */
-void exec_external_program(
-	const char *path, int argc, char *argv0, void **argv, char **envs)
+ *         the program
+ *  mbswords: NULL or multibyte forms of (some of) `argv' (see `to_mbs_argv')
+ *  envs:  environment variables passed to the program */
+void exec_external_program(const char *path, int argc, char *argv0,
+	void **argv, char *const *mbswords, char **envs)
 {
     char *mbsargv[argc + 1];
-    mbsargv[0] = argv0;
-    for (int i = 1; i < argc; i++) {
-	mbsargv[i] = malloc_wcstombs(argv[i]);
-	if (mbsargv[i] == NULL)
-	    mbsargv[i] = xstrdup("");
-    }
-    mbsargv[argc] = NULL;
+    to_mbs_argv(mbsargv, argc, argv0, argv, mbswords);
 
     restore_signals(true);
 
     xexecve(path, mbsargv, envs);
     int saveerrno = errno;
-    if (saveerrno != ENOEXEC) {
-	if (saveerrno == EACCES && is_directory(path))
-	    saveerrno = EISDIR;
-	xerror(saveerrno,
-		strcmp(mbsargv[0], path) == 0
-		    ? Ngt("cannot execute command `%s'")
-		    : Ngt("cannot execute command `%s' (%s)"),
-		argv0, path);
-    } else if (saveerrno != ENOENT) {
+    if (saveerrno != ENOEXEC)
+	print_exec_error(saveerrno, path, argv0);
+    else
 	exec_fall_back_on_sh(argc, mbsargv, envs, path);
-    }
     laststatus = (saveerrno == ENOENT) ? Exit_NOTFOUND : Exit_NOEXEC;
 
     set_signals();
@@ -1110,6 +1583,104 @@ void exec_external_program(
 	free(mbsargv[i]);
 }
 
+#if HAVE_POSIX_SPAWN
+
+/* Starts the external program by `posix_spawn' and waits for it to finish.
+ * The arguments are the same as those of `exec_external_program'.
+ * The program is spawned only if the child process needs no preparation other
+ * than what `posix_spawn' can do: job control must be inactive and the signal
+ * handlers must be such that `execve' resets them properly. Redirections have
+ * already been performed in the shell process and the shell's own file
+ * descriptors are close-on-exec, so the child simply inherits the file
+ * descriptors.
+ * Returns false if the program was not spawned, in which case the caller
+ * should fall back on `fork_and_wait'. If true is returned, `laststatus' and
+ * `*faw' have been updated as `fork_and_wait' would do in the parent. */
+bool spawn_and_wait(const char *path, int argc, char *argv0,
+	void **argv, char *const *mbswords, char **envs, fork_and_wait_T *faw)
+{
+    if (doing_job_control_now)
+	return false;
+
+    sigset_t mask;
+    if (!get_sigmask_for_exec(&mask))
+	return false;
+
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr) != 0)
+	return false;
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    char *mbsargv[argc + 1];
+    to_mbs_argv(mbsargv, argc, argv0, argv, mbswords);
+
+    pid_t cpid;
+    int err;
+    do
+	err = posix_spawn(&cpid, path, NULL, &attr, mbsargv, envs);
+    while (err == EINTR);
+
+    posix_spawnattr_destroy(&attr);
+    for (int i = 1; i < argc; i++)
+	free(mbsargv[i]);
+
+    if (err == ENOEXEC)
+	return false;  /* let the forked child fall back on the shell */
+
+    if (err != 0) {
+	/* `posix_spawn' reports the error of `execve' in the child. */
+	print_exec_error(err, path, argv0);
+	laststatus = (err == ENOENT) ? Exit_NOTFOUND : Exit_NOEXEC;
+	faw->cpid = 0;
+	faw->namep = NULL;
+	return true;
+    }
+
+    spawn_count++;
+    faw->cpid = cpid;
+    faw->namep = wait_for_child(cpid, 0, false);
+    return true;
+}
+
+#endif /* HAVE_POSIX_SPAWN */
+
+/* Converts the arguments to a NULL-terminated array of multibyte strings.
+ * `mbsargv' must have room for `argc + 1' pointers. `argv0' is used as the
+ * first element as is; the other elements are newly malloced strings, which
+ * must be freed by the caller.
+ * If `mbswords' is non-NULL, its non-NULL elements are copied instead of
+ * converting the corresponding elements of `argv'. */
+void to_mbs_argv(char **mbsargv, int argc, char *argv0,
+	void **argv, char *const *mbswords)
+{
+    mbsargv[0] = argv0;
+    for (int i = 1; i < argc; i++) {
+	if (mbswords != NULL && mbswords[i] != NULL) {
+	    mbsargv[i] = xstrdup(mbswords[i]);
+	    continue;
+	}
+	mbsargv[i] = malloc_wcstombs(argv[i]);
+	if (mbsargv[i] == NULL)
+	    mbsargv[i] = xstrdup("");
+    }
+    mbsargv[argc] = NULL;
+}
+
+/* Prints an error message for the failure of `execve'.
+ * `errnum' is the error number, `path' the path of the program and `argv0' the
+ * command name. */
+void print_exec_error(int errnum, const char *path, const char *argv0)
+{
+    if (errnum == EACCES && is_directory(path))
+	errnum = EISDIR;
+    xerror(errnum,
+	    strcmp(argv0, path) == 0
+		? Ngt("cannot execute command `%s'")
+		: Ngt("cannot execute command `%s' (%s)"),
+	    argv0, path);
+}
+
 /* Calls `execve' until it doesn't return EINTR. */
 int xexecve(const char *path, char *const *argv, char *const *envp)
 {
@@ -1163,7 +1734,11 @@ void exec_fall_back_on_sh(
  * `args' are the arguments to the function, which are wide strings cast to
  * (void *).
  * If `complete' is true, `set_completion_variables' will be called after a new
- * variable environment was opened before the function body is executed. */
+ * variable environment was opened before the function body is executed.
+ * A function call deferred by a tail call in the function body is executed in
+ * this function, reusing the variable environment. The local variables of the
+ * calling function are moved to an environment between the original one and
+ * the new function's one so that the called function can still see them. */
 void exec_function_body(
 	command_T *body, void *const *args, bool finally_exit, bool complete)
 {
@@ -1173,6 +1748,12 @@ void exec_function_body(
     bool saveser = suppresserrreturn;
     suppresserrreturn = false;
 
+    const command_T *savetailcallbody = tailcall_body;
+    bool savetailcalldeferrable = tailcall_deferrable;
+    tailcall_T savetailcall = tailcall;
+    tailcall_deferrable = !finally_exit;
+    tailcall.body = NULL;
+
     open_new_environment(false);
     set_positional_parameters(args);
 #if YASH_ENABLE_LINEEDIT
@@ -1181,18 +1762,117 @@ void exec_function_body(
 #else
     (void) complete;
 #endif
-    exec_commands(body, finally_exit ? E_SELF : E_NORMAL);
+
+    bool merge = false;
+    body = comsdup(body);
+    for (;;) {
+	tailcall_body = body;
+	if (shopt_bytecode && !finally_exit)
+	    compile_function_body(body);
+	exec_commands(body, finally_exit ? E_SELF : E_NORMAL);
+	if (tailcall.body == NULL)
+	    break;
+
+	/* execute the deferred function call */
+	comsfree(body);
+	body = tailcall.body;
+	tailcall.body = NULL;
+	if (need_break()) {
+	    plfree(tailcall.args, free);
+	    break;
+	}
+	reset_execstate(false);
+	if (merge) {
+	    merge_current_environment();
+	} else {
+	    open_new_environment(false);
+	    merge = true;
+	}
+	set_positional_parameters(tailcall.args);
+	plfree(tailcall.args, free);
+    }
+    comsfree(body);
+    if (merge)
+	close_current_environment();
     close_current_environment();
 
+    tailcall_body = savetailcallbody;
+    tailcall_deferrable = savetailcalldeferrable;
+    tailcall = savetailcall;
     cancel_return();
     suppresserrreturn = saveser;
     restore_execstate(saveexecstate);
 }
 
+/* Returns true if the specified simple command can be executed as a tail call.
+ * The command must have no assignments or redirections, which would have to be
+ * undone after the call, and must be in a tail position of the body of the
+ * function being executed. */
+bool is_tail_call(const command_T *c)
+{
+    return tailcall_body != NULL && c->c_assigns == NULL
+	&& c->c_redirs == NULL && is_in_tail_position(c, tailcall_body);
+}
+
+/* Returns true if `c' is in a tail position of `body', that is, no part of
+ * `body' is executed after `c'. The commands containing `c' must not be
+ * pipelines or have redirections. Loops are not considered since they may
+ * repeat after `c'. */
+bool is_in_tail_position(const command_T *c, const command_T *body)
+{
+    if (body->next != NULL || body->c_redirs != NULL)
+	return false;
+    if (body == c)
+	return true;
+
+    switch (body->c_type) {
+	case CT_GROUP:
+	    return is_in_tail_position_of_lists(c, body->c_subcmds);
+	case CT_IF:
+	    for (const ifcommand_T *ic = body->c_ifcmds; ic != NULL;
+		    ic = ic->next)
+		if (is_in_tail_position_of_lists(c, ic->ic_commands))
+		    return true;
+	    return false;
+	case CT_CASE:
+	    for (const caseitem_T *ci = body->c_casitems; ci != NULL;
+		    ci = ci->next)
+		if (is_in_tail_position_of_lists(c, ci->ci_commands))
+		    return true;
+	    return false;
+	default:
+	    return false;
+    }
+}
+
+/* Returns true if `c' is in a tail position of the and-or lists, that is, `c'
+ * is in the last pipeline of the last and-or list, which must not be
+ * asynchronous or negated. */
+bool is_in_tail_position_of_lists(const command_T *c, const and_or_T *a)
+{
+    if (a == NULL)
+	return false;
+    while (a->next != NULL)
+	a = a->next;
+    if (a->ao_async)
+	return false;
+
+    const pipeline_T *p = a->ao_pipelines;
+    while (p->next != NULL)
+	p = p->next;
+    if (p->pl_neg)
+	return false;
+
+    return is_in_tail_position(c, p->pl_commands);
+}
+
 /* Executes the specified command whose type is not `CT_SIMPLE'.
  * The redirections for the command is not performed in this function. */
 void exec_nonsimple_command(command_T *c, bool finally_exit)
 {
+    if (shopt_bytecode && !finally_exit && exec_compiled_command(c))
+	return;
+
     switch (c->c_type) {
     case CT_SIMPLE:
 	assert(false);
@@ -1202,6 +1882,9 @@ void exec_nonsimple_command(command_T *c, bool finally_exit)
 	     * no need to make a new child. */
 	    become_child(0);
 	} else {
+	    if (shopt_inlinesubshell && exec_subshell_in_process(c))
+		break;
+
 	    /* make a child process to execute the command */
 	    fork_and_wait_T faw = fork_and_wait(0);
 	    if (faw.cpid != 0) {
@@ -1237,6 +1920,9 @@ void exec_nonsimple_command(command_T *c, bool finally_exit)
     case CT_FUNCDEF:
 	exec_funcdef(c, finally_exit);
 	break;
+    case CT_COPROC:
+	exec_coproc(c, finally_exit);
+	break;
     }
 }
 
@@ -1321,7 +2007,7 @@ void exec_for(const command_T *c, bool finally_exit)
 		    false)) {
 	    laststatus = Exit_ASSGNERR;
 	    apply_errexit_errreturn(NULL);
-	    if (!is_interactive_now)
+	    if (!is_interactive_now && !exit_inline_subshell(-1))
 		finally_exit = true;
 	    goto done;
 	}
@@ -1445,6 +2131,109 @@ void exec_funcdef(const command_T *c, bool finally_exit)
 	exit_shell();
 }
 
+/* Executes the coproc command.
+ * The command is started asynchronously with its standard input and output
+ * connected to pipes, and the other ends of the pipes are assigned to the
+ * array variable as (reading-fd writing-fd). */
+void exec_coproc(command_T *c, bool finally_exit)
+{
+    assert(c->c_type == CT_COPROC);
+
+    /* open a pipe to the coprocess and another from it */
+    pipeinfo_T pi = PIPEINFO_INIT;
+    next_pipe(&pi, true);
+    int tocoprocfd = pi.pi_tonextfds[PIPE_OUT];
+    pi.pi_tonextfds[PIPE_OUT] = -1;
+    if (tocoprocfd < 0)
+	goto fail;
+    next_pipe(&pi, true);
+    if (pi.pi_tonextfds[PIPE_IN] < 0) {
+	xclose(pi.pi_fromprevfd);
+	xclose(tocoprocfd);
+	goto fail;
+    }
+
+    pid_t cpid = fork_and_reset(0, false, t_quitint);
+    if (cpid == 0) {
+	/* child process: execute the command and then exit */
+	xclose(tocoprocfd);
+	connect_pipes(&pi);
+	exec_one_command(c->c_cocmd, true);
+	assert(false);
+    }
+
+    int fromcoprocfd = pi.pi_tonextfds[PIPE_IN];
+    xclose(pi.pi_fromprevfd);
+    xclose(pi.pi_tonextfds[PIPE_OUT]);
+    if (cpid < 0) {
+	/* fork failure */
+	xclose(fromcoprocfd);
+	xclose(tocoprocfd);
+	goto fail;
+    }
+
+    /* parent process: add a new job */
+    job_T *job = xmalloc(add(sizeof *job, sizeof *job->j_procs));
+    process_T *ps = job->j_procs;
+
+    ps->pr_pid = cpid;
+    ps->pr_status = JS_RUNNING;
+    ps->pr_statuscode = 0;
+    ps->pr_name = NULL;
+    ps->pr_command = comsdup(c);
+    ps->pr_pipelines = NULL;
+
+    job->j_pgid = doing_job_control_now ? cpid : 0;
+    job->j_status = JS_RUNNING;
+    job->j_statuschanged = true;
+    job->j_legacy = false;
+    job->j_nonotify = false;
+    job->j_pcount = 1;
+
+    set_active_job(job);
+    add_job(shopt_curasync);
+    lastasyncpid = cpid;
+
+    /* assign the file descriptors to the variable */
+    fromcoprocfd = move_to_high_fd(fromcoprocfd);
+    tocoprocfd = move_to_high_fd(tocoprocfd);
+    void **fds = xmallocn(3, sizeof *fds);
+    fds[0] = malloc_wprintf(L"%d", fromcoprocfd);
+    fds[1] = malloc_wprintf(L"%d", tocoprocfd);
+    fds[2] = NULL;
+    const wchar_t *name = (c->c_coname != NULL) ? c->c_coname : L"COPROC";
+    if (set_array(name, 2, fds, SCOPE_GLOBAL, false) != NULL) {
+	laststatus = Exit_SUCCESS;
+    } else {
+	xclose(fromcoprocfd);
+	xclose(tocoprocfd);
+	laststatus = Exit_ASSGNERR;
+    }
+    goto done;
+
+fail:
+    laststatus = Exit_NOEXEC;
+done:
+    if (finally_exit)
+	exit_shell();
+}
+
+/* Moves the specified file descriptor to 10 or above so that it does not
+ * interfere with redirections of small file descriptors.
+ * The close-on-exec flag is set so that external commands do not keep the file
+ * open unless explicitly redirected.
+ * Returns the new file descriptor. */
+int move_to_high_fd(int fd)
+{
+    int newfd = fcntl(fd, F_DUPFD, 10);
+    if (newfd >= 0) {
+	xclose(fd);
+	fd = newfd;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
 /* Forks a new child process and wait for it to finish.
  * `sigtype' is passed to `fork_and_reset'.
  * In the parent process, this function updates `laststatus' to the exit status
@@ -1509,6 +2298,7 @@ pid_t fork_and_reset(pid_t pgid, bool fg, sigtype_T sigtype)
 	    xerror(errno, Ngt("cannot make a child process"));
 	} else {
 	    /* parent process */
+	    fork_count++;
 	    if (doing_job_control_now && pgid >= 0)
 		setpgid(cpid, pgid);
 	}
@@ -1556,6 +2346,8 @@ void become_child(sigtype_T sigtype)
     is_interactive_now = false;
     suppresserrreturn = false;
     exitstatus = -1;
+    inline_subshell_level = 0;
+    traps_deferred = false;
 }
 
 /* Executes the command substitution and returns the string to substitute with.
@@ -1572,69 +2364,1423 @@ wchar_t *exec_command_substitution(const embedcmd_T *cmdsub)
 	    : cmdsub->value.unparsed[0] == L'\0')  /* empty command */
 	return xwcsdup(L"");
 
-    /* open a pipe to receive output from the command */
-    if (pipe(pipefd) < 0) {
-	xerror(errno, Ngt("cannot open a pipe for the command substitution"));
+    /* "$(<file)" is replaced with the contents of the file. */
+    const redir_T *readfile = NULL;
+    if (cmdsub->is_file_read) {
+	readfile = cmdsub->value.preparsed->ao_pipelines->pl_commands->c_redirs;
+	if (is_pure_word(readfile->rd_filename))
+	    return substitute_file_contents(readfile);
+    }
+
+    /* Commands that only run side-effect-free built-ins do not need a
+     * subshell. */
+    if (cmdsub->is_preparsed
+	    && is_pure_and_or_lists(cmdsub->value.preparsed, 0)) {
+	wchar_t *result = substitute_in_process(cmdsub->value.preparsed);
+	if (result != NULL)
+	    return result;
+    }
+
+    /* open a pipe to receive output from the command */
+    if (pipe(pipefd) < 0) {
+	xerror(errno, Ngt("cannot open a pipe for the command substitution"));
 	return NULL;
     }
 
-    /* If the child is stopped by SIGTSTP, it can never be resumed and
-     * the shell will be stuck. So we specify the `t_tstp' flag to prevent the
-     * child from being stopped by SIGTSTP. */
-    cpid = fork_and_reset(-1, false, t_tstp);
-    if (cpid < 0) {
-	/* fork failure */
-	xclose(pipefd[PIPE_IN]);
-	xclose(pipefd[PIPE_OUT]);
-	lastcmdsubstatus = Exit_NOEXEC;
-	return NULL;
-    } else if (cpid > 0) {
-	/* parent process */
-	FILE *f;
+    /* If the child is stopped by SIGTSTP, it can never be resumed and
+     * the shell will be stuck. So we specify the `t_tstp' flag to prevent the
+     * child from being stopped by SIGTSTP. */
+    cpid = fork_and_reset(-1, false, t_tstp);
+    if (cpid < 0) {
+	/* fork failure */
+	xclose(pipefd[PIPE_IN]);
+	xclose(pipefd[PIPE_OUT]);
+	lastcmdsubstatus = Exit_NOEXEC;
+	return NULL;
+    } else if (cpid > 0) {
+	/* parent process */
+	xclose(pipefd[PIPE_OUT]);
+
+	/* read output from the command */
+	wchar_t *result = read_command_substitution_output(pipefd[PIPE_IN]);
+
+	/* wait for the child to finish */
+	int savelaststatus = laststatus;
+	wait_for_child(cpid, 0, false);
+	lastcmdsubstatus = laststatus;
+	laststatus = savelaststatus;
+
+	return result;
+    } else {
+	/* child process */
+	xclose(pipefd[PIPE_IN]);
+	if (pipefd[PIPE_OUT] != STDOUT_FILENO) {  /* connect the pipe */
+	    if (xdup2(pipefd[PIPE_OUT], STDOUT_FILENO) < 0)
+		exit(Exit_NOEXEC);
+	    xclose(pipefd[PIPE_OUT]);
+	}
+
+	if (readfile != NULL)
+	    exit_shell_with_status(copy_file_to_stdout(readfile));
+	if (cmdsub->is_preparsed)
+	    exec_and_or_lists(cmdsub->value.preparsed, true);
+	else
+	    exec_wcs(cmdsub->value.unparsed, gt("command substitution"), true);
+	assert(false);
+    }
+}
+
+/* size of the buffer used to read the file in "$(<file)" and the output of
+ * command substitutions */
+#define FILE_READ_BUFSIZE 65536
+
+/* Performs the command substitution of the form "$(<file)" in the shell
+ * process. `r' is the input redirection in the command substitution.
+ * Returns the contents of the file with trailing newlines removed. */
+wchar_t *substitute_file_contents(const redir_T *r)
+{
+    int fd = open_input_redirection_file(r);
+    if (fd < 0) {
+	lastcmdsubstatus = Exit_REDIRERR;
+	return xwcsdup(L"");
+    }
+
+    lastcmdsubstatus = Exit_SUCCESS;
+    return read_command_substitution_output(fd);
+}
+
+/* Copies the contents of the file of the input redirection `r' to the
+ * standard output. This is used in the subshell of "$(<file)" when the
+ * filename cannot be expanded in the shell process.
+ * Returns the exit status of the command substitution. */
+int copy_file_to_stdout(const redir_T *r)
+{
+    int fd = open_input_redirection_file(r);
+    if (fd < 0)
+	return Exit_REDIRERR;
+
+    char buf[FILE_READ_BUFSIZE];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof buf)) != 0) {
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    xerror(errno, Ngt("cannot read the output of the command "
+			"substitution"));
+	    break;
+	}
+	if (!write_all(STDOUT_FILENO, buf, n))
+	    break;
+    }
+    xclose(fd);
+    return (n == 0) ? Exit_SUCCESS : Exit_FAILURE;
+}
+
+/* Executes the commands of a command substitution in the shell process,
+ * capturing the standard output in a temporary file.
+ * The commands must satisfy `is_pure_and_or_lists' so that executing them does
+ * not affect the shell's state.
+ * Returns the output with trailing newlines removed, or NULL if the output
+ * cannot be captured, in which case no command has been executed. */
+wchar_t *substitute_in_process(const and_or_T *cmds)
+{
+    fflush(stdout);
+
+    savefd_T *save;
+    int fd = redirect_stdout_to_temporary_file(&save);
+    if (fd < 0)
+	return NULL;
+
+    /* Traps must not be executed while the output is being captured. They are
+     * handled later as if the shell had been waiting for a subshell. */
+    bool savedeferred = traps_deferred;
+    traps_deferred = true;
+
+    execstate_T *saveexecstate = save_execstate();
+    reset_execstate(false);
+    int savelaststatus = laststatus;
+    exec_and_or_lists(cmds, false);
+    lastcmdsubstatus = laststatus;
+    laststatus = savelaststatus;
+    restore_execstate(saveexecstate);
+
+    traps_deferred = savedeferred;
+
+    fflush(stdout);
+    undo_redirections(save);
+
+    remove_shellfd(fd);
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+	xerror(errno, Ngt("cannot read the output of the command substitution"));
+	xclose(fd);
+	return xwcsdup(L"");
+    }
+    return read_command_substitution_output(fd);
+}
+
+/* Reads the output of a command substitution from the specified file
+ * descriptor until EOF and closes the file descriptor.
+ * The output is read in chunks of `FILE_READ_BUFSIZE' bytes, each of which is
+ * converted into wide characters at once. Reading stops at an invalid byte
+ * sequence.
+ * Returns the output with trailing newlines removed. */
+wchar_t *read_command_substitution_output(int fd)
+{
+    xwcsbuf_T buf;
+    mbstate_t state;
+    char *chunk = xmalloc(FILE_READ_BUFSIZE);
+    wb_init(&buf);
+    memset(&state, 0, sizeof state);  // initialize as the initial shift state
+
+    for (;;) {
+	ssize_t n = read(fd, chunk, FILE_READ_BUFSIZE);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    xerror(errno,
+		    Ngt("cannot read the output of the command substitution"));
+	    break;
+	}
+	if (n == 0)
+	    break;
+
+	size_t i = 0;
+	while (i < (size_t) n) {
+	    size_t count = wb_mbsncat(&buf, &chunk[i], n - i, &state, false);
+	    if (count == (size_t) -1)
+		goto done;
+	    i += count;
+	}
+    }
+done:
+    free(chunk);
+    xclose(fd);
+
+    /* trim trailing newlines */
+    size_t len = buf.length;
+    while (len > 0 && buf.contents[len - 1] == L'\n')
+	len--;
+    return wb_towcs(wb_truncate(&buf, len));
+}
+
+/* Maximum nesting depth of function calls that `is_pure_command' examines. */
+#define PURE_FUNCTION_DEPTH_MAX 8
+
+/* Checks if the specified and-or lists can be executed in the shell process as
+ * the contents of a command substitution.
+ * The lists are "pure" if they consist only of simple commands that invoke
+ * side-effect-free built-ins (or functions made up of such commands) and
+ * command groups, if, and case commands containing them. Executing pure
+ * commands does not affect the state of the shell except `laststatus', so
+ * there is no need to make a subshell for them. */
+bool is_pure_and_or_lists(const and_or_T *a, unsigned depth)
+{
+    /* These options make failures in the command substitution affect the
+     * control flow of the shell. */
+    if (shopt_errexit || shopt_errreturn)
+	return false;
+    /* $PS4 may contain a command substitution with side effects. */
+    if (shopt_xtrace)
+	return false;
+
+    for (; a != NULL; a = a->next) {
+	if (a->ao_async)
+	    return false;
+	for (const pipeline_T *p = a->ao_pipelines; p != NULL; p = p->next)
+	    if (p->pl_commands->next != NULL
+		    || !is_pure_command(p->pl_commands, depth))
+		return false;
+    }
+    return true;
+}
+
+/* Checks if the specified command is pure. See `is_pure_and_or_lists'. */
+bool is_pure_command(const command_T *c, unsigned depth)
+{
+    if (!is_pure_redirections(c->c_redirs))
+	return false;
+
+    switch (c->c_type) {
+	case CT_SIMPLE:
+	    return is_pure_simple_command(c, depth);
+	case CT_GROUP:
+	    return is_pure_and_or_lists(c->c_subcmds, depth);
+	case CT_IF:
+	    for (const ifcommand_T *ic = c->c_ifcmds; ic != NULL; ic = ic->next)
+		if (!is_pure_and_or_lists(ic->ic_condition, depth)
+			|| !is_pure_and_or_lists(ic->ic_commands, depth))
+		    return false;
+	    return true;
+	case CT_CASE:
+	    if (!is_pure_word(c->c_casword))
+		return false;
+	    for (const caseitem_T *ci = c->c_casitems;
+		    ci != NULL;
+		    ci = ci->next)
+		if (!is_pure_words(ci->ci_patterns)
+			|| !is_pure_and_or_lists(ci->ci_commands, depth))
+		    return false;
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+/* Checks if the specified simple command is pure.
+ * The command name must be a literal word that names a side-effect-free
+ * built-in or a function whose body is pure. */
+bool is_pure_simple_command(const command_T *c, unsigned depth)
+{
+    if (c->c_assigns != NULL || c->c_words[0] == NULL)
+	return false;
+    if (!is_pure_words(c->c_words))
+	return false;
+
+    commandinfo_T ci;
+    if (!search_literal_command(c, &ci))
+	return false;
+
+    switch (ci.type) {
+	case CT_SPECIALBUILTIN:
+	case CT_MANDATORYBUILTIN:
+	case CT_ELECTIVEBUILTIN:
+	case CT_EXTENSIONBUILTIN:
+	case CT_SUBSTITUTIVEBUILTIN:
+	    return is_pure_builtin(ci.ci_builtin);
+	case CT_FUNCTION:
+	    return depth < PURE_FUNCTION_DEPTH_MAX
+		&& is_pure_command(ci.ci_function, depth + 1);
+	default:
+	    return false;
+    }
+}
+
+/* Checks if the specified built-in only prints something without affecting
+ * the state of the shell. */
+bool is_pure_builtin(main_T *body)
+{
+    return body == true_builtin
+	|| body == false_builtin
+	|| body == pwd_builtin
+#if YASH_ENABLE_PRINTF
+	|| body == echo_builtin
+	|| body == printf_builtin
+#endif
+#if YASH_ENABLE_TEST
+	|| body == test_builtin
+#endif
+	;
+}
+
+/* Checks if the specified redirections are pure, that is, if they can be
+ * opened and undone in the shell process without any effect. */
+bool is_pure_redirections(const redir_T *r)
+{
+    for (; r != NULL; r = r->next) {
+	/* FDs above 9 may be in use by the shell and would be unavailable. A
+	 * redirection error in a special built-in would exit the shell. */
+	if (r->rd_fd > 9 || posixly_correct)
+	    return false;
+
+	switch (r->rd_type) {
+	    case RT_INPUT:  case RT_OUTPUT:  case RT_CLOBBER:  case RT_APPEND:
+	    case RT_INOUT:  case RT_DUPIN:   case RT_DUPOUT:   case RT_HERESTR:
+		if (!is_pure_word(r->rd_filename))
+		    return false;
+		break;
+	    case RT_HERE:  case RT_HERERT:
+		if (!is_pure_word(r->rd_herecontent))
+		    return false;
+		break;
+	    default:
+		return false;
+	}
+    }
+    return true;
+}
+
+/* Checks if the expansion of the specified words has no side effects.
+ * `words' is a NULL-terminated array of pointers to `wordunit_T'. */
+bool is_pure_words(void *const *words)
+{
+    for (; *words != NULL; words++)
+	if (!is_pure_word(*words))
+	    return false;
+    return true;
+}
+
+/* Checks if the expansion of the specified word has no side effects and never
+ * fails. Arithmetic expansions are rejected as they may assign variables. A
+ * nested command substitution is fine because it is executed in a subshell or
+ * is pure itself. */
+bool is_pure_word(const wordunit_T *w)
+{
+    for (; w != NULL; w = w->next) {
+	switch (w->wu_type) {
+	    case WT_STRING:
+	    case WT_CMDSUB:
+		break;
+	    case WT_PARAM:
+		if (!is_pure_paramexp(w->wu_param))
+		    return false;
+		break;
+	    case WT_ARITH:
+		return false;
+	}
+    }
+    return true;
+}
+
+/* Checks if the specified parameter expansion has no side effects and never
+ * fails. */
+bool is_pure_paramexp(const paramexp_T *p)
+{
+    /* Expanding an unset variable is an error if the "unset" option is off. */
+    if (!shopt_unset)
+	return false;
+    /* Indices are subject to arithmetic expansion. */
+    if (p->pe_start != NULL || p->pe_end != NULL)
+	return false;
+
+    switch (p->pe_type & PT_MASK) {
+	case PT_NONE:
+	case PT_MINUS:
+	case PT_PLUS:
+	case PT_MATCH:
+	case PT_SUBST:
+	    break;
+	default:
+	    return false;
+    }
+    if (p->pe_type & PT_NEST) {
+	if (!is_pure_word(p->pe_nest))
+	    return false;
+    } else {
+	/* A getter (e.g. that of $RANDOM) changes the state of the shell. */
+	if (is_variable_with_getter(p->pe_name))
+	    return false;
+    }
+    return is_pure_word(p->pe_match) && is_pure_word(p->pe_subst);
+}
+
+/* Searches for the command named by the first word of the specified simple
+ * command in the same way as `exec_simple_command_with_words' would do, but
+ * without affecting the command hashtable. External commands are not searched
+ * for, so `ci->type' is `CT_NONE' for them.
+ * Returns false if the word is not literal. */
+bool search_literal_command(const command_T *c, commandinfo_T *ci)
+{
+    if (!is_literal_command_word(c, 0))
+	return false;
+
+    const char *mbsname = c->c_mbswords[0];
+    const wordunit_T *name = c->c_words[0];
+    search_command(mbsname, name->wu_string, ci, SCT_BUILTIN | SCT_FUNCTION);
+    if (ci->type == CT_NONE && strchr(mbsname, '/') == NULL) {
+	/* A substitutive built-in is used only if the command is in PATH. */
+	const builtin_T *bi = get_builtin(mbsname);
+	if (bi != NULL && bi->type == BI_SUBSTITUTIVE) {
+	    char *path = which(
+		    mbsname, get_path_array(PA_PATH), is_executable_regular);
+	    if (path != NULL) {
+		ci->type = CT_SUBSTITUTIVEBUILTIN;
+		ci->ci_builtin = bi->body;
+		free(path);
+	    }
+	}
+    }
+    return true;
+}
+
+/* Executes the specified subshell command in the shell process without
+ * forking. This is possible only if the effects of the subshell on the shell
+ * can be undone. See `exec_inline'.
+ * Returns false without executing anything if the subshell has to be executed
+ * in a child process. */
+bool exec_subshell_in_process(command_T *c)
+{
+    assert(c->c_type == CT_SUBSHELL);
+
+    if (!is_inlining_possible())
+	return false;
+
+    inlineinfo_T info = { .chdir = false, .umask = false, .forks = false, };
+    pl_init(&info.names);
+    if (!is_inlinable_and_or_lists(c->c_subcmds, &info, 0)) {
+	plfree(pl_toary(&info.names), free);
+	return false;
+    }
+
+    return exec_inline(c, true, &info);
+}
+
+/* Checks if the current state of the shell allows executing a subshell in the
+ * shell process. A job-controlled subshell needs its own process group. Traps
+ * would be reset in a real subshell. $PS4 may contain a command substitution
+ * with side effects. */
+bool is_inlining_possible(void)
+{
+    return !doing_job_control_now && !any_trap_set && !posixly_correct
+	&& !shopt_xtrace;
+}
+
+/* Executes the specified command in the shell process as if it were executed
+ * in a subshell. If `subshell' is true, `c' must be a subshell command and its
+ * body is executed. Otherwise, `c' itself is executed.
+ * `info' must have been filled by `is_inlinable_command' for the command. The
+ * variables in `info->names', the working directory and the umask are saved
+ * before executing the command and restored afterwards. `info' is destroyed in
+ * this function.
+ * Returns false without executing anything if the working directory cannot be
+ * saved. */
+bool exec_inline(command_T *c, bool subshell, inlineinfo_T *info)
+{
+    int cwdfd = -1;
+    if (info->chdir) {
+	cwdfd = move_to_shellfd(open(".", O_RDONLY));
+	if (cwdfd < 0) {
+	    plfree(pl_toary(&info->names), free);
+	    return false;
+	}
+	pl_add(&info->names, xwcsdup(L VAR_PWD));
+	pl_add(&info->names, xwcsdup(L VAR_OLDPWD));
+    }
+
+    mode_t savemask = 0;
+    if (info->umask) {
+	savemask = umask(0);
+	umask(savemask);
+    }
+
+    struct savedvar_T *savedvars = save_variables(info->names.contents);
+    bool saveser = suppresserrreturn;
+    suppresserrreturn = false;
+    execstate_T *saveexecstate = save_execstate();
+    reset_execstate(true);
+
+    enter_inline_subshell();
+    if (subshell)
+	exec_and_or_lists(c->c_subcmds, false);
+    else
+	exec_one_command(c, false);
+    leave_inline_subshell();
+
+    restore_execstate(saveexecstate);
+    suppresserrreturn = saveser;
+    restore_variables(savedvars);
+    if (info->umask)
+	umask(savemask);
+    if (cwdfd >= 0) {
+	if (fchdir(cwdfd) < 0)
+	    xerror(errno, Ngt("cannot restore the working directory"));
+	remove_shellfd(cwdfd);
+	xclose(cwdfd);
+    }
+    plfree(pl_toary(&info->names), free);
+    return true;
+}
+
+/* Checks if the specified and-or lists can be executed in a subshell that is
+ * emulated in the shell process. The state of the shell that the lists may
+ * change is recorded in `*info'. */
+bool is_inlinable_and_or_lists(
+	const and_or_T *a, inlineinfo_T *info, unsigned depth)
+{
+    for (; a != NULL; a = a->next) {
+	if (a->ao_async)
+	    return false;
+	for (const pipeline_T *p = a->ao_pipelines; p != NULL; p = p->next) {
+	    if (p->pl_commands->next != NULL)
+		info->forks = true;
+	    for (const command_T *c = p->pl_commands; c != NULL; c = c->next)
+		if (!is_inlinable_command(c, info, depth))
+		    return false;
+	}
+    }
+    return true;
+}
+
+/* Checks if the specified command can be executed in a subshell that is
+ * emulated in the shell process. See `is_inlinable_and_or_lists'. */
+bool is_inlinable_command(
+	const command_T *c, inlineinfo_T *info, unsigned depth)
+{
+    if (!is_pure_redirections(c->c_redirs))
+	return false;
+
+    switch (c->c_type) {
+	case CT_SIMPLE:
+	    return is_inlinable_simple_command(c, info, depth);
+	case CT_SUBSHELL:
+	    /* A nested subshell is emulated or forked on its own. */
+	    info->forks = true;
+	    return true;
+	case CT_GROUP:
+	    return is_inlinable_and_or_lists(c->c_subcmds, info, depth);
+	case CT_IF:
+	    for (const ifcommand_T *ic = c->c_ifcmds; ic != NULL; ic = ic->next)
+		if (!is_inlinable_and_or_lists(ic->ic_condition, info, depth)
+			|| !is_inlinable_and_or_lists(
+			    ic->ic_commands, info, depth))
+		    return false;
+	    return true;
+	case CT_FOR:
+	    if (!add_inline_variable(info, xwcsdup(c->c_forname)))
+		return false;
+	    if (c->c_forwords != NULL && !is_pure_words(c->c_forwords))
+		return false;
+	    return is_inlinable_and_or_lists(c->c_forcmds, info, depth);
+	case CT_WHILE:
+	    return is_inlinable_and_or_lists(c->c_whlcond, info, depth)
+		&& is_inlinable_and_or_lists(c->c_whlcmds, info, depth);
+	case CT_CASE:
+	    if (!is_pure_word(c->c_casword))
+		return false;
+	    for (const caseitem_T *ci = c->c_casitems;
+		    ci != NULL;
+		    ci = ci->next)
+		if (!is_pure_words(ci->ci_patterns)
+			|| !is_inlinable_and_or_lists(
+			    ci->ci_commands, info, depth))
+		    return false;
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+/* Checks if the specified simple command can be executed in a subshell that is
+ * emulated in the shell process. External commands are always executed in a
+ * child process, so they are fine. Built-ins are accepted if their effects are
+ * known. */
+bool is_inlinable_simple_command(
+	const command_T *c, inlineinfo_T *info, unsigned depth)
+{
+    for (const assign_T *a = c->c_assigns; a != NULL; a = a->next) {
+	if (!add_inline_variable(info, xwcsdup(a->a_name)))
+	    return false;
+	switch (a->a_type) {
+	    case A_SCALAR:
+		if (!is_pure_word(a->a_scalar))
+		    return false;
+		break;
+	    case A_ARRAY:
+		if (!is_pure_words(a->a_array))
+		    return false;
+		break;
+	}
+    }
+
+    if (c->c_words[0] == NULL)
+	return true;
+    if (!is_pure_words(c->c_words))
+	return false;
+
+    commandinfo_T ci;
+    if (!search_literal_command(c, &ci))
+	return false;
+
+    switch (ci.type) {
+	case CT_NONE:  /* external command or command not found */
+	    info->forks = true;
+	    return true;
+	case CT_SPECIALBUILTIN:
+	case CT_MANDATORYBUILTIN:
+	case CT_ELECTIVEBUILTIN:
+	case CT_EXTENSIONBUILTIN:
+	case CT_SUBSTITUTIVEBUILTIN:
+	    return is_inlinable_builtin(ci.ci_builtin, c, info);
+	default:
+	    assert(ci.type == CT_FUNCTION);
+	    return depth < PURE_FUNCTION_DEPTH_MAX
+		&& is_inlinable_command(ci.ci_function, info, depth + 1);
+    }
+}
+
+/* Checks if the specified built-in can be executed in a subshell that is
+ * emulated in the shell process.
+ * `c' is the simple command that invokes the built-in. */
+bool is_inlinable_builtin(
+	main_T *body, const command_T *c, inlineinfo_T *info)
+{
+    if (is_pure_builtin(body) || body == exit_builtin)
+	return true;
+
+    if (body == cd_builtin) {
+	/* $YASH_AFTER_CD may contain arbitrary commands. */
+	struct get_variable_T gv = get_variable(L VAR_YASH_AFTER_CD);
+	if (gv.freevalues)
+	    plfree(gv.values, free);
+	if (gv.type != GV_NOTFOUND)
+	    return false;
+	info->chdir = true;
+	return true;
+    }
+    if (body == umask_builtin) {
+	info->umask = true;
+	return true;
+    }
+    if (body == read_builtin)
+	return add_inline_operands(c, false, info);
+    if (body == unset_builtin)
+	return add_inline_operands(c, true, info);
+    if (body == typeset_builtin) {
+	const wordunit_T *name = c->c_words[0];
+	return wcscmp(name->wu_string, L"export") == 0
+	    && add_inline_operands(c, false, info);
+    }
+    return false;
+}
+
+/* Records the operands of the "read", "unset", or "export" built-in invoked by
+ * simple command `c' as the names of variables that may be assigned. Every
+ * word must be literal. Options are skipped, but those that may operate on
+ * functions are rejected. If `unset' is true, only the -v option is accepted.
+ */
+bool add_inline_operands(const command_T *c, bool unset, inlineinfo_T *info)
+{
+    for (size_t i = 1; c->c_words[i] != NULL; i++) {
+	if (!is_literal_command_word(c, i))
+	    return false;
+
+	const wchar_t *word = ((const wordunit_T *) c->c_words[i])->wu_string;
+	if (word[0] == L'-') {
+	    if (unset ? wcscmp(word, L"-v") != 0
+		    : word[1] == L'-' || wcschr(word, L'f') != NULL)
+		return false;
+	    continue;
+	}
+	if (!add_inline_variable(info, xwcsndup(word, wcscspn(word, L"="))))
+	    return false;
+    }
+    return true;
+}
+
+/* Records the specified name as the name of a variable that may be assigned.
+ * `name' must be a newly malloced string; it is freed if the variable cannot
+ * be saved and restored. */
+bool add_inline_variable(inlineinfo_T *info, wchar_t *name)
+{
+    if (is_readonly_variable(name)
+	    || wcscmp(name, L VAR_RANDOM) == 0
+	    || wcscmp(name, L VAR_YASH_AFTER_CD) == 0) {
+	free(name);
+	return false;
+    }
+    pl_add(&info->names, name);
+    return true;
+}
+
+/* About bytecode:
+ *
+ * When the "bytecode" option is enabled, loops and function bodies are
+ * compiled into bytecode that is stored in the `c_code' member of the command.
+ * The bytecode has the same effect as `exec_nonsimple_command(c, false)', but
+ * the control flow of and-or lists, pipelines, and compound commands nested in
+ * the command is translated into jumps between instructions so that the
+ * command tree is not walked again every time the command is executed.
+ * A simple command whose command name is a literal word is compiled with the
+ * kinds of its words decided at compile time: literal words are copied and
+ * quoted variable expansions are replaced with the variable values without the
+ * full word expansion. If the cached result of the command search is a built-in
+ * that is not special, the built-in is called directly. The other commands
+ * (multi-command pipelines, subshells, etc.) are executed by the usual
+ * `exec_commands' function from the bytecode.
+ *
+ * Variables are not resolved to slots at compile time because the variable
+ * environment a name refers to is decided dynamically. The slots of bytecode
+ * only hold the temporary state of the compiled commands, such as the saved
+ * suppression of "errexit" and the words of a for loop. */
+
+/* Executes the specified command using its bytecode.
+ * Loops are compiled when first executed in this function. Other commands must
+ * have been compiled by `compile_function_body'.
+ * Returns false if the command was not executed. */
+bool exec_compiled_command(command_T *c)
+{
+    if (c->c_code == NULL) {
+	if (c->c_type != CT_FOR && c->c_type != CT_WHILE)
+	    return false;
+	c->c_code = compile_command(c);
+    }
+    run_bytecode(c->c_code);
+    return true;
+}
+
+/* Compiles the body of a function if possible and not yet compiled. */
+void compile_function_body(command_T *body)
+{
+    if (body->c_code == NULL && body->next == NULL
+	    && is_compilable_command(body))
+	body->c_code = compile_command(body);
+}
+
+/* Returns true if the command can be compiled by `compile_command'. */
+bool is_compilable_command(const command_T *c)
+{
+    switch (c->c_type) {
+	case CT_GROUP:
+	case CT_IF:
+	case CT_FOR:
+	case CT_WHILE:
+	case CT_CASE:
+	    return true;
+	default:
+	    return false;
+    }
+}
+
+/* Compiles the specified command into bytecode.
+ * The result must be freed by the caller. */
+struct bytecode_T *compile_command(command_T *c)
+{
+    compiler_T comp = {
+	.code = NULL, .length = 0, .capacity = 0,
+	.labels = NULL, .labelcount = 0, .labelcapacity = 0, .slotcount = 0,
+    };
+
+    compile_nonsimple_command(&comp, c);
+    emit(&comp, OP_END);
+
+    /* replace the labels with the indices of the instructions */
+    for (size_t i = 0; i < comp.length; i++) {
+	insn_T *insn = &comp.code->insns[i];
+	if (insn->target != NO_LABEL)
+	    insn->target = comp.labels[insn->target];
+	if (insn->target2 != NO_LABEL)
+	    insn->target2 = comp.labels[insn->target2];
+    }
+    free(comp.labels);
+
+    comp.code->slotcount = comp.slotcount;
+    return comp.code;
+}
+
+/* Frees the bytecode returned from `compile_command'. */
+void bytecodefree(struct bytecode_T *code)
+{
+    if (code == NULL)
+	return;
+    for (const insn_T *insn = code->insns; insn->opcode != OP_END; insn++)
+	if (insn->opcode == OP_SIMPLE)
+	    free(insn->operand.simple);
+    free(code);
+}
+
+/* Compiles the command whose type must be supported by
+ * `is_compilable_command'. */
+void compile_nonsimple_command(compiler_T *comp, command_T *c)
+{
+    switch (c->c_type) {
+	case CT_GROUP:
+	    compile_and_or_lists(comp, c->c_subcmds);
+	    return;
+	case CT_IF:
+	    compile_if(comp, c);
+	    return;
+	case CT_FOR:
+	    compile_for(comp, c);
+	    return;
+	case CT_WHILE:
+	    compile_while(comp, c);
+	    return;
+	case CT_CASE:
+	    compile_case(comp, c);
+	    return;
+	default:
+	    assert(false);
+    }
+}
+
+/* Compiles the and-or lists like `exec_and_or_lists'. */
+void compile_and_or_lists(compiler_T *comp, const and_or_T *a)
+{
+    size_t end = new_label(comp);
+    for (; a != NULL; a = a->next) {
+	emit(comp, OP_CHECK)->target = end;
+	if (!a->ao_async)
+	    compile_pipelines(comp, a->ao_pipelines);
+	else
+	    emit(comp, OP_ASYNC)->operand.pipelines = a->ao_pipelines;
+    }
+    place_label(comp, end);
+}
+
+/* Compiles the pipelines like `exec_pipelines'. */
+void compile_pipelines(compiler_T *comp, const pipeline_T *p)
+{
+    size_t end = new_label(comp);
+    for (bool first = true; p != NULL; p = p->next, first = false) {
+	size_t next = new_label(comp);
+	if (!first)
+	    emit(comp, p->pl_cond ? OP_JUMP_IF_FAILURE : OP_JUMP_IF_SUCCESS)
+		->target = next;
+
+	bool suppress = p->pl_neg || p->next != NULL;
+	unsigned slot = suppress ? new_slot(comp) : 0;
+	if (suppress)
+	    emit(comp, OP_SUPPRESS)->slot = slot;
+
+	compile_commands(comp, p->pl_commands);
+
+	if (suppress)
+	    emit(comp, OP_RESTORE)->slot = slot;
+
+	emit(comp, OP_CHECK)->target = end;
+
+	if (p->pl_neg)
+	    emit(comp, OP_NEGATE);
+	place_label(comp, next);
+    }
+    place_label(comp, end);
+}
+
+/* Compiles the commands of a pipeline like `exec_commands' with `E_NORMAL'.
+ * A compound command that is not part of a multi-command pipeline and has no
+ * redirections is compiled into the code. */
+void compile_commands(compiler_T *comp, command_T *c)
+{
+    if (c->next == NULL && c->c_redirs == NULL && is_compilable_command(c)) {
+	emit(comp, OP_LINENO)->operand.command = c;
+	compile_nonsimple_command(comp, c);
+	emit(comp, OP_AFTER)->operand.command = c;
+    } else if (c->next == NULL && c->c_type == CT_SIMPLE
+	    && c->c_words[0] != NULL && is_literal_command_word(c, 0)) {
+	emit(comp, OP_SIMPLE)->operand.simple = compile_simple_command(c);
+    } else {
+	emit(comp, OP_COMMANDS)->operand.command = c;
+    }
+}
+
+/* Classifies the words of the simple command `c' for
+ * `exec_compiled_simple_command'. */
+simplecommand_T *compile_simple_command(command_T *c)
+{
+    size_t count = plcount(c->c_words);
+    simplecommand_T *sc = xmallocs(sizeof *sc, count, sizeof *sc->kinds);
+    sc->command = c;
+    for (size_t i = 0; i < count; i++)
+	sc->kinds[i] = classify_word(c, i);
+    return sc;
+}
+
+/* Decides how the `index'th word of the simple command `c' is expanded.
+ * A word is WK_PARAM if it is a double-quoted parameter expansion of a
+ * variable without any modifier, which always expands to one field that is the
+ * value of the variable if the variable is a set scalar. */
+wordkind_T classify_word(const command_T *c, size_t index)
+{
+    if (is_literal_command_word(c, index))
+	return WK_LITERAL;
+
+    const wordunit_T *w = c->c_words[index];
+    if (w->wu_type != WT_STRING || wcscmp(w->wu_string, L"\"") != 0)
+	return WK_EXPAND;
+    w = w->next;
+    if (w == NULL || w->wu_type != WT_PARAM)
+	return WK_EXPAND;
+    const paramexp_T *p = w->wu_param;
+    if (p->pe_type != PT_NONE || p->pe_start != NULL || p->pe_end != NULL
+	    || !is_name(p->pe_name))
+	return WK_EXPAND;
+    w = w->next;
+    if (w == NULL || w->next != NULL
+	    || w->wu_type != WT_STRING || wcscmp(w->wu_string, L"\"") != 0)
+	return WK_EXPAND;
+    return WK_PARAM;
+}
+
+/* Compiles the condition of an if/while/until command like `exec_condition'.
+ * The result of the condition is left in `laststatus'. */
+void compile_condition(compiler_T *comp, const and_or_T *a)
+{
+    unsigned slot = new_slot(comp);
+    emit(comp, OP_SUPPRESS)->slot = slot;
+    compile_and_or_lists(comp, a);
+    emit(comp, OP_RESTORE)->slot = slot;
+}
+
+/* Compiles the if command like `exec_if'. */
+void compile_if(compiler_T *comp, const command_T *c)
+{
+    size_t end = new_label(comp);
+    for (const ifcommand_T *ic = c->c_ifcmds; ic != NULL; ic = ic->next) {
+	size_t next = new_label(comp);
+	emit(comp, OP_CHECK)->target = end;
+	if (ic->ic_condition != NULL) {
+	    compile_condition(comp, ic->ic_condition);
+	    emit(comp, OP_JUMP_IF_FAILURE)->target = next;
+	}
+	compile_and_or_lists(comp, ic->ic_commands);
+	emit(comp, OP_JUMP)->target = end;
+	place_label(comp, next);
+    }
+    emit(comp, OP_SET_SUCCESS);
+    place_label(comp, end);
+}
+
+/* Compiles the for command like `exec_for'. */
+void compile_for(compiler_T *comp, command_T *c)
+{
+    unsigned slot = new_slot(comp);
+    size_t top = new_label(comp), done = new_label(comp),
+	   finish = new_label(comp);
+    insn_T *insn;
+
+    emit(comp, OP_LOOP_ENTER);
+    insn = emit(comp, OP_FOR_BEGIN);
+    insn->slot = slot, insn->target = finish, insn->operand.command = c;
+
+    place_label(comp, top);
+    insn = emit(comp, OP_FOR_NEXT);
+    insn->slot = slot, insn->target = done, insn->operand.command = c;
+    if (c->c_forcmds != NULL)
+	compile_and_or_lists(comp, c->c_forcmds);
+    else
+	emit(comp, OP_HANDLE_SIGNALS);
+    compile_loop_check(comp, done, top);
+    emit(comp, OP_JUMP)->target = top;
+
+    place_label(comp, done);
+    insn = emit(comp, OP_FOR_END);
+    insn->slot = slot, insn->operand.command = c;
+    place_label(comp, finish);
+    emit(comp, OP_LOOP_LEAVE);
+}
+
+/* Compiles the while/until command like `exec_while'. */
+void compile_while(compiler_T *comp, const command_T *c)
+{
+    unsigned status = new_slot(comp), cond = new_slot(comp);
+    size_t top = new_label(comp), leave = new_label(comp),
+	   done = new_label(comp);
+    insn_T *insn;
+
+    emit(comp, OP_LOOP_ENTER);
+    emit(comp, OP_CLEAR_STATUS)->slot = status;
+
+    place_label(comp, top);
+    if (c->c_whlcond != NULL) {
+	compile_condition(comp, c->c_whlcond);
+	emit(comp, OP_SAVE_STATUS)->slot = cond;
+    } else {
+	emit(comp, OP_CLEAR_STATUS)->slot = cond;
+	emit(comp, OP_HANDLE_SIGNALS);
+    }
+    compile_loop_check(comp, done, top);
+    insn = emit(comp, c->c_whltype ? OP_JUMP_IF_NONZERO : OP_JUMP_IF_ZERO);
+    insn->slot = cond, insn->target = leave;
+
+    if (c->c_whlcmds != NULL) {
+	compile_and_or_lists(comp, c->c_whlcmds);
+	emit(comp, OP_SAVE_STATUS)->slot = status;
+    } else {
+	emit(comp, OP_HANDLE_SIGNALS);
+    }
+    compile_loop_check(comp, done, top);
+    emit(comp, OP_JUMP)->target = top;
+
+    place_label(comp, leave);
+    emit(comp, OP_LOAD_STATUS)->slot = status;
+    place_label(comp, done);
+    emit(comp, OP_LOOP_LEAVE);
+}
+
+/* Compiles the case command like `exec_case'. */
+void compile_case(compiler_T *comp, command_T *c)
+{
+    unsigned slot = new_slot(comp);
+    size_t success = new_label(comp), done = new_label(comp),
+	   end = new_label(comp);
+    insn_T *insn;
+
+    insn = emit(comp, OP_CASE_BEGIN);
+    insn->slot = slot, insn->target = end, insn->operand.command = c;
+
+    /* match the patterns, jumping to the label of the matching item */
+    size_t firstitem = comp->labelcount;
+    for (const caseitem_T *ci = c->c_casitems; ci != NULL; ci = ci->next) {
+	size_t item = new_label(comp);
+	for (void **pats = ci->ci_patterns; *pats != NULL; pats++) {
+	    insn = emit(comp, OP_CASE_MATCH);
+	    insn->slot = slot, insn->target = item, insn->target2 = done;
+	    insn->operand.pattern = *pats;
+	}
+    }
+    emit(comp, OP_JUMP)->target = success;
+
+    /* the commands of the items */
+    size_t item = firstitem;
+    for (const caseitem_T *ci = c->c_casitems; ci != NULL; ci = ci->next) {
+	place_label(comp, item++);
+	if (ci->ci_commands != NULL) {
+	    compile_and_or_lists(comp, ci->ci_commands);
+	    emit(comp, OP_JUMP)->target = done;
+	} else {
+	    emit(comp, OP_JUMP)->target = success;
+	}
+    }
+
+    place_label(comp, success);
+    emit(comp, OP_SET_SUCCESS);
+    place_label(comp, done);
+    emit(comp, OP_CASE_END)->slot = slot;
+    place_label(comp, end);
+}
+
+/* Compiles the check that is done after each part of a loop (cf. the
+ * `CHECK_LOOP' macro in `exec_for' and `exec_while'). */
+void compile_loop_check(
+	compiler_T *comp, size_t breaklabel, size_t continuelabel)
+{
+    insn_T *insn = emit(comp, OP_LOOP_CHECK);
+    insn->target = breaklabel, insn->target2 = continuelabel;
+}
+
+/* Appends a new instruction to the code.
+ * The returned pointer is valid until the next instruction is appended. */
+insn_T *emit(compiler_T *comp, opcode_T opcode)
+{
+    if (comp->length == comp->capacity) {
+	comp->capacity = (comp->capacity == 0) ? 32 : mul(comp->capacity, 2);
+	comp->code = xreallocs(comp->code,
+		sizeof *comp->code, comp->capacity, sizeof *comp->code->insns);
+    }
+
+    insn_T *insn = &comp->code->insns[comp->length++];
+    insn->opcode = opcode;
+    insn->slot = 0;
+    insn->target = insn->target2 = NO_LABEL;
+    insn->operand.command = NULL;
+    return insn;
+}
+
+/* Allocates a new slot. */
+unsigned new_slot(compiler_T *comp)
+{
+    return comp->slotcount++;
+}
+
+/* Creates a new label that is not yet placed. */
+size_t new_label(compiler_T *comp)
+{
+    if (comp->labelcount == comp->labelcapacity) {
+	comp->labelcapacity =
+	    (comp->labelcapacity == 0) ? 32 : mul(comp->labelcapacity, 2);
+	comp->labels = xreallocn(comp->labels,
+		comp->labelcapacity, sizeof *comp->labels);
+    }
+    comp->labels[comp->labelcount] = NO_LABEL;
+    return comp->labelcount++;
+}
+
+/* Makes the label point to the next instruction to be appended. */
+void place_label(compiler_T *comp, size_t label)
+{
+    assert(label < comp->labelcount);
+    comp->labels[label] = comp->length;
+}
+
+/* Runs the bytecode. */
+void run_bytecode(const struct bytecode_T *code)
+{
+    slot_T slots[code->slotcount + 1];
+    size_t pc = 0;
+
+    for (;;) {
+	const insn_T *insn = &code->insns[pc++];
+	slot_T *slot = &slots[insn->slot];
+	command_T *c = insn->operand.command;
+
+	switch (insn->opcode) {
+	case OP_END:
+	    return;
+	case OP_JUMP:
+	    pc = insn->target;
+	    break;
+	case OP_JUMP_IF_SUCCESS:
+	    if (laststatus == Exit_SUCCESS)
+		pc = insn->target;
+	    break;
+	case OP_JUMP_IF_FAILURE:
+	    if (laststatus != Exit_SUCCESS)
+		pc = insn->target;
+	    break;
+	case OP_CHECK:
+	    if (need_break())
+		pc = insn->target;
+	    break;
+	case OP_COMMANDS:
+	    exec_commands(c, E_NORMAL);
+	    break;
+	case OP_ASYNC:
+	    exec_pipelines_async(insn->operand.pipelines);
+	    break;
+	case OP_SIMPLE:
+	    exec_compiled_simple_command(insn->operand.simple);
+	    break;
+	case OP_AFTER:
+	    handle_signals();
+	    apply_errexit_errreturn(c);
+	    break;
+	case OP_LINENO:
+	    update_lineno(c->c_lineno);
+	    break;
+	case OP_SUPPRESS:
+	    slot->suppress.see = suppresserrexit;
+	    slot->suppress.ser = suppresserrreturn;
+	    suppresserrexit = suppresserrreturn = true;
+	    break;
+	case OP_RESTORE:
+	    suppresserrexit = slot->suppress.see;
+	    suppresserrreturn = slot->suppress.ser;
+	    break;
+	case OP_NEGATE:
+	    if (laststatus == Exit_SUCCESS)
+		laststatus = Exit_FAILURE;
+	    else
+		laststatus = Exit_SUCCESS;
+	    break;
+	case OP_SET_SUCCESS:
+	    laststatus = Exit_SUCCESS;
+	    break;
+	case OP_HANDLE_SIGNALS:
+	    handle_signals();
+	    break;
+	case OP_LOOP_ENTER:
+	    execstate.loopnest++;
+	    execstate.breakloopnest = execstate.loopnest;
+	    break;
+	case OP_LOOP_CHECK:
+	    if (execstate.breakloopnest < execstate.loopnest) {
+		pc = insn->target;
+	    } else if (exception == E_CONTINUE) {
+		exception = E_NONE;
+		pc = insn->target2;
+	    } else if (exception != E_NONE || is_interrupted()) {
+		pc = insn->target;
+	    }
+	    break;
+	case OP_LOOP_LEAVE:
+	    execstate.loopnest--;
+	    break;
+	case OP_SAVE_STATUS:
+	    slot->status = laststatus;
+	    break;
+	case OP_CLEAR_STATUS:
+	    slot->status = Exit_SUCCESS;
+	    break;
+	case OP_LOAD_STATUS:
+	    laststatus = slot->status;
+	    break;
+	case OP_JUMP_IF_ZERO:
+	    if (slot->status == Exit_SUCCESS)
+		pc = insn->target;
+	    break;
+	case OP_JUMP_IF_NONZERO:
+	    if (slot->status != Exit_SUCCESS)
+		pc = insn->target;
+	    break;
+	case OP_FOR_BEGIN:
+	    slot->forloop.index = 0;
+	    slot->forloop.exit = false;
+	    if (c->c_forwords != NULL) {
+		if (!expand_line(c->c_forwords,
+			    &slot->forloop.count, &slot->forloop.words)) {
+		    laststatus = Exit_EXPERROR;
+		    apply_errexit_errreturn(NULL);
+		    pc = insn->target;
+		}
+	    } else {
+		struct get_variable_T v = get_variable(L"@");
+		assert(v.type == GV_ARRAY && v.values != NULL);
+		save_get_variable_values(&v);
+		slot->forloop.count = (int) v.count;
+		slot->forloop.words = v.values;
+	    }
+	    break;
+	case OP_FOR_NEXT:
+	    if (slot->forloop.index >= slot->forloop.count) {
+		pc = insn->target;
+		break;
+	    }
+	    if (!set_variable(c->c_forname,
+			slot->forloop.words[slot->forloop.index++],
+			shopt_forlocal && !posixly_correct ?
+			    SCOPE_LOCAL : SCOPE_GLOBAL,
+			false)) {
+		laststatus = Exit_ASSGNERR;
+		apply_errexit_errreturn(NULL);
+		if (!is_interactive_now && !exit_inline_subshell(-1))
+		    slot->forloop.exit = true;
+		pc = insn->target;
+	    }
+	    break;
+	case OP_FOR_END:
+	    for (int i = slot->forloop.index; i < slot->forloop.count; i++)
+		free(slot->forloop.words[i]);
+	    free(slot->forloop.words);
+	    if (slot->forloop.count == 0 && c->c_forcmds != NULL)
+		laststatus = Exit_SUCCESS;
+	    if (slot->forloop.exit) {
+		execstate.loopnest--;
+		exit_shell();
+	    }
+	    break;
+	case OP_CASE_BEGIN:
+	    slot->word =
+		expand_single(c->c_casword, TT_SINGLE, Q_WORD, ES_NONE);
+	    if (slot->word == NULL) {
+		laststatus = Exit_EXPERROR;
+		apply_errexit_errreturn(NULL);
+		pc = insn->target;
+	    }
+	    break;
+	case OP_CASE_MATCH:;
+	    wchar_t *pattern = expand_single(insn->operand.pattern,
+		    TT_SINGLE, Q_WORD, ES_QUOTED);
+	    if (pattern == NULL) {
+		laststatus = Exit_EXPERROR;
+		apply_errexit_errreturn(NULL);
+		pc = insn->target2;
+		break;
+	    }
+	    bool match = match_pattern(slot->word, pattern);
+	    free(pattern);
+	    if (match)
+		pc = insn->target;
+	    break;
+	case OP_CASE_END:
+	    free(slot->word);
+	    break;
+	}
+    }
+}
+
+/* Executes the compiled simple command.
+ * This function has the same effect as `exec_commands(c, E_NORMAL)' except
+ * that the words are expanded according to their kinds and that a built-in
+ * found in the command search cache is called directly if the command has no
+ * redirections or assignments. */
+void exec_compiled_simple_command(const simplecommand_T *sc)
+{
+    /* prevent the command data from being freed in case the command is part of
+     * a function that is unset during execution. */
+    command_T *c = comsdup(sc->command);
 
-	xclose(pipefd[PIPE_OUT]);
-	f = fdopen(pipefd[PIPE_IN], "r");
-	if (f == NULL) {
-	    xerror(errno,
-		    Ngt("cannot open a pipe for the command substitution"));
-	    xclose(pipefd[PIPE_IN]);
-	    lastcmdsubstatus = Exit_NOEXEC;
-	    return NULL;
-	}
+    update_lineno(c->c_lineno);
+    lastcmdsubstatus = Exit_SUCCESS;
 
-	/* read output from the command */
-	xwcsbuf_T buf;
-	wint_t c;
-	wb_init(&buf);
-	while ((c = fgetwc(f)) != WEOF)
-	    wb_wccat(&buf, c);
-	fclose(f);
+    int argc;
+    void **argv;
+    bool finally_exit = false;
+    if (!expand_compiled_words(sc, &argc, &argv)) {
+	laststatus = Exit_EXPERROR;
+	goto done;
+    }
+    assert(argc > 0);
+    if (is_interrupted())
+	goto done1;
 
-	/* wait for the child to finish */
-	int savelaststatus = laststatus;
-	wait_for_child(cpid, 0, false);
-	lastcmdsubstatus = laststatus;
-	laststatus = savelaststatus;
+    const commandinfo_T *cached;
+    if (c->c_redirs == NULL && c->c_assigns == NULL
+	    && (cached = get_cached_command(c)) != NULL
+	    && is_directly_callable_builtin(cached)) {
+	/* the same as `exec_simple_command_with_words' and
+	 * `invoke_simple_command' would do for the built-in */
+	last_assign = NULL;
+	special_builtin_executed = false;
+	print_xtrace(argv);
+	yash_error_message_count = 0;
+
+	const wchar_t *savecbn = current_builtin_name;
+	current_builtin_name = argv[0];
 
-	/* trim trailing newlines and return */
-	size_t len = buf.length;
-	while (len > 0 && buf.contents[len - 1] == L'\n')
-	    len--;
-	return wb_towcs(wb_truncate(&buf, len));
+	laststatus = cached->ci_builtin(argc, argv);
+
+	current_builtin_name = savecbn;
     } else {
-	/* child process */
-	xclose(pipefd[PIPE_IN]);
-	if (pipefd[PIPE_OUT] != STDOUT_FILENO) {  /* connect the pipe */
-	    if (xdup2(pipefd[PIPE_OUT], STDOUT_FILENO) < 0)
-		exit(Exit_NOEXEC);
-	    xclose(pipefd[PIPE_OUT]);
+	/* The multibyte words can be reused only if all the words are
+	 * literal. */
+	bool literal = true;
+	for (size_t i = 0; c->c_words[i] != NULL; i++)
+	    if (sc->kinds[i] != WK_LITERAL)
+		literal = false;
+	finally_exit = exec_simple_command_with_words(
+		c, argc, argv, literal ? c->c_mbswords : NULL, false);
+    }
+
+done1:
+    plfree(argv, free);
+done:
+    if (finally_exit)
+	exit_shell();
+
+    handle_signals();
+    apply_errexit_errreturn(c);
+    comsfree(c);
+}
+
+/* Expands the words of the compiled simple command.
+ * Literal words are copied rather than expanded because built-ins may modify
+ * their arguments. The value of a variable is used for a WK_PARAM word if the
+ * variable is a set scalar; otherwise, the word is expanded normally so that
+ * the "nounset" option and arrays are handled as usual.
+ * Returns false on expansion error. */
+bool expand_compiled_words(const simplecommand_T *sc,
+	int *restrict argcp, void ***restrict argvp)
+{
+    void *const *words = sc->command->c_words;
+    plist_T list;
+    pl_init(&list);
+
+    arenamark_T mark;
+    begin_expansion(&mark);
+
+    for (size_t i = 0; words[i] != NULL; i++) {
+	const wordunit_T *w = words[i];
+	switch (sc->kinds[i]) {
+	    case WK_LITERAL:
+		pl_add(&list, xwcsdup(w->wu_string));
+		continue;
+	    case WK_PARAM:;
+		const wchar_t *value = getvar(w->next->wu_param->pe_name);
+		if (value != NULL) {
+		    pl_add(&list, xwcsdup(value));
+		    continue;
+		}
+		break;
+	    case WK_EXPAND:
+		break;
 	}
+	if (!expand_multiple(w, &list)) {
+	    end_expansion(&mark);
+	    plfree(pl_toary(&list), free);
+	    return false;
+	}
+    }
 
-	if (cmdsub->is_preparsed)
-	    exec_and_or_lists(cmdsub->value.preparsed, true);
-	else
-	    exec_wcs(cmdsub->value.unparsed, gt("command substitution"), true);
-	assert(false);
+    end_expansion(&mark);
+
+    *argcp = (int) list.length;
+    *argvp = pl_toary(&list);
+    return true;
+}
+
+/* Returns true if the built-in can be called without
+ * `exec_simple_command_with_words', that is, it is neither a special built-in,
+ * which affects the handling of errors and assignments, nor a substitutive
+ * built-in, which needs to search $PATH. */
+bool is_directly_callable_builtin(const commandinfo_T *ci)
+{
+    switch (ci->type) {
+	case CT_MANDATORYBUILTIN:
+	case CT_EXTENSIONBUILTIN:
+	    return true;
+	case CT_ELECTIVEBUILTIN:
+	    return !posixly_correct;
+	default:
+	    return false;
     }
 }
 
@@ -1829,6 +3975,21 @@ static void print_command_absolute_path(
 static void print_command_path(
 	const char *name, const char *path, bool humanfriendly)
     __attribute__((nonnull));
+static void **read_parmap_items(size_t *countp)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool run_parmap(int argc, void **argv,
+	void *const *items, size_t count, size_t jobs, int *statuses)
+    __attribute__((nonnull));
+struct parmap_T;
+struct parmap_worker_T;
+static pid_t start_parmap_worker(struct parmap_T *pm, size_t index)
+    __attribute__((nonnull));
+static void hand_parmap_item(struct parmap_worker_T *w, size_t item)
+    __attribute__((nonnull));
+static void parmap_worker(int argc, void **argv, void *const *items,
+	size_t worker, int reqfd, int resfd, int outfd)
+    __attribute__((nonnull,noreturn));
+static bool copy_parmap_output(int outfd);
 
 /* Options for the "break", "continue" and "eval" built-ins. */
 const struct xgetopt_T iter_options[] = {
@@ -2149,7 +4310,8 @@ int dot_builtin(int argc, void **argv)
 
 error:
     free(mbsfilename);
-    if (special_builtin_executed && !is_interactive_now)
+    if (special_builtin_executed && !is_interactive_now
+	    && !exit_inline_subshell(Exit_FAILURE))
 	exit_shell_with_status(Exit_FAILURE);
     return Exit_FAILURE;
 }
@@ -2199,6 +4361,13 @@ int exec_builtin(int argc, void **argv)
 	}
     }
 
+    /* The shell process must survive the subshell executed in it. */
+    if (is_in_inline_subshell()) {
+	xerror(0, Ngt("cannot be used in a subshell "
+		    "executed in the shell process"));
+	return special_builtin_error(Exit_ERROR);
+    }
+
     exec_builtin_executed = true;
 
     if (xoptind == argc)
@@ -2278,10 +4447,10 @@ int exec_builtin_2(int argc, void **argv, const wchar_t *as, bool clear)
 	}
 	envs = (char **) pl_toary(&list);
     } else {
-	envs = environ;
+	envs = get_environment();
     }
 
-    exec_external_program(commandpath, argc, mbsargv0, argv, envs);
+    exec_external_program(commandpath, argc, mbsargv0, argv, NULL, envs);
     err = laststatus;
 
     if (clear)
@@ -2426,7 +4595,8 @@ int command_builtin_execute(int argc, void **argv, enum srchcmdtype_T type)
 
     search_command(argv0, argv[0], &ci, type);
 
-    wchar_t **namep = invoke_simple_command(&ci, argc, argv0, argv, false);
+    wchar_t **namep =
+	invoke_simple_command(&ci, argc, argv0, argv, NULL, false);
     if (namep != NULL)
 	*namep = joinwcsarray(argv, L" ");
 
@@ -2578,13 +4748,26 @@ const char type_syntax[] = Ngt(
 
 #endif
 
-/* The "times" built-in. */
+/* Options for the "times" built-in. */
+const struct xgetopt_T times_options[] = {
+    { L'c', L"count", OPTARG_NONE, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",  OPTARG_NONE, false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "times" built-in, which accepts the following option:
+ *  -c: print the numbers of child processes created so far */
 int times_builtin(int argc __attribute__((unused)), void **argv)
 {
+    bool count = false;
+
     const struct xgetopt_T *opt;
     xoptind = 0;
-    while ((opt = xgetopt(argv, help_option, 0)) != NULL) {
+    while ((opt = xgetopt(argv, times_options, 0)) != NULL) {
 	switch (opt->shortopt) {
+	    case L'c':  count = true;  break;
 #if YASH_ENABLE_HELP
 	    case L'-':
 		return print_builtin_help(ARGV(0));
@@ -2597,6 +4780,12 @@ int times_builtin(int argc __attribute__((unused)), void **argv)
     if (xoptind < argc)
 	return special_builtin_error(too_many_operands_error(0));
 
+    if (count) {
+	xprintf("fork %lu\nspawn %lu\n", fork_count, spawn_count);
+	return (yash_error_message_count == 0) ?
+		Exit_SUCCESS : special_builtin_error(Exit_FAILURE);
+    }
+
     double clock;
     struct tms tms;
     intmax_t sum, ssm, cum, csm;
@@ -2631,7 +4820,549 @@ const char times_help[] = Ngt(
 "print CPU time usage"
 );
 const char times_syntax[] = Ngt(
-"\ttimes\n"
+"\ttimes [-c]\n"
+);
+#endif
+
+/* State of a worker process of the "parmap" built-in. */
+struct parmap_worker_T {
+    int reqfd;    /* writing end of the pipe that sends item indices */
+    int outfd;    /* temporary file to which the worker writes the output */
+    size_t item;  /* index of the item being processed, or SIZE_MAX if idle */
+};
+
+/* State of the "parmap" built-in shared with `start_parmap_worker'. */
+struct parmap_T {
+    int argc;                          /* number of words in `argv' */
+    void **argv;                       /* command and arguments */
+    void *const *items;                /* items passed to the command */
+    struct parmap_worker_T *workers;   /* array of the workers */
+    size_t nworkers;                   /* number of workers started */
+    int resfds[2];                     /* pipe for the reports */
+};
+
+/* Report sent from a worker to the "parmap" built-in when an item is done. */
+struct parmap_report_T {
+    size_t worker, item;
+    int status;
+};
+
+/* Options for the "parmap" built-in. */
+const struct xgetopt_T parmap_options[] = {
+    { L'a', L"array",  OPTARG_REQUIRED, false, NULL, },
+    { L'j', L"jobs",   OPTARG_REQUIRED, false, NULL, },
+    { L's', L"status", OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",   OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "parmap" built-in, which accepts the following options:
+ *  -a array: take the items from the array instead of the standard input
+ *  -j count: the number of worker processes
+ *  -s array: assign the exit status of each item to the array
+ * The command is executed once for each item in one of the worker processes
+ * forked from the shell, and the outputs are printed in the order of the
+ * items. */
+int parmap_builtin(int argc, void **argv)
+{
+    const wchar_t *arrayname = NULL, *statusname = NULL;
+    int jobs = 0;
+
+    const struct xgetopt_T *opt;
+    xoptind = 0;
+    while ((opt = xgetopt(argv, parmap_options, XGETOPT_POSIX)) != NULL) {
+	switch (opt->shortopt) {
+	    case L'a':
+		arrayname = xoptarg;
+		break;
+	    case L'j':
+		if (!xwcstoi(xoptarg, 10, &jobs)) {
+		    xerror(0, Ngt("`%ls' is not a valid integer"), xoptarg);
+		    return Exit_ERROR;
+		}
+		if (jobs <= 0) {
+		    xerror(0, Ngt("`%ls' is not a positive integer"), xoptarg);
+		    return Exit_ERROR;
+		}
+		break;
+	    case L's':
+		statusname = xoptarg;
+		if (wcschr(statusname, L'=') != NULL) {
+		    xerror(0, Ngt("`%ls' is not a valid variable name"),
+			    statusname);
+		    return Exit_ERROR;
+		}
+		break;
+#if YASH_ENABLE_HELP
+	    case L'-':
+		return print_builtin_help(ARGV(0));
+#endif
+	    default:
+		return Exit_ERROR;
+	}
+    }
+
+    if (xoptind == argc)
+	return insufficient_operands_error(1);
+
+    void **items;
+    size_t count;
+    if (arrayname != NULL) {
+	struct get_variable_T gv = get_variable(arrayname);
+	if (gv.type == GV_NOTFOUND) {
+	    xerror(0, Ngt("no such array $%ls"), arrayname);
+	    return Exit_FAILURE;
+	}
+	save_get_variable_values(&gv);
+	items = gv.values;
+	count = gv.count;
+    } else {
+	items = read_parmap_items(&count);
+	if (items == NULL)
+	    return Exit_FAILURE;
+    }
+
+    if (jobs == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	jobs = (0 < n && n <= INT_MAX) ? (int) n : 1;
+#else
+	jobs = 1;
+#endif
+    }
+
+    int *statuses = xmallocn(count, sizeof *statuses);
+    bool ok = run_parmap(argc - xoptind, &argv[xoptind],
+	    items, count, (size_t) jobs, statuses);
+    plfree(items, free);
+
+    int status = Exit_SUCCESS;
+    if (ok) {
+	for (size_t i = 0; i < count; i++) {
+	    if (statuses[i] != Exit_SUCCESS) {
+		status = statuses[i];
+		break;
+	    }
+	}
+	if (statusname != NULL) {
+	    void **values = xmallocn(count + 1, sizeof *values);
+	    for (size_t i = 0; i < count; i++)
+		values[i] = malloc_wprintf(L"%d", statuses[i]);
+	    values[count] = NULL;
+	    if (set_array(statusname, count, values, SCOPE_GLOBAL, false)
+		    == NULL)
+		status = Exit_FAILURE;
+	}
+    } else {
+	status = Exit_FAILURE;
+    }
+    free(statuses);
+
+    if (yash_error_message_count != 0 && status == Exit_SUCCESS)
+	return Exit_FAILURE;
+    return status;
+}
+
+/* Reads the standard input to the end and returns the lines as the items of
+ * the "parmap" built-in. The number of the items is assigned to `*countp'.
+ * Returns NULL on error. */
+void **read_parmap_items(size_t *countp)
+{
+    xstrbuf_T buf;
+    sb_init(&buf);
+    for (;;) {
+	sb_ensuremax(&buf, add(buf.length, BUFSIZ));
+	ssize_t n = read(STDIN_FILENO, &buf.contents[buf.length],
+		buf.maxlength - buf.length);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    xerror(errno, Ngt("cannot read input"));
+	    sb_destroy(&buf);
+	    return NULL;
+	}
+	if (n == 0)
+	    break;
+	buf.length += n;
+	buf.contents[buf.length] = '\0';
+    }
+
+    plist_T list;
+    pl_init(&list);
+    char *line = buf.contents;
+    while (line < &buf.contents[buf.length]) {
+	char *end = strchr(line, '\n');
+	if (end != NULL)
+	    *end = '\0';
+	wchar_t *item = malloc_mbstowcs(line);
+	if (item == NULL) {
+	    xerror(EILSEQ, Ngt("cannot read input"));
+	    plfree(pl_toary(&list), free);
+	    sb_destroy(&buf);
+	    return NULL;
+	}
+	pl_add(&list, item);
+	if (end == NULL)
+	    break;
+	line = end + 1;
+    }
+    sb_destroy(&buf);
+
+    *countp = list.length;
+    return pl_toary(&list);
+}
+
+/* Executes the command for each item in worker processes and prints the
+ * outputs in the order of the items. The workers are forked from the shell
+ * and managed as a job. Each worker is handed the index of an item to process
+ * through a pipe when it is idle, and reports the exit status through another
+ * pipe shared by all the workers. The exit status of each item is assigned to
+ * `statuses[i]'. A worker that dies during processing an item (for example,
+ * by the "exit" built-in) is replaced with a new one.
+ * Returns false if interrupted or no worker could be started. */
+bool run_parmap(int argc, void **argv,
+	void *const *items, size_t count, size_t jobs, int *statuses)
+{
+    if (count == 0)
+	return true;
+    if (jobs > count)
+	jobs = count;
+
+    struct parmap_T pm = {
+	.argc = argc, .argv = argv, .items = items,
+	.workers = xmallocn(jobs, sizeof *pm.workers), .nworkers = 0,
+    };
+    if (pipe(pm.resfds) < 0) {
+	xerror(errno, Ngt("cannot open a pipe"));
+	free(pm.workers);
+	return false;
+    }
+    pm.resfds[PIPE_IN] = move_to_high_fd(pm.resfds[PIPE_IN]);
+    pm.resfds[PIPE_OUT] = move_to_high_fd(pm.resfds[PIPE_OUT]);
+
+    /* start the workers */
+    job_T *job = xmallocs(sizeof *job, jobs, sizeof *job->j_procs);
+    fflush(stdout);
+    while (pm.nworkers < jobs) {
+	pid_t pid = start_parmap_worker(&pm, pm.nworkers);
+	if (pid < 0)
+	    break;
+
+	process_T *p = &job->j_procs[pm.nworkers];
+	p->pr_pid = pid;
+	p->pr_status = JS_RUNNING;
+	p->pr_statuscode = 0;
+	p->pr_name = joinwcsarray(argv, L" ");
+	p->pr_command = NULL;
+	p->pr_pipelines = NULL;
+	pm.nworkers++;
+    }
+
+    if (pm.nworkers == 0) {
+	xclose(pm.resfds[PIPE_IN]);
+	xclose(pm.resfds[PIPE_OUT]);
+	free(job);
+	free(pm.workers);
+	return false;
+    }
+
+    job->j_pgid = 0;
+    job->j_status = JS_RUNNING;
+    job->j_statuschanged = true;
+    job->j_legacy = false;
+    job->j_nonotify = true;
+    job->j_pcount = pm.nworkers;
+    set_active_job(job);
+    size_t jobnumber = add_job(false);
+
+    /* The outputs of the items that are done before their predecessors are
+     * kept in `outputs' until they can be printed. */
+    struct { char *contents; size_t length; } *outputs =
+	xmallocn(count, sizeof *outputs);
+    bool *done = xmallocn(count, sizeof *done);
+    for (size_t i = 0; i < count; i++) {
+	outputs[i].contents = NULL;
+	done[i] = false;
+    }
+    size_t nextitem = 0, nextoutput = 0, busy = 0;
+    bool ok = true;
+
+    /* hand the first items to the workers */
+    for (size_t i = 0; i < pm.nworkers; i++) {
+	hand_parmap_item(&pm.workers[i], nextitem++);
+	busy++;
+    }
+
+    while (busy > 0) {
+	switch (wait_for_input_or_sigchld(pm.resfds[PIPE_IN], true)) {
+	    case W_READY:
+		break;
+	    case W_TIMED_OUT:
+	    case W_CHILD:
+		/* Replace the workers that died during processing an item.
+		 * The items are done with the exit status of the workers. */
+		for (size_t i = 0; i < pm.nworkers; i++) {
+		    struct parmap_worker_T *w = &pm.workers[i];
+		    process_T *p = &job->j_procs[i];
+		    if (w->item == SIZE_MAX || p->pr_status != JS_DONE)
+			continue;
+		    statuses[w->item] = calc_status_of_process(p);
+		    done[w->item] = true;
+		    w->item = SIZE_MAX;
+		    busy--;
+
+		    xclose(w->reqfd);
+		    xclose(w->outfd);
+		    w->reqfd = w->outfd = -1;
+		    if (nextitem < count) {
+			pid_t pid = start_parmap_worker(&pm, i);
+			if (pid < 0)
+			    continue;
+			p->pr_pid = pid;
+			p->pr_status = JS_RUNNING;
+			job->j_status = JS_RUNNING;
+			index_job(job);
+			hand_parmap_item(w, nextitem++);
+			busy++;
+		    }
+		}
+		goto print;
+	    case W_INTERRUPTED:
+	    case W_ERROR:
+		ok = false;
+		goto finish;
+	}
+
+	struct parmap_report_T report;
+	ssize_t n = read(pm.resfds[PIPE_IN], &report, sizeof report);
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n != (ssize_t) sizeof report) {
+	    xerror(errno, Ngt("cannot read input"));
+	    ok = false;
+	    goto finish;
+	}
+	assert(report.worker < pm.nworkers);
+
+	struct parmap_worker_T *w = &pm.workers[report.worker];
+	assert(report.item == w->item);
+	statuses[report.item] = report.status;
+	done[report.item] = true;
+	if (report.item == nextoutput) {
+	    if (!copy_parmap_output(w->outfd))
+		ok = false;
+	    nextoutput++;
+	} else {
+	    /* keep the output until the preceding items are done */
+	    struct stat st;
+	    if (fstat(w->outfd, &st) < 0 || st.st_size < 0) {
+		xerror(errno, Ngt("cannot read input"));
+		st.st_size = 0;
+	    }
+	    char *contents = xmalloc((size_t) st.st_size + 1);
+	    ssize_t m = pread(w->outfd, contents, (size_t) st.st_size, 0);
+	    outputs[report.item].contents = contents;
+	    outputs[report.item].length = (m > 0) ? (size_t) m : 0;
+	}
+
+	/* hand the next item to the worker */
+	if (nextitem < count) {
+	    hand_parmap_item(w, nextitem++);
+	} else {
+	    w->item = SIZE_MAX;
+	    busy--;
+	}
+
+print:
+	/* print the kept outputs that are now in order */
+	while (nextoutput < count && done[nextoutput]) {
+	    if (outputs[nextoutput].contents != NULL) {
+		fwrite(outputs[nextoutput].contents, 1,
+			outputs[nextoutput].length, stdout);
+		free(outputs[nextoutput].contents);
+		outputs[nextoutput].contents = NULL;
+	    }
+	    nextoutput++;
+	}
+	fflush(stdout);
+    }
+
+finish:
+    /* Closing the pipes lets the workers exit. */
+    for (size_t i = 0; i < pm.nworkers; i++) {
+	if (pm.workers[i].reqfd >= 0) {
+	    xclose(pm.workers[i].reqfd);
+	    xclose(pm.workers[i].outfd);
+	}
+    }
+    xclose(pm.resfds[PIPE_IN]);
+    xclose(pm.resfds[PIPE_OUT]);
+    for (size_t i = 0; i < count; i++)
+	free(outputs[i].contents);
+    free(outputs);
+    free(done);
+    free(pm.workers);
+
+    wait_for_job(jobnumber, false, false, false);
+    remove_job(jobnumber);
+
+    if (ok && nextoutput < count)
+	ok = false;
+    return ok;
+}
+
+/* Starts a worker process for the "parmap" built-in in the `index'th slot of
+ * `pm->workers'. The pipe and temporary file for the worker are opened here.
+ * Returns the process ID of the worker, or -1 on error. */
+pid_t start_parmap_worker(struct parmap_T *pm, size_t index)
+{
+    struct parmap_worker_T *w = &pm->workers[index];
+    int reqpipe[2];
+    if (pipe(reqpipe) < 0) {
+	xerror(errno, Ngt("cannot open a pipe"));
+	return -1;
+    }
+    char *tempfile;
+    int outfd = create_temporary_file(&tempfile, "", 0);
+    if (outfd < 0) {
+	xerror(errno, Ngt("cannot create a temporary file"));
+	xclose(reqpipe[PIPE_IN]);
+	xclose(reqpipe[PIPE_OUT]);
+	return -1;
+    }
+    unlink(tempfile);
+    free(tempfile);
+    reqpipe[PIPE_IN] = move_to_high_fd(reqpipe[PIPE_IN]);
+    reqpipe[PIPE_OUT] = move_to_high_fd(reqpipe[PIPE_OUT]);
+    outfd = move_to_high_fd(outfd);
+
+    pid_t pid = fork_and_reset(-1, false, 0);
+    if (pid == 0) {
+	/* child process */
+	xclose(pm->resfds[PIPE_IN]);
+	xclose(reqpipe[PIPE_OUT]);
+	for (size_t i = 0; i < pm->nworkers; i++) {
+	    if (i != index && pm->workers[i].reqfd >= 0) {
+		xclose(pm->workers[i].reqfd);
+		xclose(pm->workers[i].outfd);
+	    }
+	}
+	parmap_worker(pm->argc, pm->argv, pm->items, index,
+		reqpipe[PIPE_IN], pm->resfds[PIPE_OUT], outfd);
+    }
+
+    xclose(reqpipe[PIPE_IN]);
+    if (pid < 0) {
+	xclose(reqpipe[PIPE_OUT]);
+	xclose(outfd);
+	return -1;
+    }
+    w->reqfd = reqpipe[PIPE_OUT];
+    w->outfd = outfd;
+    w->item = SIZE_MAX;
+    return pid;
+}
+
+/* Sends the index of an item to the idle worker. */
+void hand_parmap_item(struct parmap_worker_T *w, size_t item)
+{
+    assert(w->item == SIZE_MAX);
+    w->item = item;
+    if (!write_all(w->reqfd, &item, sizeof item))
+	xerror(errno, Ngt("cannot write to a pipe"));
+}
+
+/* Copies the contents of the worker's temporary file to the standard
+ * output. Returns false on error. */
+bool copy_parmap_output(int outfd)
+{
+    char buf[BUFSIZ];
+    off_t offset = 0;
+    ssize_t n;
+
+    fflush(stdout);
+    while ((n = pread(outfd, buf, sizeof buf, offset)) != 0) {
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    xerror(errno, Ngt("cannot read input"));
+	    return false;
+	}
+	if (!write_all(STDOUT_FILENO, buf, n))
+	    return false;
+	offset += n;
+    }
+    return true;
+}
+
+/* The main loop of a worker process of the "parmap" built-in.
+ * The worker receives the index of an item from `reqfd', executes the command
+ * with the item appended to the arguments, and reports the exit status to
+ * `resfd'. The standard output of the command is written to `outfd', which the
+ * parent reads after the report. The worker exits when `reqfd' is closed.
+ * The command is executed in a child forked for each item so that the items do
+ * not affect each other's execution environment. */
+void parmap_worker(int argc, void **argv, void *const *items,
+	size_t worker, int reqfd, int resfd, int outfd)
+{
+    xclose(STDIN_FILENO);
+    open("/dev/null", O_RDONLY);
+
+    for (;;) {
+	size_t item;
+	ssize_t n;
+	do
+	    n = read(reqfd, &item, sizeof item);
+	while (n < 0 && errno == EINTR);
+	if (n != (ssize_t) sizeof item)
+	    break;
+
+	xdup2(outfd, STDOUT_FILENO);
+	lseek(outfd, 0, SEEK_SET);
+	if (ftruncate(outfd, 0) < 0)
+	    xerror(errno, Ngt("cannot write to a temporary file"));
+
+	pid_t pid = fork_and_reset(-1, false, 0);
+	if (pid == 0) {
+	    /* child process */
+	    xclose(reqfd);
+	    xclose(resfd);
+
+	    void **args = xmallocn(argc + 2, sizeof *args);
+	    for (int i = 0; i < argc; i++)
+		args[i] = xwcsdup(argv[i]);
+	    args[argc] = xwcsdup(items[item]);
+	    args[argc + 1] = NULL;
+
+	    int status = command_builtin_execute(argc + 1, args,
+		    SCT_EXTERNAL | SCT_BUILTIN | SCT_FUNCTION);
+	    plfree(args, free);
+	    exit_shell_with_status(status);
+	}
+	if (pid < 0)
+	    laststatus = Exit_NOEXEC;
+	else
+	    wait_for_child(pid, 0, false);
+
+	struct parmap_report_T report = {
+	    .worker = worker,
+	    .item = item,
+	    .status = laststatus,
+	};
+	if (!write_all(resfd, &report, sizeof report))
+	    break;
+    }
+    exit_shell_with_status(Exit_SUCCESS);
+}
+
+#if YASH_ENABLE_HELP
+const char parmap_help[] = Ngt(
+"execute a command for each item in parallel"
+);
+const char parmap_syntax[] = Ngt(
+"\tparmap [-j count] [-s array] [-a array] command [argument...]\n"
 );
 #endif
 
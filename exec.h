@@ -43,6 +43,7 @@ typedef enum sigtype_T {
 
 extern int laststatus, savelaststatus, exitstatus;
 extern pid_t lastasyncpid;
+extern unsigned long cmdsearch_generation;
 extern _Bool special_builtin_executed;
 extern _Bool is_executing_auxiliary;
 
@@ -54,12 +55,19 @@ extern void restore_execstate(struct execstate_T *save)
     __attribute__((nonnull));
 extern void disable_return(void);
 extern void cancel_return(void);
+extern _Bool is_in_inline_subshell(void)
+    __attribute__((pure));
+extern _Bool exit_inline_subshell(int status);
+extern void enter_inline_subshell(void);
+extern void leave_inline_subshell(void);
 extern _Bool need_break(void)
     __attribute__((pure));
 
 struct and_or_T;
 struct embedcmd_T;
+struct bytecode_T;
 extern void exec_and_or_lists(const struct and_or_T *a, _Bool finally_exit);
+extern void bytecodefree(struct bytecode_T *code);
 extern struct xwcsbuf_T *get_xtrace_buffer(void);
 extern pid_t fork_and_reset(pid_t pgid, _Bool fg, sigtype_T sigtype);
 extern wchar_t *exec_command_substitution(const struct embedcmd_T *cmdsub)
@@ -129,6 +137,14 @@ extern int times_builtin(int argc, void **argv)
 #if YASH_ENABLE_HELP
 extern const char times_help[], times_syntax[];
 #endif
+extern const struct xgetopt_T times_options[];
+
+extern int parmap_builtin(int argc, void **argv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_HELP
+extern const char parmap_help[], parmap_syntax[];
+#endif
+extern const struct xgetopt_T parmap_options[];
 
 
 #endif /* YASH_EXEC_H */
@@ -20,6 +20,9 @@
 #include "expand.h"
 #include <assert.h>
 #include <errno.h>
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#endif
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -28,6 +31,7 @@
 #include <unistd.h>
 #include <wchar.h>
 #include <wctype.h>
+#include "arena.h"
 #include "arith.h"
 #include "exec.h"
 #include "input.h"
@@ -47,21 +51,79 @@
 struct expand_four_T {
     plist_T valuelist, cclist;
 };
-/* `valuelist' is a list of pointers to newly malloced wide strings that contain
- * the expanded word value. `cclist' is a list of pointers to newly malloced
- * single-byte strings whose values are charcategory_T cast to char. `cclist'
- * must have as many strings as `valuelist' and each string in `cclist' must
- * have the same length as the corresponding wide string in `valuelist'. */
+/* `valuelist' is a list of pointers to wide strings that contain the expanded
+ * word value. `cclist' is a list of pointers to single-byte strings whose
+ * values are charcategory_T cast to char. `cclist' must have as many strings as
+ * `valuelist' and each string in `cclist' must have the same length as the
+ * corresponding wide string in `valuelist'.
+ * The lists and the strings are allocated in `expand_arena' (see the `fl_' and
+ * `fb_' functions below), so the `pl_' functions must not be used on them. */
+
+/* field being built in `expand_arena' */
+struct fieldbuf_T {
+    wchar_t *value;   /* value of the field */
+    char *cc;         /* corresponding charcategory_T string */
+    size_t length;    /* length of `value' and `cc' */
+    size_t maxlength; /* capacity of `value' and `cc' minus one */
+};
+
+/* set of charcategory_T values, in which value `c' is represented by the bit
+ * `CCSET(c)' */
+typedef unsigned ccset_T;
+#define CCSET(c) (1U << (c))
+
+/* maximum number of distinct IFS characters for which the SIMD scanner is
+ * used */
+#define IFS_SIMD_MAX 4
+
+/* IFS value compiled for field splitting */
+struct ifsinfo_T {
+    wchar_t *value;          /* the IFS value compiled */
+    uint32_t chars[4];       /* bitmap of ASCII IFS characters */
+    uint32_t whitespaces[4]; /* bitmap of ASCII IFS whitespaces */
+    wchar_t *others;         /* non-ASCII IFS characters */
+    bool simd;               /* whether the SIMD scanner can be used */
+    size_t simdcount;        /* number of characters in `simdchars' */
+    wchar_t simdchars[IFS_SIMD_MAX];
+};
+
+static void fl_init(plist_T *list)
+    __attribute__((nonnull));
+static void fl_add(plist_T *list, void *p)
+    __attribute__((nonnull(1)));
+static inline void fb_init(struct fieldbuf_T *fb)
+    __attribute__((nonnull));
+static void fb_ensure(struct fieldbuf_T *fb, size_t n)
+    __attribute__((nonnull));
+static void fb_ncat(struct fieldbuf_T *restrict fb,
+	const wchar_t *restrict s, size_t n, charcategory_T cc)
+    __attribute__((nonnull));
+static void fb_nccat(struct fieldbuf_T *restrict fb,
+	const wchar_t *restrict s, const char *restrict cc, size_t n)
+    __attribute__((nonnull));
+static inline void fb_wccat(
+	struct fieldbuf_T *fb, wchar_t c, charcategory_T cc)
+    __attribute__((nonnull));
+static void fb_catfree(
+	struct fieldbuf_T *restrict fb, wchar_t *restrict s, charcategory_T cc)
+    __attribute__((nonnull));
+static void fb_add_to(struct fieldbuf_T *restrict fb,
+	plist_T *restrict valuelist, plist_T *restrict cclist)
+    __attribute__((nonnull));
+static wchar_t *size_to_wcs_in_arena(size_t n)
+    __attribute__((malloc,warn_unused_result));
 
 static plist_T expand_word(const wordunit_T *w)
     __attribute__((warn_unused_result));
+static cc_word_T expand_single_cc_in_arena(
+	const wordunit_T *w, tildetype_T tilde, quoting_T quoting)
+    __attribute__((warn_unused_result));
+static wchar_t *expand_single_in_arena(const wordunit_T *w,
+	tildetype_T tilde, quoting_T quoting, escaping_T escaping)
+    __attribute__((malloc,warn_unused_result));
 static struct expand_four_T expand_four(const wordunit_T *restrict w,
 	tildetype_T tilde, quoting_T quoting, charcategory_T defaultcc)
     __attribute__((warn_unused_result));
-static inline void fill_ccbuf(
-	const xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf,
-	charcategory_T c)
-    __attribute__((nonnull));
 
 static wchar_t *expand_tilde(const wchar_t **ss,
 	bool hasnextwordunit, tildetype_T tt)
@@ -71,12 +133,15 @@ enum indextype_T { IDX_NONE, IDX_ALL, IDX_CONCAT, IDX_NUMBER, };
 
 static struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     __attribute__((nonnull));
+static struct get_variable_T get_variable_in_arena(
+	const wchar_t *name, bool *unset)
+    __attribute__((nonnull,warn_unused_result));
+static void **make_array_in_arena(wchar_t *s)
+    __attribute__((malloc,warn_unused_result));
 static enum indextype_T parse_indextype(const wchar_t *indexstr)
     __attribute__((nonnull,pure));
 static wchar_t *trim_wstring(wchar_t *s, ssize_t startindex, ssize_t endindex)
     __attribute__((nonnull));
-static void **trim_array(void **a, ssize_t startindex, ssize_t endindex)
-    __attribute__((nonnull));
 static void print_subst_as_error(const paramexp_T *p, quoting_T quoting)
     __attribute__((nonnull));
 static void match_each(void **restrict slist, const wchar_t *restrict pattern,
@@ -85,16 +150,14 @@ static void match_each(void **restrict slist, const wchar_t *restrict pattern,
 static void subst_each(void **restrict slist, const wchar_t *pattern,
 	const wchar_t *subst, paramexptype_T type)
     __attribute__((nonnull));
-static wchar_t *concatenate_values(void **values, bool escape)
-    __attribute__((nonnull,malloc,warn_unused_result));
-static void **concatenate_values_into_array(void **values, bool escape)
+static void **concatenate_values_into_array(void **values)
     __attribute__((nonnull,malloc,warn_unused_result));
 static void subst_length_each(void **slist)
     __attribute__((nonnull));
 static void merge_expand_four(
 	struct expand_four_T *restrict from,
 	struct expand_four_T *restrict to,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
     __attribute__((nonnull));
 
 /* data used in brace expansion */
@@ -116,11 +179,11 @@ static void expand_brace(
     __attribute__((nonnull));
 static void generate_brace_expand_results(
 	const struct brace_expand_T *restrict e, size_t ci,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
     __attribute__((nonnull));
 static bool try_expand_brace_sequence(
 	const struct brace_expand_T *restrict e, size_t ci,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
     __attribute__((nonnull));
 static bool has_leading_zero(const wchar_t *restrict s, bool *restrict sign)
     __attribute__((nonnull));
@@ -128,11 +191,27 @@ static bool has_leading_zero(const wchar_t *restrict s, bool *restrict sign)
 static void fieldsplit(void **restrict valuelist, void **restrict cclist,
 	plist_T *restrict outvaluelist, plist_T *restrict outcclist)
     __attribute__((nonnull));
-static bool is_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+static const struct ifsinfo_T *compile_ifs(const wchar_t *ifs)
+    __attribute__((nonnull));
+static size_t skip_non_ifs_chars(const wchar_t *restrict s,
+	const char *restrict cc, size_t index, size_t length,
+	const struct ifsinfo_T *restrict ifs)
     __attribute__((nonnull,pure));
-static bool is_ifs_whitespace(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+#if HAVE_X86_SIMD
+static size_t find_ifs_candidate_sse2(const wchar_t *restrict s,
+	size_t index, size_t length, const struct ifsinfo_T *restrict ifs)
+    __attribute__((nonnull,pure));
+static size_t find_ifs_candidate_avx2(const wchar_t *restrict s,
+	size_t index, size_t length, const struct ifsinfo_T *restrict ifs)
+    __attribute__((nonnull,pure,target("avx2")));
+#endif
+static inline bool ifs_contains(const struct ifsinfo_T *ifs, wchar_t c)
     __attribute__((nonnull,pure));
-static bool is_non_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+static bool is_ifs_char(
+	wchar_t c, charcategory_T cc, const struct ifsinfo_T *ifs)
+    __attribute__((nonnull,pure));
+static bool is_ifs_whitespace(
+	wchar_t c, charcategory_T cc, const struct ifsinfo_T *ifs)
     __attribute__((nonnull,pure));
 static void add_empty_field(plist_T *dest, const wchar_t *p)
     __attribute__((nonnull));
@@ -142,8 +221,19 @@ static inline void add_sq(
     __attribute__((nonnull));
 static inline bool should_escape(charcategory_T cc, escaping_T escaping)
     __attribute__((const));
-static wchar_t *quote_removal_free(
-	wchar_t *restrict s, char *restrict cc, escaping_T escaping)
+static ccset_T ccset_of(const char *cc, size_t length)
+    __attribute__((nonnull,pure));
+static ccset_T ccset_to_process(escaping_T escaping)
+    __attribute__((const));
+static size_t trim_quotation_marks(
+	const wchar_t *restrict *s, const char *restrict *cc)
+    __attribute__((nonnull));
+static size_t quote_removal_into(wchar_t *restrict dest,
+	const wchar_t *restrict s, const char *restrict cc, size_t length,
+	escaping_T escaping)
+    __attribute__((nonnull));
+static wchar_t *quote_removal_in_arena(
+	const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
     __attribute__((nonnull,malloc,warn_unused_result));
 
 static enum wglobflags_T get_wglobflags(void)
@@ -154,9 +244,32 @@ static void glob_all(
 
 static void maybe_exit_on_error(void);
 
+/* The arena in which the intermediate results of expansion are allocated.
+ * Each expansion scope (see `begin_expansion') releases the objects allocated
+ * in it when the final results have been copied out. */
+static arena_T expand_arena = ARENA_INIT;
+
 
 /********** Entry Points **********/
 
+/* Starts an expansion scope.
+ * The intermediate results of the expansions performed until the matching
+ * `end_expansion' are allocated in an arena and freed at once by
+ * `end_expansion'. The current position of the arena is saved in `*mark'.
+ * Scopes may be nested. */
+void begin_expansion(arenamark_T *mark)
+{
+    ARENA_COUNT_HEAP(&expand_arena, true);
+    *mark = arena_mark(&expand_arena);
+}
+
+/* Ends the expansion scope started by `begin_expansion'. */
+void end_expansion(const arenamark_T *mark)
+{
+    arena_release(&expand_arena, mark);
+    ARENA_COUNT_HEAP(&expand_arena, false);
+}
+
 /* Expands a command line.
  * `args' is a NULL-terminated array of pointers to `const wordunit_T'
  * to expand.
@@ -170,24 +283,63 @@ static void maybe_exit_on_error(void);
 bool expand_line(void *const *restrict args,
     int *restrict argcp, void ***restrict argvp)
 {
-    plist_T list;
+    char **mbsargv;
+    return expand_command_words(args, NULL, argcp, argvp, &mbsargv);
+}
+
+/* Expands the words of a simple command.
+ * This function is like `expand_line', but literal words are not expanded.
+ * `mbswords' must be NULL or an array that tells literal words in `args' as
+ * described for `c_mbswords' in parser.h. A literal word is copied to the
+ * results as is.
+ * If successful and `mbswords' is non-NULL, a newly malloced array of `*argcp'
+ * pointers is assigned to `*mbsargvp'. Each element points to the multibyte
+ * form of the corresponding result in `mbswords' if the result is a literal
+ * word, or is NULL otherwise. The elements must not be freed. If `mbswords' is
+ * NULL, `*mbsargvp' is NULL. */
+bool expand_command_words(
+	void *const *restrict args, char *const *restrict mbswords,
+	int *restrict argcp, void ***restrict argvp, char ***restrict mbsargvp)
+{
+    plist_T list, mbslist;
     pl_init(&list);
+    if (mbswords != NULL)
+	pl_init(&mbslist);
+
+    arenamark_T mark;
+    begin_expansion(&mark);
 
-    for (; *args != NULL; args++) {
-	if (!expand_multiple(*args, &list)) {
+    for (size_t i = 0; args[i] != NULL; i++) {
+	if (mbswords != NULL && mbswords[i] != NULL) {
+	    const wordunit_T *w = args[i];
+	    pl_add(&list, xwcsdup(w->wu_string));
+	    pl_add(&mbslist, mbswords[i]);
+	    continue;
+	}
+	if (!expand_multiple(args[i], &list)) {
+	    end_expansion(&mark);
 	    plfree(pl_toary(&list), free);
+	    if (mbswords != NULL)
+		pl_destroy(&mbslist);
 	    return false;
 	}
+	if (mbswords != NULL)
+	    while (mbslist.length < list.length)
+		pl_add(&mbslist, NULL);
     }
 
+    end_expansion(&mark);
+
     *argcp = list.length;
     *argvp = pl_toary(&list);
+    *mbsargvp = (mbswords != NULL) ? (char **) pl_toary(&mbslist) : NULL;
     return true;
 }
 
 /* Expands a word.
  * The results, which are added to `list' as newly-malloced wide strings, may
  * be multiple words.
+ * This function must be called in an expansion scope (see `begin_expansion').
  * The return value is true iff successful.
  * On error in a non-interactive shell, the shell exits. */
 bool expand_multiple(const wordunit_T *w, plist_T *list)
@@ -200,29 +352,25 @@ bool expand_multiple(const wordunit_T *w, plist_T *list)
     }
 
     /* brace expansion (valuelist -> valuelist2) */
-    plist_T valuelist2, cclist2;
     if (shopt_braceexpand) {
-	pl_init(&valuelist2);
-	pl_init(&cclist2);
+	struct expand_four_T expand2;
+	fl_init(&expand2.valuelist);
+	fl_init(&expand2.cclist);
 	expand_brace_each(expand.valuelist.contents, expand.cclist.contents,
-		&valuelist2, &cclist2);
-	pl_truncate(&expand.valuelist, 0);
-	pl_truncate(&expand.cclist, 0);
-    } else {
-	valuelist2 = expand.valuelist;
-	cclist2 = expand.cclist;
-	pl_init(&expand.valuelist);
-	pl_init(&expand.cclist);
+		&expand2.valuelist, &expand2.cclist);
+	expand = expand2;
     }
 
-    /* field splitting (valuelist2 -> valuelist) */
-    fieldsplit(pl_toary(&valuelist2), pl_toary(&cclist2),
-	    &expand.valuelist, &expand.cclist);
-    assert(expand.valuelist.length == expand.cclist.length);
+    /* field splitting (valuelist -> valuelist2) */
+    struct expand_four_T expand2;
+    fl_init(&expand2.valuelist);
+    fl_init(&expand2.cclist);
+    fieldsplit(expand.valuelist.contents, expand.cclist.contents,
+	    &expand2.valuelist, &expand2.cclist);
+    assert(expand2.valuelist.length == expand2.cclist.length);
 
     /* pathname expansion (and quote removal) */
-    glob_all(&expand, list);
-
+    glob_all(&expand2, list);
     return true;
 }
 
@@ -230,9 +378,27 @@ bool expand_multiple(const wordunit_T *w, plist_T *list)
  * If successful, the result is a pair of newly malloced strings.
  * On error, an error message is printed and a NULL pair is returned.
  * On error in a non-interactive shell, the shell exits. */
+struct cc_word_T expand_single_cc(
+	const wordunit_T *w, tildetype_T tilde, quoting_T quoting)
+{
+    arenamark_T mark;
+    begin_expansion(&mark);
+
+    cc_word_T e = expand_single_cc_in_arena(w, tilde, quoting);
+    if (e.value != NULL) {
+	size_t length = wcslen(e.value);
+	e.value = xwcsndup(e.value, length);
+	e.cc = memcpy(xmalloc(add(length, 1)), e.cc, add(length, 1));
+    }
+
+    end_expansion(&mark);
+    return e;
+}
+
+/* Like `expand_single_cc', but the result is allocated in `expand_arena'. */
 /* This function first expands the word into (possibly many) fields and then
  * concatenates into one field. */
-struct cc_word_T expand_single_cc(
+cc_word_T expand_single_cc_in_arena(
 	const wordunit_T *w, tildetype_T tilde, quoting_T quoting)
 {
     struct expand_four_T e = expand_four(w, tilde, quoting, CC_LITERAL);
@@ -241,43 +407,30 @@ struct cc_word_T expand_single_cc(
 	maybe_exit_on_error();
 	return (struct cc_word_T) { NULL, NULL };
     }
+    if (e.valuelist.length == 1)
+	return (struct cc_word_T) {
+	    e.valuelist.contents[0], e.cclist.contents[0] };
 
     const wchar_t *ifs = getvar(L VAR_IFS);
     wchar_t separator = ifs != NULL ? ifs[0] : L' ';
 
-    size_t totallength;
-    if (e.valuelist.length == 0)
-	totallength = 0;
-    else {
-	totallength = e.valuelist.length - 1;
-	for (size_t i = 0; i < e.valuelist.length; i++)
-	    totallength = add(totallength, wcslen(e.valuelist.contents[i]));
-    }
-
-    xwcsbuf_T valuebuf;
-    xstrbuf_T ccbuf;
-    wb_initwithmax(&valuebuf, totallength);
-    sb_initwithmax(&ccbuf, totallength);
+    struct fieldbuf_T fb;
+    fb_init(&fb);
+    fb_ensure(&fb, 0);
     for (size_t i = 0; i < e.valuelist.length; i++) {
-	if (i > 0 && separator != L'\0') {
-	    wb_wccat(&valuebuf, separator);
-	    sb_ccat(&ccbuf, CC_SOFT_EXPANSION);
-	}
-	wb_catfree(&valuebuf, e.valuelist.contents[i]);
-	sb_ncat_force(
-		&ccbuf, e.cclist.contents[i], valuebuf.length - ccbuf.length);
-	free(e.cclist.contents[i]);
+	if (i > 0 && separator != L'\0')
+	    fb_wccat(&fb, separator, CC_SOFT_EXPANSION);
+	const wchar_t *value = e.valuelist.contents[i];
+	fb_nccat(&fb, value, e.cclist.contents[i], wcslen(value));
     }
-
-    pl_destroy(&e.valuelist);
-    pl_destroy(&e.cclist);
-    return (struct cc_word_T) { wb_towcs(&valuebuf), sb_tostr(&ccbuf) };
+    return (struct cc_word_T) { fb.value, fb.cc };
 }
 
 /* Expands a word to (possibly any number of) fields.
- * If successful, the return value is a plist_T containing newly malloced wide
- * strings. In most cases, the plist_T contains one string. If the word contains
- * "$@", however, it may contain any number of strings.
+ * If successful, the return value is a list of wide strings. In most cases,
+ * the list contains one string. If the word contains "$@", however, it may
+ * contain any number of strings. The list and the strings are allocated in
+ * `expand_arena'.
  * On error, the return value is a plist_T with `contents' being NULL. */
 plist_T expand_word(const wordunit_T *w)
 {
@@ -286,11 +439,9 @@ plist_T expand_word(const wordunit_T *w)
 
     /* quote removal */
     for (size_t i = 0; i < expand.valuelist.length; i++)
-	expand.valuelist.contents[i] = quote_removal_free(
+	expand.valuelist.contents[i] = quote_removal_in_arena(
 	    expand.valuelist.contents[i], expand.cclist.contents[i], ES_NONE);
 
-    pl_destroy(&expand.cclist);
-
     return expand.valuelist;
 }
 
@@ -302,10 +453,28 @@ plist_T expand_word(const wordunit_T *w)
 wchar_t *expand_single(const wordunit_T *w,
 	tildetype_T tilde, quoting_T quoting, escaping_T escaping)
 {
-    cc_word_T e = expand_single_cc(w, tilde, quoting);
+    arenamark_T mark;
+    begin_expansion(&mark);
+
+    wchar_t *result;
+    cc_word_T e = expand_single_cc_in_arena(w, tilde, quoting);
+    if (e.value == NULL)
+	result = NULL;
+    else
+	result = quote_removal(e.value, e.cc, escaping);
+
+    end_expansion(&mark);
+    return result;
+}
+
+/* Like `expand_single', but the result is allocated in `expand_arena'. */
+wchar_t *expand_single_in_arena(const wordunit_T *w,
+	tildetype_T tilde, quoting_T quoting, escaping_T escaping)
+{
+    cc_word_T e = expand_single_cc_in_arena(w, tilde, quoting);
     if (e.value == NULL)
 	return NULL;
-    return quote_removal_free(e.value, e.cc, escaping);
+    return quote_removal_in_arena(e.value, e.cc, escaping);
 }
 
 /* Expands a single word: the four expansions, pathname expansion, and quote
@@ -321,18 +490,19 @@ wchar_t *expand_single(const wordunit_T *w,
  * On error in a non-interactive shell, the shell exits. */
 char *expand_single_with_glob(const wordunit_T *arg)
 {
-    cc_word_T e = expand_single_cc(arg, TT_SINGLE, Q_WORD);
+    arenamark_T mark;
+    begin_expansion(&mark);
+
+    cc_word_T e = expand_single_cc_in_arena(arg, TT_SINGLE, Q_WORD);
     if (e.value == NULL)
 	goto return_null;
 
     if (!shopt_glob)
 	goto quote_removal;
 
-    wchar_t *pattern = quote_removal(e.value, e.cc, ES_QUOTED_HARD);
-    if (!is_pathname_matching_pattern(pattern)) {
-	free(pattern);
+    wchar_t *pattern = quote_removal_in_arena(e.value, e.cc, ES_QUOTED_HARD);
+    if (!is_pathname_matching_pattern(pattern))
 	goto quote_removal;
-    }
 
     plist_T globresults;
     bool ok;
@@ -342,7 +512,6 @@ char *expand_single_with_glob(const wordunit_T *arg)
     set_interruptible_by_sigint(true);
     ok = wglob(pattern, get_wglobflags(), &globresults);
     set_interruptible_by_sigint(false);
-    free(pattern);
     if (!ok) {
 	plfree(pl_toary(&globresults), free);
 	xerror(EINTR, Ngt("redirection"));
@@ -357,9 +526,8 @@ char *expand_single_with_glob(const wordunit_T *arg)
     } else {
 	plfree(pl_toary(&globresults), free);
 	if (!posixly_correct) {
-	    wchar_t *word = quote_removal(e.value, e.cc, ES_NONE);
+	    wchar_t *word = quote_removal_in_arena(e.value, e.cc, ES_NONE);
 	    xerror(0, Ngt("filename `%ls' matches more than one file"), word);
-	    free(word);
 	    goto return_null;
 	}
 quote_removal:
@@ -369,24 +537,158 @@ quote_removal:
     char *mbresult = realloc_wcstombs(wresult);
     if (mbresult == NULL)
 	xerror(EILSEQ, Ngt("redirection"));
-    free(e.value);
-    free(e.cc);
+    end_expansion(&mark);
     return mbresult;
 
 return_null:
-    free(e.value);
-    free(e.cc);
+    end_expansion(&mark);
     return NULL;
 }
 
 
+/********** Arena-Backed Lists and Buffers **********/
+
+/* Initializes a list of pointers allocated in `expand_arena'.
+ * The list is always NULL-terminated, so `list->contents' can be used as a
+ * NULL-terminated array at any time. The list need not be destroyed. */
+void fl_init(plist_T *list)
+{
+    list->length = 0;
+    list->maxlength = 7;
+    list->contents = arena_alloc(&expand_arena,
+	    (list->maxlength + 1) * sizeof *list->contents);
+    list->contents[0] = NULL;
+}
+
+/* Appends `p' to the list initialized by `fl_init'. */
+void fl_add(plist_T *list, void *p)
+{
+    if (list->length == list->maxlength) {
+	size_t newmax = mul(list->maxlength, 2);
+	void **newcontents = arena_alloc(&expand_arena,
+		mul(add(newmax, 1), sizeof *newcontents));
+	memcpy(newcontents, list->contents,
+		list->length * sizeof *newcontents);
+	list->contents = newcontents;
+	list->maxlength = newmax;
+    }
+    list->contents[list->length++] = p;
+    list->contents[list->length] = NULL;
+}
+
+/* Initializes a field buffer.
+ * No memory is allocated until something is appended to the buffer. */
+void fb_init(struct fieldbuf_T *fb)
+{
+    fb->value = NULL;
+    fb->cc = NULL;
+    fb->length = fb->maxlength = 0;
+}
+
+/* Makes sure the field buffer has room for `n' more characters.
+ * The buffer grows by allocating new arrays in `expand_arena'. The old arrays
+ * are left in the arena. */
+void fb_ensure(struct fieldbuf_T *fb, size_t n)
+{
+    size_t newlength = add(fb->length, n);
+    if (fb->value != NULL && newlength <= fb->maxlength)
+	return;
+
+    size_t newmax = mul(fb->maxlength, 2);
+    if (newmax < 15)
+	newmax = 15;
+    if (newmax < newlength)
+	newmax = newlength;
+
+    wchar_t *newvalue = arena_alloc(&expand_arena,
+	    mul(add(newmax, 1), sizeof *newvalue));
+    char *newcc = arena_alloc(&expand_arena, add(newmax, 1));
+    if (fb->length > 0) {
+	wmemcpy(newvalue, fb->value, fb->length);
+	memcpy(newcc, fb->cc, fb->length);
+    }
+    newvalue[fb->length] = L'\0';
+    newcc[fb->length] = '\0';
+    fb->value = newvalue;
+    fb->cc = newcc;
+    fb->maxlength = newmax;
+}
+
+/* Appends the first `n' characters of `s' to the field buffer. Each character
+ * is categorized as `cc'. */
+void fb_ncat(struct fieldbuf_T *restrict fb,
+	const wchar_t *restrict s, size_t n, charcategory_T cc)
+{
+    fb_ensure(fb, n);
+    wmemcpy(&fb->value[fb->length], s, n);
+    memset(&fb->cc[fb->length], cc, n);
+    fb->length += n;
+    fb->value[fb->length] = L'\0';
+    fb->cc[fb->length] = '\0';
+}
+
+/* Appends the first `n' characters of `s' and `cc' to the field buffer. */
+void fb_nccat(struct fieldbuf_T *restrict fb,
+	const wchar_t *restrict s, const char *restrict cc, size_t n)
+{
+    fb_ensure(fb, n);
+    wmemcpy(&fb->value[fb->length], s, n);
+    memcpy(&fb->cc[fb->length], cc, n);
+    fb->length += n;
+    fb->value[fb->length] = L'\0';
+    fb->cc[fb->length] = '\0';
+}
+
+/* Appends character `c' categorized as `cc' to the field buffer. */
+void fb_wccat(struct fieldbuf_T *fb, wchar_t c, charcategory_T cc)
+{
+    fb_ensure(fb, 1);
+    fb->value[fb->length] = c;
+    fb->cc[fb->length] = cc;
+    fb->length++;
+    fb->value[fb->length] = L'\0';
+    fb->cc[fb->length] = '\0';
+}
+
+/* Appends the freeable string `s' categorized as `cc' to the field buffer and
+ * frees `s'. */
+void fb_catfree(
+	struct fieldbuf_T *restrict fb, wchar_t *restrict s, charcategory_T cc)
+{
+    fb_ncat(fb, s, wcslen(s), cc);
+    free(s);
+}
+
+/* Adds the contents of the field buffer to the lists as a field and
+ * re-initializes the buffer. */
+void fb_add_to(struct fieldbuf_T *restrict fb,
+	plist_T *restrict valuelist, plist_T *restrict cclist)
+{
+    fb_ensure(fb, 0);
+    fl_add(valuelist, fb->value);
+    fl_add(cclist, fb->cc);
+    fb_init(fb);
+}
+
+/* Converts the specified number into a wide string allocated in
+ * `expand_arena'. */
+wchar_t *size_to_wcs_in_arena(size_t n)
+{
+    wchar_t buf[3 * sizeof n + 1];
+    int length = swprintf(buf, sizeof buf / sizeof *buf, L"%zu", n);
+    assert(length >= 0);
+    return arena_wcsndup(&expand_arena, buf, length);
+}
+
+
 /********** Four Expansions **********/
 
 /* Performs the four expansions, i.e., tilde expansion, parameter expansion,
  * command substitution, and arithmetic expansion.
  * If successful, `valuelist' in the return value is the list of the resultant
- * fields, which are newly malloced wide strings, and `cclist' is the list of
- * the corresponding charcategory_T strings, which are also newly malloced.
+ * fields, which are wide strings, and `cclist' is the list of the
+ * corresponding charcategory_T strings. The lists and the strings are
+ * allocated in `expand_arena'.
  * Usually this function produces one or more fields, but it may produce zero
  * fields if "$@" is expanded with no positional parameters.
  * If unsuccessful, `valuelist' and `cclist' are empty and have NULL `contents'.
@@ -396,16 +698,12 @@ struct expand_four_T expand_four(const wordunit_T *restrict w,
 {
     /* lists to insert the final results into */
     struct expand_four_T e;
-    pl_init(&e.valuelist);
-    pl_init(&e.cclist);
+    fl_init(&e.valuelist);
+    fl_init(&e.cclist);
 
     /* intermediate value of the currently expanded word */
-    xwcsbuf_T valuebuf;
-    wb_init(&valuebuf);
-
-    /* charcategory_T string corresponding to `valuebuf' */
-    xstrbuf_T ccbuf;
-    sb_init(&ccbuf);
+    struct fieldbuf_T fb;
+    fb_init(&fb);
 
     bool indq = false;  /* in a double quote? */
     bool first = true;  /* is the first word unit? */
@@ -428,11 +726,9 @@ struct expand_four_T expand_four(const wordunit_T *restrict w,
 	    ss = w->wu_string;
 	    if (first && tilde != TT_NONE) {
 		s = expand_tilde(&ss, w->next, tilde);
-		if (s != NULL) {
-		    wb_catfree(&valuebuf, s);
-		    fill_ccbuf(&valuebuf, &ccbuf,
+		if (s != NULL)
+		    fb_catfree(&fb, s,
 			    CC_HARD_EXPANSION | (defaultcc & CC_QUOTED));
-		}
 	    }
 	    while (*ss != L'\0') {
 		switch (*ss) {
@@ -449,31 +745,28 @@ struct expand_four_T expand_four(const wordunit_T *restrict w,
 		    } else {
 			indq = false; /* leaving a quotation */
 			if (removedq && e.valuelist.length == 0 &&
-				wcscmp(valuebuf.contents, L"\"") == 0 &&
-				(ccbuf.contents[0] & CC_QUOTATION)) {
+				fb.length == 1 && fb.value[0] == L'"' &&
+				(fb.cc[0] & CC_QUOTATION)) {
 			    /* remove the corresponding opening double-quote */
-			    wb_clear(&valuebuf);
-			    sb_clear(&ccbuf);
+			    fb.length = 0;
 			    removeempty = true;
 			    break; /* and ignore the closing double-quote */
 			}
 		    }
-		    wb_wccat(&valuebuf, L'"');
-		    sb_ccat(&ccbuf, defaultcc | CC_QUOTATION);
+		    fb_wccat(&fb, L'"', defaultcc | CC_QUOTATION);
 		    break;
 		case L'\'':
 		    if (quoting != Q_WORD || indq)
 			goto default_;
 
-		    wb_wccat(&valuebuf, L'\'');
-		    sb_ccat(&ccbuf, defaultcc | CC_QUOTATION);
+		    fb_wccat(&fb, L'\'', defaultcc | CC_QUOTATION);
 
-		    add_sq(&ss, &valuebuf, false);
-		    assert(*ss == L'\'');
-		    fill_ccbuf(&valuebuf, &ccbuf, defaultcc | CC_QUOTED);
+		    const wchar_t *end = wcschr(ss + 1, L'\'');
+		    assert(end != NULL);
+		    fb_ncat(&fb, ss + 1, end - (ss + 1), defaultcc | CC_QUOTED);
+		    ss = end;
 
-		    wb_wccat(&valuebuf, L'\'');
-		    sb_ccat(&ccbuf, defaultcc | CC_QUOTATION);
+		    fb_wccat(&fb, L'\'', defaultcc | CC_QUOTATION);
 		    break;
 		case L'\\':
 		    switch (quoting) {
@@ -493,32 +786,25 @@ struct expand_four_T expand_four(const wordunit_T *restrict w,
 			    goto default_;
 		    }
 
-		    wb_wccat(&valuebuf, L'\\');
-		    sb_ccat(&ccbuf, defaultcc | CC_QUOTATION);
+		    fb_wccat(&fb, L'\\', defaultcc | CC_QUOTATION);
 		    ss++;
-		    if (*ss != L'\0') {
-			wb_wccat(&valuebuf, *ss++);
-			sb_ccat(&ccbuf, defaultcc | CC_QUOTED);
-		    }
+		    if (*ss != L'\0')
+			fb_wccat(&fb, *ss++, defaultcc | CC_QUOTED);
 		    continue;
 		case L':':
 		    if (indq || tilde != TT_MULTI)
 			goto default_;
 
 		    /* perform tilde expansion after a colon */
-		    wb_wccat(&valuebuf, L':');
-		    sb_ccat(&ccbuf, defaultcc);
+		    fb_wccat(&fb, L':', defaultcc);
 		    ss++;
 		    s = expand_tilde(&ss, w->next, tilde);
-		    if (s != NULL) {
-			wb_catfree(&valuebuf, s);
-			fill_ccbuf(&valuebuf, &ccbuf, CC_HARD_EXPANSION);
-		    }
+		    if (s != NULL)
+			fb_catfree(&fb, s, CC_HARD_EXPANSION);
 		    continue;
 default_:
 		default:
-		    wb_wccat(&valuebuf, *ss);
-		    sb_ccat(&ccbuf, defaultcc | (indq * CC_QUOTED));
+		    fb_wccat(&fb, *ss, defaultcc | (indq * CC_QUOTED));
 		    break;
 		}
 		ss++;
@@ -535,7 +821,7 @@ default_:
 		else
 		    removeempty = true;
 	    }
-	    merge_expand_four(&e2, &e, &valuebuf, &ccbuf);
+	    merge_expand_four(&e2, &e, &fb);
 	    break;
 	case WT_CMDSUB:
 	    s = exec_command_substitution(&w->wu_cmdsub);
@@ -547,41 +833,24 @@ default_:
 cat_s:
 	    if (s == NULL)
 		goto failure;
-	    wb_catfree(&valuebuf, s);
-	    fill_ccbuf(&valuebuf, &ccbuf, CC_SOFT_EXPANSION |
+	    fb_catfree(&fb, s, CC_SOFT_EXPANSION |
 		    (indq * CC_QUOTED) | (defaultcc & CC_QUOTED));
 	    break;
 	}
     }
 
     /* empty field removal */
-    if (removeempty && e.valuelist.length == 0 && valuebuf.length == 0) {
-	wb_destroy(&valuebuf);
-	sb_destroy(&ccbuf);
-    } else {
-	pl_add(&e.valuelist, wb_towcs(&valuebuf));
-	pl_add(&e.cclist, sb_tostr(&ccbuf));
-    }
+    if (!(removeempty && e.valuelist.length == 0 && fb.length == 0))
+	fb_add_to(&fb, &e.valuelist, &e.cclist);
 
     return e;
 
 failure:
-    sb_destroy(&ccbuf);
-    wb_destroy(&valuebuf);
-    plfree(pl_toary(&e.cclist), free);
-    plfree(pl_toary(&e.valuelist), free);
     e.valuelist.contents = e.cclist.contents = NULL;
+    e.valuelist.length = e.cclist.length = 0;
     return e;
 }
 
-/* Appends to `e->ccbuf' as many `c's as needed to match the length with
- * `e->valuebuf'. */
-void fill_ccbuf(const xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf,
-	charcategory_T c)
-{
-    sb_ccat_repeat(ccbuf, c, valuebuf->length - ccbuf->length);
-}
-
 /* Performs tilde expansion.
  * `ss' is a pointer to a pointer to the tilde character. The pointer is
  * increased so that it points to the character right after the expanded string.
@@ -649,8 +918,8 @@ finish:
 }
 
 /* Performs parameter expansion.
- * If successful, the return value contains valid lists of pointers to newly
- * malloced strings. Note that the lists may contain no strings.
+ * If successful, the return value contains valid lists of pointers to strings
+ * allocated in `expand_arena'. Note that the lists may contain no strings.
  * If unsuccessful, the lists have NULL `contents'. */
 struct expand_four_T expand_param(const paramexp_T *p, bool indq)
 {
@@ -662,17 +931,17 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     } else {
 	wchar_t *start = expand_single(p->pe_start, TT_NONE, Q_WORD, ES_NONE);
 	if (start == NULL)
-	    goto failure1;
+	    goto failure;
 	indextype = parse_indextype(start);
 	if (indextype != IDX_NONE) {
 	    startindex = 0, endindex = SSIZE_MAX;
 	    free(start);
 	    if (p->pe_end != NULL) {
 		xerror(0, Ngt("the parameter index is invalid"));
-		goto failure1;
+		goto failure;
 	    }
 	} else if (!evaluate_index(start, &startindex)) {
-	    goto failure1;
+	    goto failure;
 	} else {
 	    if (p->pe_end == NULL) {
 		endindex = (startindex == -1) ? SSIZE_MAX : startindex;
@@ -680,7 +949,7 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
 		wchar_t *end = expand_single(
 			p->pe_end, TT_NONE, Q_WORD, ES_NONE);
 		if (end == NULL || !evaluate_index(end, &endindex))
-		    goto failure1;
+		    goto failure;
 	    }
 	    if (startindex == 0)
 		startindex = SSIZE_MAX;
@@ -698,26 +967,14 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     if (p->pe_type & PT_NEST) {
 	plist_T plist = expand_word(p->pe_nest);
 	if (plist.contents == NULL)
-	    goto failure1;
+	    goto failure;
 	v.type = (plist.length == 1) ? GV_SCALAR : GV_ARRAY;
 	v.count = plist.length;
-	v.values = pl_toary(&plist);
-	v.freevalues = true;
+	v.values = plist.contents;
+	v.freevalues = false;
 	unset = false;
     } else {
-	v = get_variable(p->pe_name);
-	if (v.type == GV_NOTFOUND) {
-	    /* if the variable is not set, return empty string */
-	    v.type = GV_SCALAR;
-	    v.count = 1;
-	    v.values = xmallocn(2, sizeof *v.values);
-	    v.values[0] = xwcsdup(L"");
-	    v.values[1] = NULL;
-	    v.freevalues = true;
-	    unset = true;
-	} else {
-	    unset = false;
-	}
+	v = get_variable_in_arena(p->pe_name, &unset);
     }
 
     /* here, the contents of `v.values' are not escaped by backslashes. */
@@ -728,14 +985,10 @@ struct expand_four_T expand_param(const paramexp_T *p, bool indq)
     switch (v.type) {
 	case GV_SCALAR:
 	    assert(v.values != NULL && v.count == 1);
-	    save_get_variable_values(&v);
-	    if (indextype != IDX_NUMBER) {
+	    if (indextype != IDX_NUMBER)
 		trim_wstring(v.values[0], startindex, endindex);
-	    } else {
-		size_t len = wcslen(v.values[0]);
-		free(v.values[0]);
-		v.values[0] = malloc_wprintf(L"%zu", len);
-	    }
+	    else
+		v.values[0] = size_to_wcs_in_arena(wcslen(v.values[0]));
 	    values = v.values, concat = false;
 	    break;
 	case GV_ARRAY:
@@ -771,17 +1024,12 @@ treat_array:
 		    endindex = SIZE_MAX;
 #endif
 		assert(0 <= startindex && startindex <= endindex);
-		values = v.freevalues
-		    ? trim_array(v.values, startindex, endindex)
-		    : plndup(v.values + startindex,
-			    endindex - startindex, copyaswcs);
+		if ((size_t) endindex < v.count)
+		    v.values[endindex] = NULL;
+		values = &v.values[startindex];
 		break;
 	    case IDX_NUMBER:
-		if (v.freevalues)
-		    plfree(v.values, free);
-		values = xmallocn(2, sizeof *values);
-		values[0] = malloc_wprintf(L"%zu", v.count);
-		values[1] = NULL;
+		values = make_array_in_arena(size_to_wcs_in_arena(v.count));
 		concat = false;
 		break;
 	    default:
@@ -810,131 +1058,188 @@ treat_array:
     case PT_MINUS:
 	if (unset) {
 subst:
-	    plfree(values, free);
 	    return expand_four(p->pe_subst, TT_SINGLE, substq,
 		    CC_SOFT_EXPANSION | (indq * CC_QUOTED));
 	}
 	break;
     case PT_ASSIGN:
 	if (unset) {
-	    plfree(values, free);
 	    if (p->pe_type & PT_NEST) {
 		xerror(0,
 		    Ngt("a nested parameter expansion cannot be assigned"));
-		goto failure1;
+		goto failure;
 	    } else if (!is_name(p->pe_name)) {
 		xerror(0, Ngt("cannot assign to parameter `%ls' "
 			    "in parameter expansion"),
 			p->pe_name);
-		goto failure1;
+		goto failure;
 	    } else if ((v.type == GV_ARRAY_CONCAT)
 		    || (v.type == GV_ARRAY && startindex + 1 != endindex)) {
                 xerror(0, Ngt("the specified index does not support assignment "
 			    "in the parameter expansion of array `%ls'"),
 			p->pe_name);
-		goto failure1;
+		goto failure;
 	    }
 	    subst = expand_single(p->pe_subst, TT_SINGLE, substq, ES_NONE);
 	    if (subst == NULL)
-		goto failure1;
+		goto failure;
+	    values = make_array_in_arena(
+		    arena_wcsndup(&expand_arena, subst, SIZE_MAX));
 	    if (v.type != GV_ARRAY) {
 		assert(v.type == GV_NOTFOUND || v.type == GV_SCALAR);
-		if (!set_variable(
-			    p->pe_name, xwcsdup(subst), SCOPE_GLOBAL, false)) {
-		    free(subst);
-		    goto failure1;
-		}
+		if (!set_variable(p->pe_name, subst, SCOPE_GLOBAL, false))
+		    goto failure;
 	    } else {
 		assert(0 <= startindex && (size_t) startindex <= v.count);
-		if (!set_array_element(p->pe_name, startindex, xwcsdup(subst))){
-		    free(subst);
-		    goto failure1;
-		}
+		if (!set_array_element(p->pe_name, startindex, subst))
+		    goto failure;
 	    }
-	    values = xmallocn(2, sizeof *values);
-	    values[0] = subst;
-	    values[1] = NULL;
 	    unset = false;
 	}
 	break;
     case PT_ERROR:
 	if (unset) {
 	    print_subst_as_error(p, substq);
-	    goto failure2;
+	    goto failure;
 	}
 	break;
     }
 
     if (unset && !shopt_unset) {
 	xerror(0, Ngt("parameter `%ls' is not set"), p->pe_name);
-	goto failure2;
+	goto failure;
     }
 
     /* PT_MATCH, PT_SUBST */
     wchar_t *match;
     switch (p->pe_type & PT_MASK) {
     case PT_MATCH:
-	match = expand_single(p->pe_match, TT_SINGLE, Q_WORD, ES_QUOTED);
+	match = expand_single_in_arena(
+		p->pe_match, TT_SINGLE, Q_WORD, ES_QUOTED);
 	if (match == NULL)
-	    goto failure2;
+	    goto failure;
 	match_each(values, match, p->pe_type);
-	free(match);
 	break;
     case PT_SUBST:
-	match = expand_single(p->pe_match, TT_SINGLE, Q_WORD, ES_QUOTED);
+	match = expand_single_in_arena(
+		p->pe_match, TT_SINGLE, Q_WORD, ES_QUOTED);
 	if (match == NULL)
-	    goto failure2;
-	subst = expand_single(p->pe_subst, TT_SINGLE, Q_WORD, ES_NONE);
-	if (subst == NULL) {
-	    free(match);
-	    goto failure2;
-	}
+	    goto failure;
+	subst = expand_single_in_arena(
+		p->pe_subst, TT_SINGLE, Q_WORD, ES_NONE);
+	if (subst == NULL)
+	    goto failure;
 	subst_each(values, match, subst, p->pe_type);
-	free(match);
-	free(subst);
 	break;
     }
 
     /* concatenate the elements of `values' */
     if (concat && indq)
-	values = concatenate_values_into_array(values, false);
+	values = concatenate_values_into_array(values);
 
     /* PT_NUMBER */
     if (p->pe_type & PT_NUMBER)
 	subst_length_each(values);
 
+    /* create the charcategory_T strings */
     struct expand_four_T e;
+    size_t count = plcount(values);
+    e.valuelist = (plist_T) { values, count, count };
+    e.cclist.contents = arena_alloc(&expand_arena,
+	    mul(add(count, 1), sizeof *e.cclist.contents));
+    e.cclist.length = e.cclist.maxlength = count;
 
-    pl_initwith(&e.valuelist, values, plcount(values));
-    pl_initwithmax(&e.cclist, e.valuelist.length);
-
-    /* create `e.cclist' contents */
     charcategory_T cc = CC_SOFT_EXPANSION | (indq * CC_QUOTED);
-    for (size_t i = 0; i < e.valuelist.length; i++) {
-	xwcsbuf_T sbuf;
-	wb_initwith(&sbuf, e.valuelist.contents[i]);
-	size_t n = sbuf.length;
-	xstrbuf_T ccbuf;
-	sb_initwithmax(&ccbuf, n + 1);
-	sb_ccat_repeat(&ccbuf, cc, n);
-	if (indq && e.valuelist.length > 1) {
+    for (size_t i = 0; i < count; i++) {
+	wchar_t *value = values[i];
+	size_t n = wcslen(value);
+	if (indq && count > 1) {
 	    // keep the field from empty field removal by adding a dummy quote
-	    wb_wccat(&sbuf, L'"');
-	    sb_ccat(&ccbuf, cc | CC_QUOTATION);
+	    wchar_t *newvalue = arena_alloc(&expand_arena,
+		    mul(add(n, 2), sizeof *newvalue));
+	    wmemcpy(newvalue, value, n);
+	    newvalue[n] = L'"';
+	    newvalue[n + 1] = L'\0';
+	    values[i] = newvalue;
+
+	    char *ccs = arena_alloc(&expand_arena, add(n, 2));
+	    memset(ccs, cc, n);
+	    ccs[n] = cc | CC_QUOTATION;
+	    ccs[n + 1] = '\0';
+	    e.cclist.contents[i] = ccs;
+	} else {
+	    char *ccs = arena_alloc(&expand_arena, add(n, 1));
+	    memset(ccs, cc, n);
+	    ccs[n] = '\0';
+	    e.cclist.contents[i] = ccs;
 	}
-	e.valuelist.contents[i] = wb_towcs(&sbuf);
-	pl_add(&e.cclist, sb_tostr(&ccbuf));
     }
+    e.cclist.contents[count] = NULL;
 
     return e;
 
-failure2:
-    plfree(values, free);
-failure1:
+failure:
     e.valuelist.contents = e.cclist.contents = NULL;
+    e.valuelist.length = e.cclist.length = 0;
     return e;
 }
 
+/* Gets the value of the specified parameter like `get_variable', but the
+ * resulting strings and array are allocated in `expand_arena' so that they can
+ * be modified freely.
+ * If the parameter is not set, the result is a scalar empty string and
+ * `*unset' is set to true. Otherwise, `*unset' is set to false.
+ * The `freevalues' member of the result is always false. */
+struct get_variable_T get_variable_in_arena(const wchar_t *name, bool *unset)
+{
+    struct get_variable_T v;
+
+    /* shortcut for normal scalar variables */
+    const wchar_t *value = getvar(name);
+    if (value != NULL) {
+	v.type = GV_SCALAR;
+	v.count = 1;
+	v.values = make_array_in_arena(
+		arena_wcsndup(&expand_arena, value, SIZE_MAX));
+	v.freevalues = false;
+	*unset = false;
+	return v;
+    }
+
+    v = get_variable(name);
+    if (v.type == GV_NOTFOUND) {
+	/* if the variable is not set, return empty string */
+	v.type = GV_SCALAR;
+	v.count = 1;
+	v.values = make_array_in_arena(arena_wcsndup(&expand_arena, L"", 0));
+	v.freevalues = false;
+	*unset = true;
+	return v;
+    }
+
+    void **values = arena_alloc(&expand_arena,
+	    mul(add(v.count, 1), sizeof *values));
+    for (size_t i = 0; i < v.count; i++)
+	values[i] = arena_wcsndup(&expand_arena, v.values[i], SIZE_MAX);
+    values[v.count] = NULL;
+    if (v.freevalues)
+	plfree(v.values, free);
+    v.values = values;
+    v.freevalues = false;
+    *unset = false;
+    return v;
+}
+
+/* Returns a NULL-terminated array allocated in `expand_arena' that contains
+ * the only element `s'. */
+void **make_array_in_arena(wchar_t *s)
+{
+    void **array = arena_alloc(&expand_arena, 2 * sizeof *array);
+    array[0] = s;
+    array[1] = NULL;
+    return array;
+}
+
 /* Returns IDX_ALL, IDX_CONCAT, IDX_NUMBER if `indexstr' is L"@", L"*",
  * L"#" respectively. Otherwise returns IDX_NONE. */
 enum indextype_T parse_indextype(const wchar_t *indexstr)
@@ -987,36 +1292,6 @@ return_empty:
     return s;
 }
 
-/* Trims some leading and trailing elements of the NULL-terminated array of
- * pointers.
- * Elements in the range [`startindex', `endindex') remain. `startindex' must
- * not be negative and `endindex' must not be less than `startindex'.
- * Removed elements are freed.
- * Returns the array `a'. */
-/* `startindex' and/or `endindex' may be >= the length of the array. */
-void **trim_array(void **a, ssize_t startindex, ssize_t endindex)
-{
-    assert(0 <= startindex && startindex <= endindex);
-    if (startindex == 0 && endindex == SSIZE_MAX)
-	return a;
-
-    ssize_t len = endindex - startindex;
-    for (ssize_t i = 0; i < startindex; i++) {
-	if (a[i] == NULL) {
-	    a[0] = NULL;
-	    return a;
-	}
-	free(a[i]);
-    }
-    for (ssize_t i = 0; i < len; i++)
-	if ((a[i] = a[startindex + i]) == NULL)
-	    return a;
-    for (ssize_t i = endindex; a[i] != NULL; i++)
-	free(a[i]);
-    a[len] = NULL;
-    return a;
-}
-
 /* Expands `p->pe_subst' and prints it as an error message. */
 void print_subst_as_error(const paramexp_T *p, quoting_T quoting)
 {
@@ -1044,11 +1319,11 @@ void print_subst_as_error(const paramexp_T *p, quoting_T quoting)
 
 /* Matches each string in array `slist' to pattern `pattern' and removes the
  * matching part of the string.
- * `slist' is a NULL-terminated array of pointers to `free'able wide strings.
+ * `slist' is a NULL-terminated array of pointers to modifiable wide strings.
  * `type' must contain at least one of PT_MATCHHEAD, PT_MATCHTAIL and
  * PT_MATCHLONGEST. If both of PT_MATCHHEAD and PT_MATCHTAIL are specified,
  * PT_MATCHLONGEST must be specified too.
- * Elements of `slist' may be modified and/or `realloc'ed in this function. */
+ * Elements of `slist' are modified in place in this function. */
 void match_each(void **restrict slist, const wchar_t *restrict pattern,
 	paramexptype_T type)
 {
@@ -1069,10 +1344,8 @@ void match_each(void **restrict slist, const wchar_t *restrict pattern,
 	wchar_t *s = slist[i];
 	xfnmresult_T result = xfnm_wmatch(xfnm, s);
 	if (result.start != (size_t) -1) {
-	    xwcsbuf_T buf;
-	    wb_initwith(&buf, s);
-	    wb_remove(&buf, result.start, result.end - result.start);
-	    slist[i] = wb_towcs(&buf);
+	    size_t rest = wcslen(&s[result.end]);
+	    wmemmove(&s[result.start], &s[result.end], rest + 1);
 	}
     }
     xfnm_free(xfnm);
@@ -1080,10 +1353,11 @@ void match_each(void **restrict slist, const wchar_t *restrict pattern,
 
 /* Matches each string in array `slist' to pattern `pattern' and substitutes
  * the matching portions with `subst'.
- * `slist' is a NULL-terminated array of pointers to `free'able wide strings.
+ * `slist' is a NULL-terminated array of pointers to wide strings.
  * `type' may contain PT_MATCHHEAD, PT_MATCHTAIL and PT_SUBSTALL.
  * PT_MATCHLONGEST is always assumed to be specified.
- * Elements of `slist' may be modified and/or `realloc'ed in this function. */
+ * Elements of `slist' are replaced with new strings allocated in
+ * `expand_arena'. */
 void subst_each(void **restrict slist, const wchar_t *pattern,
 	const wchar_t *subst, paramexptype_T type)
 {
@@ -1098,8 +1372,8 @@ void subst_each(void **restrict slist, const wchar_t *pattern,
 	return;
 
     for (size_t i = 0; slist[i] != NULL; i++) {
-	wchar_t *s = slist[i];
-	slist[i] = xfnm_subst(xfnm, s, subst, type & PT_SUBSTALL);
+	wchar_t *s = xfnm_subst(xfnm, slist[i], subst, type & PT_SUBSTALL);
+	slist[i] = arena_wcsndup(&expand_arena, s, SIZE_MAX);
 	free(s);
     }
     xfnm_free(xfnm);
@@ -1108,106 +1382,105 @@ void subst_each(void **restrict slist, const wchar_t *pattern,
 /* Concatenates the wide strings in the specified array.
  * Array `*values' must be a NULL-terminated array of pointers to wide strings.
  * The strings are concatenated into one, each separated by the first $IFS
- * character. The separators are backslashed if `escape' is true.
- * The array and its element strings are all freed in this function.
- * The return value is a pointer to the newly malloced wide string that is the
- * result of concatenation. */
-wchar_t *concatenate_values(void **values, bool escape)
-{
-    wchar_t *first = values[0];
-    if (first != NULL && values[1] == NULL) {
-	// no actual concatenation needed
-	free(values);
-	return first;
-    }
-
-    const wchar_t *ifs = getvar(L VAR_IFS);
-    wchar_t padding[] = { L'\\', ifs != NULL ? ifs[0] : L' ', L'\0' };
-    wchar_t *result = joinwcsarray(values, escape ? padding : &padding[1]);
-    plfree(values, free);
-    return result;
-}
-
-/* Like `concatenate_values', but returns a pointer to a newly malloced
- * NULL-terminated array containing the concatenated string. */
-void **concatenate_values_into_array(void **values, bool escape)
+ * character.
+ * The return value is a pointer to a NULL-terminated array that contains the
+ * concatenated string. The array and the string are allocated in
+ * `expand_arena'. */
+void **concatenate_values_into_array(void **values)
 {
     if (values[0] != NULL && values[1] == NULL)
 	return values;
 
-    void **results = xmallocn(2, sizeof *values);
-    results[0] = concatenate_values(values, escape);
-    results[1] = NULL;
-    return results;
+    const wchar_t *ifs = getvar(L VAR_IFS);
+    wchar_t separator = ifs != NULL ? ifs[0] : L' ';
+
+    size_t length = 0;
+    for (size_t i = 0; values[i] != NULL; i++) {
+	if (i > 0 && separator != L'\0')
+	    length = add(length, 1);
+	length = add(length, wcslen(values[i]));
+    }
+
+    wchar_t *result = arena_alloc(&expand_arena,
+	    mul(add(length, 1), sizeof *result));
+    wchar_t *p = result;
+    for (size_t i = 0; values[i] != NULL; i++) {
+	if (i > 0 && separator != L'\0')
+	    *p++ = separator;
+	size_t n = wcslen(values[i]);
+	wmemcpy(p, values[i], n);
+	p += n;
+    }
+    *p = L'\0';
+    return make_array_in_arena(result);
 }
 
 /* Substitutes each string in the specified array with a string that contains
  * the number of characters in the original string.
- * `slist' is a NULL-terminated array of pointers to `free'able wide strings.
- * The strings are `realloc'ed and modified in this function. */
+ * `slist' is a NULL-terminated array of pointers to wide strings. The new
+ * strings are allocated in `expand_arena'. */
 void subst_length_each(void **slist)
 {
-    for (size_t i = 0; slist[i] != NULL; i++) {
-	size_t len = wcslen(slist[i]);
-	free(slist[i]);
-	slist[i] = malloc_wprintf(L"%zu", len);
-    }
+    for (size_t i = 0; slist[i] != NULL; i++)
+	slist[i] = size_to_wcs_in_arena(wcslen(slist[i]));
 }
 
 /* Merge a result of `expand_param' into another expand_four_T value.
- * All the values in `from->valuelist' and `from->cclist' except the last one
- * are moved into `to->valuelist' and `to->cclist', respectively, and the last
- * one is left in `valuebuf' and `ccbuf'.
- * `from->valuelist' and `from->cclist' are destroyed in this function. */
+ * The first value in `from' is appended to the field being built in `fb'.
+ * If `from' has more than one value, the field in `fb' is added to `to', the
+ * values in `from' except the first and last ones are added to `to', and the
+ * last one is left in `fb'.
+ * The strings in `from' are not copied unless they need to be appended to a
+ * non-empty field. */
 void merge_expand_four(
 	struct expand_four_T *restrict from,
 	struct expand_four_T *restrict to,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
 {
     assert(from->valuelist.length == from->cclist.length);
     assert(to->valuelist.length == to->cclist.length);
-    assert(valuebuf->length == ccbuf->length);
-
-    if (from->valuelist.length > 0) {
-	/* add the first element */
-	wb_catfree(valuebuf, from->valuelist.contents[0]);
-	sb_ncat_force(ccbuf, from->cclist.contents[0],
-		valuebuf->length - ccbuf->length);
-	free(from->cclist.contents[0]);
-
-	if (from->valuelist.length > 1) {
-	    pl_add(&to->valuelist, wb_towcs(valuebuf));
-	    pl_add(&to->cclist, sb_tostr(ccbuf));
-
-	    /* add the other elements but last */
-	    pl_ncat(&to->valuelist,
-		    &from->valuelist.contents[1], from->valuelist.length - 2);
-	    pl_ncat(&to->cclist,
-		    &from->cclist.contents[1], from->cclist.length - 2);
-
-	    /* add the last element */
-	    size_t i = from->valuelist.length - 1;
-	    wb_initwith(valuebuf, from->valuelist.contents[i]);
-	    sb_initwithmax(ccbuf, valuebuf->length);
-	    sb_ncat_force(ccbuf, from->cclist.contents[i], valuebuf->length);
-	    free(from->cclist.contents[i]);
-	}
+
+    size_t n = from->valuelist.length;
+    if (n == 0)
+	return;
+
+    /* add the first element */
+    wchar_t *value = from->valuelist.contents[0];
+    char *cc = from->cclist.contents[0];
+    if (fb->length == 0) {
+	fb->value = value;
+	fb->cc = cc;
+	fb->length = fb->maxlength = wcslen(value);
+    } else {
+	fb_nccat(fb, value, cc, wcslen(value));
     }
 
-    pl_destroy(&from->valuelist);
-    pl_destroy(&from->cclist);
+    if (n > 1) {
+	fb_add_to(fb, &to->valuelist, &to->cclist);
+
+	/* add the other elements but last */
+	for (size_t i = 1; i < n - 1; i++) {
+	    fl_add(&to->valuelist, from->valuelist.contents[i]);
+	    fl_add(&to->cclist, from->cclist.contents[i]);
+	}
+
+	/* add the last element */
+	fb->value = from->valuelist.contents[n - 1];
+	fb->cc = from->cclist.contents[n - 1];
+	fb->length = fb->maxlength = wcslen(fb->value);
+    }
 }
 
 
 /********** Brace Expansions **********/
 
 /* Performs brace expansion in each element of the specified array.
- * `values' is an array of pointers to `free'able wide strings to be expanded.
- * `ccs' is an array of pointers to `free'able charcategory_T strings.
+ * `values' is an array of pointers to wide strings to be expanded.
+ * `ccs' is an array of pointers to corresponding charcategory_T strings.
  * `values' and `ccs' must contain the same number of elements and be NULL-
- * terminated. Their elements are freed in this function. The arrays themselves
- * are not freed.
- * Newly malloced results are added to `valuelist' and `cclist'. */
+ * terminated.
+ * The results are added to `valuelist' and `cclist', which must have been
+ * initialized by `fl_init'. The results are allocated in `expand_arena'. */
 void expand_brace_each(
 	void *const *restrict values, void *const *restrict ccs,
 	plist_T *restrict valuelist, plist_T *restrict cclist)
@@ -1220,8 +1493,8 @@ void expand_brace_each(
 
 /* Performs brace expansion in the specified single word.
  * `cc' is the charcategory_T string corresponding to `word'.
- * `word' and `cc' are freed in this function.
- * `Free'able results are added to `valuelist' and `cclist'. */
+ * The results are added to `valuelist' and `cclist'. If no expansion happens,
+ * `word' and `cc' themselves are added. */
 void expand_brace(
 	wchar_t *restrict const word, char *restrict const cc,
 	plist_T *restrict valuelist, plist_T *restrict cclist)
@@ -1232,8 +1505,8 @@ void expand_brace(
     const wchar_t *c;
     if ((c = wcschr(word, L'{')) == NULL || (c = wcschr(c + 1, L'}')) == NULL) {
 no_expansion:
-	pl_add(valuelist, word);
-	pl_add(cclist, cc);
+	fl_add(valuelist, word);
+	fl_add(cclist, cc);
 	return;
     }
 
@@ -1254,14 +1527,17 @@ no_expansion:
     bool pairfound = false;
     plist_T graph;
     plist_T stack;
-    pl_initwithmax(&graph, idx(c) + wcslen(c) /* = wcslen(word) */);
-    pl_init(&stack);
+    graph.length = 0;
+    graph.maxlength = idx(c) + wcslen(c) /* = wcslen(word) */;
+    graph.contents = arena_alloc(&expand_arena,
+	    mul(add(graph.maxlength, 1), sizeof *graph.contents));
+    fl_init(&stack);
     while (word[graph.length] != L'\0') {
 	if (cc[graph.length] == CC_LITERAL) {
 	    switch (word[graph.length]) {
 		case L'{':
-		    pl_add(&stack, &word[graph.length]);
-		    pl_add(&stack, &word[graph.length]);
+		    fl_add(&stack, &word[graph.length]);
+		    fl_add(&stack, &word[graph.length]);
 		    break;
 		case L',':
 		    if (stack.length > 0) {
@@ -1277,25 +1553,22 @@ no_expansion:
 			assert(ci < graph.length);
 			graph.contents[ci] = &word[graph.length];
 			assert(stack.length % 2 == 0);
-			pl_truncate(&stack, stack.length - 2);
+			stack.length -= 2;
 			pairfound = true;
 			if (word[ci] == L',') {
-			    pl_add(&graph, &word[graph.length]);
+			    fl_add(&graph, &word[graph.length]);
 			    continue;
 			}
 		    }
 		    break;
 	    }
 	}
-	pl_add(&graph, NULL);
+	fl_add(&graph, NULL);
     }
 
     /* If no pairs of braces were found, we don't need to expand anything. */
-    if (!pairfound) {
-	pl_destroy(&stack);
-	pl_destroy(&graph);
+    if (!pairfound)
 	goto no_expansion;
-    }
 
     /* After scanning the whole `word', if we have any elements left in the
      * stack, they are L'{'s that have no matching L'}'s. They cannot be
@@ -1308,9 +1581,8 @@ no_expansion:
 	    graph.contents[ci] = NULL;
 	    ci = idx(cnext);
 	}
-	pl_truncate(&stack, stack.length - 2);
+	stack.length -= 2;
     }
-    pl_destroy(&stack);
 
     /* Now start expansion! */
     struct brace_expand_T e = {
@@ -1320,41 +1592,33 @@ no_expansion:
 	.valuelist = valuelist,
 	.cclist = cclist,
     };
-    xwcsbuf_T valuebuf;
-    xstrbuf_T ccbuf;
-    wb_init(&valuebuf);
-    sb_init(&ccbuf);
-    generate_brace_expand_results(&e, 0, &valuebuf, &ccbuf);
-    pl_destroy(&graph);
-    free(word);
-    free(cc);
+    struct fieldbuf_T fb;
+    fb_init(&fb);
+    generate_brace_expand_results(&e, 0, &fb);
 #undef idx
 }
 
 /* Generates results of brace expansion.
  * Part of `e->word' that has been processed before calling this function
- * may have been added to `valuebuf' and `ccbuf'.
- * This function modifies `valuebuf' and `ccbuf' in place to construct the
- * results, and finally destroys them.
+ * may have been added to `fb'.
+ * This function modifies `fb' in place to construct the results.
  * The results are added to `e->valuelist' and `e->cclist'. */
 void generate_brace_expand_results(
 	const struct brace_expand_T *restrict e, size_t ci,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
 {
 start:
     /* add normal characters up to the next delimiter */
     while (e->word[ci] != L'\0' && e->graph[ci] == NULL) {
 normal:
-	wb_wccat(valuebuf, e->word[ci]);
-	sb_ccat(ccbuf, e->cc[ci]);
+	fb_wccat(fb, e->word[ci], e->cc[ci]);
 	ci++;
     }
 
     switch (e->word[ci]) {
 	case L'\0':
 	    /* No more characters: we're done! */
-	    pl_add(e->valuelist, wb_towcs(valuebuf));
-	    pl_add(e->cclist, sb_tostr(ccbuf));
+	    fb_add_to(fb, e->valuelist, e->cclist);
 	    return;
 	case L',':
 	    /* skip up to next L'}' and go on */
@@ -1374,7 +1638,7 @@ normal:
     const wchar_t *nextdelimiter = e->graph[ci];
     if (*nextdelimiter == L'}') {
 	/* No commas between the braces: try numeric brace expansion */
-	if (try_expand_brace_sequence(e, ci, valuebuf, ccbuf))
+	if (try_expand_brace_sequence(e, ci, fb))
 	    return;
 
 	/* No numeric brace expansion happened.
@@ -1385,14 +1649,12 @@ normal:
 
     /* Now generate the results (except the last one) */
     while (*nextdelimiter == L',') {
-	xwcsbuf_T valuebuf2;
-	xstrbuf_T ccbuf2;
-	wb_initwithmax(&valuebuf2, valuebuf->maxlength);
-	wb_ncat_force(&valuebuf2, valuebuf->contents, valuebuf->length);
-	sb_initwithmax(&ccbuf2, ccbuf->maxlength);
-	sb_ncat_force(&ccbuf2, ccbuf->contents, ccbuf->length);
+	struct fieldbuf_T fb2;
+	fb_init(&fb2);
+	if (fb->length > 0)
+	    fb_nccat(&fb2, fb->value, fb->cc, fb->length);
 	ci++;
-	generate_brace_expand_results(e, ci, &valuebuf2, &ccbuf2);
+	generate_brace_expand_results(e, ci, &fb2);
 	ci = nextdelimiter - e->word;
 	nextdelimiter = e->graph[ci];
     }
@@ -1400,18 +1662,17 @@ normal:
 
     /* Generate the last one */
     ci++;
-    goto start; // generate_brace_expand_results(e, ci, valuebuf, ccbuf);
+    goto start; // generate_brace_expand_results(e, ci, fb);
 }
 
 /* Tries numeric brace expansion like "{01..05}".
  * `ci' must be the index of the L'{' character in `e->word'.
  * If unsuccessful, this function returns false without any side effects.
  * If successful, the results are added to `e->valuelist' and `e->cclist'.
- * In that case, this function modifies `valuebuf' and `ccbuf' in place to
- * construct the results, and finally destroys them. */
+ * `fb' is the field built so far and is not modified. */
 bool try_expand_brace_sequence(
 	const struct brace_expand_T *restrict e, size_t ci,
-	xwcsbuf_T *restrict valuebuf, xstrbuf_T *restrict ccbuf)
+	struct fieldbuf_T *restrict fb)
 {
     assert(e->word[ci] == L'{');
     ci++;
@@ -1470,21 +1731,25 @@ bool try_expand_brace_sequence(
     int len = (startlen > endlen) ? startlen : endlen;
     ci = cp - e->word + 1;
     do {
-	xwcsbuf_T valuebuf2;
-	xstrbuf_T ccbuf2;
-	wb_initwithmax(&valuebuf2, valuebuf->maxlength);
-	wb_ncat_force(&valuebuf2, valuebuf->contents, valuebuf->length);
-	sb_initwithmax(&ccbuf2, ccbuf->maxlength);
-	sb_ncat_force(&ccbuf2, ccbuf->contents, ccbuf->length);
+	struct fieldbuf_T fb2;
+	fb_init(&fb2);
+	if (fb->length > 0)
+	    fb_nccat(&fb2, fb->value, fb->cc, fb->length);
 
 	/* format the number */
-	int plen =
-	    wb_wprintf(&valuebuf2, sign ? L"%0+*ld" : L"%0*ld", len, value);
-	if (plen >= 0)
-	    sb_ccat_repeat(&ccbuf2, CC_HARD_EXPANSION, plen);
+	size_t max = add(len, 3 * sizeof value + 2);
+	fb_ensure(&fb2, max);
+	int plen = swprintf(&fb2.value[fb2.length], max + 1,
+		sign ? L"%0+*ld" : L"%0*ld", len, value);
+	if (plen >= 0) {
+	    memset(&fb2.cc[fb2.length], CC_HARD_EXPANSION, plen);
+	    fb2.length += plen;
+	}
+	fb2.value[fb2.length] = L'\0';
+	fb2.cc[fb2.length] = '\0';
 
 	/* expand the remaining portion recursively */
-	generate_brace_expand_results(e, ci, &valuebuf2, &ccbuf2);
+	generate_brace_expand_results(e, ci, &fb2);
 
 	if (delta >= 0) {
 	    if (LONG_MAX - delta < value)
@@ -1496,8 +1761,6 @@ bool try_expand_brace_sequence(
 	value += delta;
     } while (delta >= 0 ? value <= end : value >= end);
 
-    wb_destroy(valuebuf);
-    sb_destroy(ccbuf);
     return true;
 }
 
@@ -1524,8 +1787,9 @@ bool has_leading_zero(const wchar_t *restrict s, bool *restrict sign)
 /* Performs field splitting.
  * `valuelist' is a NULL-terminated array of pointers to wide strings to split.
  * `cclist' is an array of pointers to corresponding charcategory_T strings.
- * `valuelist' and `cclist' are `plfree'ed in this function.
- * The results are added to `outvaluelist' and `outcclist'. */
+ * The results are added to `outvaluelist' and `outcclist', which must have
+ * been initialized by `fl_init'. The results are allocated in `expand_arena'.
+ * A field that is not split is added as is. */
 void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
 	plist_T *restrict outvaluelist, plist_T *restrict outcclist)
 {
@@ -1533,38 +1797,43 @@ void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
     if (ifs == NULL)
 	ifs = DEFAULT_IFS;
 
-    plist_T fields;
-    pl_init(&fields);
+    /* The list of field boundaries is reused across calls. */
+    static plist_T fields = { .contents = NULL };
+    if (fields.contents == NULL)
+	pl_init(&fields);
 
     for (size_t i = 0; valuelist[i] != NULL; i++) {
 	wchar_t *s = valuelist[i];
 	char *cc = cclist[i];
-	extract_fields(s, cc, ifs, &fields);
-	assert(fields.length % 2 == 0);
 
-	if (fields.length == 2 && fields.contents[0] == s &&
-		*(wchar_t *) fields.contents[1] == L'\0') {
+	/* A non-empty field that contains no unquoted expansion results is
+	 * never split. */
+	bool unsplit = s[0] != L'\0' &&
+	    !(ccset_of(cc, wcslen(s)) & CCSET(CC_SOFT_EXPANSION));
+	if (!unsplit) {
+	    extract_fields(s, cc, ifs, &fields);
+	    assert(fields.length % 2 == 0);
+	    unsplit = fields.length == 2 && fields.contents[0] == s &&
+		*(wchar_t *) fields.contents[1] == L'\0';
+	}
+
+	if (unsplit) {
 	    /* The result is the same as the original field. */
-	    pl_add(outvaluelist, s);
-	    pl_add(outcclist, cc);
+	    fl_add(outvaluelist, s);
+	    fl_add(outcclist, cc);
 	} else {
 	    /* Produce new fields. */
 	    for (size_t j = 0; j < fields.length; j += 2) {
 		const wchar_t *start = fields.contents[j];
 		const wchar_t *end = fields.contents[j + 1];
 		size_t idx = start - s, len = end - start;
-		pl_add(outvaluelist, xwcsndup(start, len));
-		pl_add(outcclist, memcpy(xmalloc(len), &cc[idx], len));
+		fl_add(outvaluelist, arena_wcsndup(&expand_arena, start, len));
+		fl_add(outcclist, arena_memdup(&expand_arena, &cc[idx], len));
 	    }
-	    free(s);
-	    free(cc);
 	}
 
 	pl_truncate(&fields, 0);
     }
-    pl_destroy(&fields);
-    free(valuelist);
-    free(cclist);
 }
 
 /* Extracts fields from a string.
@@ -1602,6 +1871,8 @@ void fieldsplit(void **restrict const valuelist, void **restrict const cclist,
 wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
 	const wchar_t *restrict ifs, plist_T *restrict dest)
 {
+    const struct ifsinfo_T *info = compile_ifs(ifs);
+    size_t length = wcslen(s);
     size_t index = 0;
     size_t ifswhitestartindex;
     size_t oldlen = dest->length;
@@ -1612,13 +1883,12 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
 
     for (;;) {
 	ifswhitestartindex = index;
-	while (is_ifs_whitespace(s[index], cc[index], ifs))
+	while (is_ifs_whitespace(s[index], cc[index], info))
 	    index++;
 
 	/* extract next field, if any */
 	size_t fieldstartindex = index;
-	while (is_non_ifs_char(s[index], cc[index], ifs))
-	    index++;
+	index = skip_non_ifs_chars(s, cc, index, length, info);
 	if (index != fieldstartindex) {
 	    pl_add(pl_add(dest, &s[fieldstartindex]), &s[index]);
 	    afterfield = true;
@@ -1634,8 +1904,8 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
 	    break;
 
 	/* skip (only) one IFS non-whitespace */
-	assert(is_ifs_char(s[index], cc[index], ifs));
-	assert(!is_ifs_whitespace(s[index], cc[index], ifs));
+	assert(is_ifs_char(s[index], cc[index], info));
+	assert(!is_ifs_whitespace(s[index], cc[index], info));
 	index++;
 	afterfield = false;
     }
@@ -1651,22 +1921,139 @@ wchar_t *extract_fields(const wchar_t *restrict s, const char *restrict cc,
     return (wchar_t *) &s[ifswhitestartindex];
 }
 
-/* Returns true if `c' is a non-null, IFS character. */
-bool is_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+/* Returns the compiled form of IFS value `ifs'.
+ * The result is cached and reused until another value is compiled. */
+const struct ifsinfo_T *compile_ifs(const wchar_t *ifs)
 {
-    return cc == CC_SOFT_EXPANSION && c != L'\0' && wcschr(ifs, c) != NULL;
+    static struct ifsinfo_T info = { .value = NULL, .others = NULL, };
+
+    if (info.value != NULL && wcscmp(info.value, ifs) == 0)
+	return &info;
+
+    free(info.value);
+    free(info.others);
+    info.value = xwcsdup(ifs);
+    memset(info.chars, 0, sizeof info.chars);
+    memset(info.whitespaces, 0, sizeof info.whitespaces);
+    info.simdcount = 0;
+
+    xwcsbuf_T others;
+    wb_init(&others);
+    for (size_t i = 0; ifs[i] != L'\0'; i++) {
+	wchar_t c = ifs[i];
+	if (wmemchr(ifs, c, i) != NULL)
+	    continue;  /* duplicate */
+	if ((unsigned long) c < 0x80) {
+	    info.chars[c >> 5] |= UINT32_C(1) << (c & 31);
+	    if (iswspace(c))
+		info.whitespaces[c >> 5] |= UINT32_C(1) << (c & 31);
+	} else {
+	    wb_wccat(&others, c);
+	}
+	if (info.simdcount < IFS_SIMD_MAX)
+	    info.simdchars[info.simdcount] = c;
+	info.simdcount++;
+    }
+    info.others = wb_towcs(&others);
+    info.simd = (info.simdcount <= IFS_SIMD_MAX);
+    return &info;
 }
 
-/* Returns true if `c' is a non-null, IFS-whitespace character. */
-bool is_ifs_whitespace(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+/* Returns the index of the first IFS character in `s' that is not before
+ * `index'. `length' must be the length of `s', which is returned if `s' does
+ * not contain such an IFS character. */
+size_t skip_non_ifs_chars(const wchar_t *restrict s, const char *restrict cc,
+	size_t index, size_t length, const struct ifsinfo_T *restrict ifs)
+{
+    while (index < length) {
+#if HAVE_X86_SIMD
+	if (ifs->simd) {
+	    if (__builtin_cpu_supports("avx2"))
+		index = find_ifs_candidate_avx2(s, index, length, ifs);
+	    else
+		index = find_ifs_candidate_sse2(s, index, length, ifs);
+	    if (index >= length)
+		break;
+	}
+#endif
+	if (is_ifs_char(s[index], cc[index], ifs))
+	    break;
+	index++;
+    }
+    return index;
+}
+
+#if HAVE_X86_SIMD
+
+/* Skips characters that are not in `ifs->simdchars', four characters at a
+ * time. Returns the index of the first character in `ifs->simdchars', or the
+ * index of the last less-than-four characters if none found. */
+size_t find_ifs_candidate_sse2(const wchar_t *restrict s,
+	size_t index, size_t length, const struct ifsinfo_T *restrict ifs)
+{
+    __m128i chars[IFS_SIMD_MAX];
+    for (size_t i = 0; i < ifs->simdcount; i++)
+	chars[i] = _mm_set1_epi32(ifs->simdchars[i]);
+
+    while (length - index >= 4) {
+	__m128i v = _mm_loadu_si128((const __m128i *) &s[index]);
+	__m128i match = _mm_setzero_si128();
+	for (size_t i = 0; i < ifs->simdcount; i++)
+	    match = _mm_or_si128(match, _mm_cmpeq_epi32(v, chars[i]));
+	int mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+	if (mask != 0)
+	    return index + __builtin_ctz(mask);
+	index += 4;
+    }
+    return index;
+}
+
+/* Like `find_ifs_candidate_sse2', but eight characters at a time. */
+size_t find_ifs_candidate_avx2(const wchar_t *restrict s,
+	size_t index, size_t length, const struct ifsinfo_T *restrict ifs)
+{
+    __m256i chars[IFS_SIMD_MAX];
+    for (size_t i = 0; i < ifs->simdcount; i++)
+	chars[i] = _mm256_set1_epi32(ifs->simdchars[i]);
+
+    while (length - index >= 8) {
+	__m256i v = _mm256_loadu_si256((const __m256i *) &s[index]);
+	__m256i match = _mm256_setzero_si256();
+	for (size_t i = 0; i < ifs->simdcount; i++)
+	    match = _mm256_or_si256(match, _mm256_cmpeq_epi32(v, chars[i]));
+	int mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+	if (mask != 0)
+	    return index + __builtin_ctz(mask);
+	index += 8;
+    }
+    return find_ifs_candidate_sse2(s, index, length, ifs);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+/* Returns true if `c' is a non-null character in `ifs'. */
+bool ifs_contains(const struct ifsinfo_T *ifs, wchar_t c)
 {
-    return is_ifs_char(c, cc, ifs) && iswspace(c);
+    if ((unsigned long) c < 0x80)
+	return ifs->chars[c >> 5] & (UINT32_C(1) << (c & 31));
+    return wcschr(ifs->others, c) != NULL;
 }
 
-/* Returns true if `c' is a non-null, non-IFS character. */
-bool is_non_ifs_char(wchar_t c, charcategory_T cc, const wchar_t *ifs)
+/* Returns true if `c' is a non-null, IFS character. */
+bool is_ifs_char(wchar_t c, charcategory_T cc, const struct ifsinfo_T *ifs)
 {
-    return c != L'\0' && !is_ifs_char(c, cc, ifs);
+    return cc == CC_SOFT_EXPANSION && ifs_contains(ifs, c);
+}
+
+/* Returns true if `c' is a non-null, IFS-whitespace character. */
+bool is_ifs_whitespace(
+	wchar_t c, charcategory_T cc, const struct ifsinfo_T *ifs)
+{
+    if (cc != CC_SOFT_EXPANSION)
+	return false;
+    if ((unsigned long) c < 0x80)
+	return ifs->whitespaces[c >> 5] & (UINT32_C(1) << (c & 31));
+    return wcschr(ifs->others, c) != NULL && iswspace(c);
 }
 
 void add_empty_field(plist_T *dest, const wchar_t *p)
@@ -1874,31 +2261,100 @@ bool should_escape(charcategory_T cc, escaping_T escaping)
     assert(false);
 }
 
+/* Returns the set of the values in the first `length' bytes of
+ * charcategory_T string `cc'. */
+ccset_T ccset_of(const char *cc, size_t length)
+{
+    if (length == 0)
+	return 0;
+
+    ccset_T set = CCSET(cc[0]) | CCSET(cc[length - 1]);
+    if (length <= 2)
+	return set;
+
+    /* Most words are entirely literal, entirely unquoted, or entirely quoted
+     * except for the quotation marks at both ends, so we first check if the
+     * characters in between are all in the same category. */
+    if (memcmp(&cc[1], &cc[2], length - 3) == 0)
+	return set | CCSET(cc[1]);
+
+    for (size_t i = 1; i < length - 1; i++)
+	set |= CCSET(cc[i]);
+    return set;
+}
+
+/* Returns the set of charcategory_T values of characters that are removed or
+ * escaped in quote removal. */
+ccset_T ccset_to_process(escaping_T escaping)
+{
+    ccset_T set = 0;
+    for (int cc = 0; cc <= (CC_ORIGIN_MASK | CC_QUOTED | CC_QUOTATION); cc++)
+	if ((cc & CC_QUOTATION) || should_escape(cc, escaping))
+	    set |= CCSET(cc);
+    return set;
+}
+
+/* Skips the quotation marks at the start and end of the input string of quote
+ * removal. `*s' and `*cc' are advanced past the leading quotation marks and the
+ * length of the rest without the trailing quotation marks is returned. */
+size_t trim_quotation_marks(
+	const wchar_t *restrict *s, const char *restrict *cc)
+{
+    size_t length = wcslen(*s);
+    while (length > 0 && ((*cc)[0] & CC_QUOTATION))
+	(*s)++, (*cc)++, length--;
+    while (length > 0 && ((*cc)[length - 1] & CC_QUOTATION))
+	length--;
+    return length;
+}
+
 /* Removes all quotation marks in the input string `s' and optionally add
  * backslash escapes to the originally quoted characters as specified by
  * `escaping'. The result is a newly malloced string. */
 wchar_t *quote_removal(
 	const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
 {
+    size_t length = trim_quotation_marks(&s, &cc);
+    if (!(ccset_of(cc, length) & ccset_to_process(escaping)))
+	return xwcsndup(s, length);
+
     xwcsbuf_T result;
-    wb_initwithmax(&result, mul(wcslen(s), 2));
-    for (size_t i = 0; s[i] != L'\0'; i++) {
+    wb_initwithmax(&result, mul(length, 2));
+    result.length = quote_removal_into(
+	    result.contents, s, cc, length, escaping);
+    return wb_towcs(&result);
+}
+
+/* Writes the result of quote removal of the first `length' characters of `s'
+ * into `dest', which must have room for `length * 2 + 1' characters.
+ * Returns the length of the result. */
+size_t quote_removal_into(wchar_t *restrict dest,
+	const wchar_t *restrict s, const char *restrict cc, size_t length,
+	escaping_T escaping)
+{
+    size_t resultlength = 0;
+    for (size_t i = 0; i < length; i++) {
 	if (cc[i] & CC_QUOTATION)
 	    continue;
 	if (should_escape(cc[i], escaping))
-	    wb_wccat(&result, L'\\');
-	wb_wccat(&result, s[i]);
+	    dest[resultlength++] = L'\\';
+	dest[resultlength++] = s[i];
     }
-    return wb_towcs(&result);
+    dest[resultlength] = L'\0';
+    return resultlength;
 }
 
-/* Like `quote_removal', but frees the arguments. */
-wchar_t *quote_removal_free(
-	wchar_t *restrict s, char *restrict cc, escaping_T escaping)
+/* Like `quote_removal', but the result is allocated in `expand_arena'. */
+wchar_t *quote_removal_in_arena(
+	const wchar_t *restrict s, const char *restrict cc, escaping_T escaping)
 {
-    wchar_t *result = quote_removal(s, cc, escaping);
-    free(s);
-    free(cc);
+    size_t length = trim_quotation_marks(&s, &cc);
+    if (!(ccset_of(cc, length) & ccset_to_process(escaping)))
+	return arena_wcsndup(&expand_arena, s, length);
+
+    size_t max = add(mul(length, 2), 1);
+    wchar_t *result = arena_alloc(&expand_arena, mul(max, sizeof *result));
+    quote_removal_into(result, s, cc, length, escaping);
     return result;
 }
 
@@ -1919,7 +2375,7 @@ enum wglobflags_T get_wglobflags(void)
 /* Performs pathname expansion.
  * If `shopt_glob' is off or a field is not a pattern, quote removal is
  * performed instead.
- * The input lists and their contents in `e' are freed in this function.
+ * The input lists in `e' are allocated in `expand_arena'.
  * The results are added to `results' as newly-malloced wide strings. */
 void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
 {
@@ -1929,7 +2385,7 @@ void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
     for (size_t i = 0; i < e->valuelist.length; i++) {
 	wchar_t *field = e->valuelist.contents[i];
 	char *cc = e->cclist.contents[i];
-	wchar_t *pattern = quote_removal(field, cc, ES_QUOTED_HARD);
+	wchar_t *pattern = quote_removal_in_arena(field, cc, ES_QUOTED_HARD);
 	if (shopt_glob && is_pathname_matching_pattern(pattern)) {
 	    if (!unblock) {
 		set_interruptible_by_sigint(true);
@@ -1946,14 +2402,9 @@ void glob_all(struct expand_four_T *restrict e, plist_T *restrict results)
 quote_removal:
 	    pl_add(results, quote_removal(field, cc, ES_NONE));
 	}
-	free(field);
-	free(cc);
-	free(pattern);
     }
     if (unblock)
 	set_interruptible_by_sigint(false);
-    pl_destroy(&e->valuelist);
-    pl_destroy(&e->cclist);
 }
 
 
@@ -1993,10 +2444,12 @@ wchar_t *parse_and_expand_string(const wchar_t *s, const char *name, bool esc)
 }
 
 /* This function is called when an expansion error occurred.
- * The shell exits if it is non-interactive. */
+ * The shell exits if it is non-interactive. In a subshell executed in the
+ * shell process, only the subshell exits. */
 void maybe_exit_on_error(void)
 {
-    if (shell_initialized && !is_interactive_now)
+    if (shell_initialized && !is_interactive_now
+	    && !exit_inline_subshell(Exit_EXPERROR))
 	exit_shell_with_status(Exit_EXPERROR);
 }
 
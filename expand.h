@@ -84,11 +84,20 @@ typedef struct cc_word_T {
 
 struct wordunit_T;
 struct plist_T;
+struct arenamark_T;
+extern void begin_expansion(struct arenamark_T *mark)
+    __attribute__((nonnull));
+extern void end_expansion(const struct arenamark_T *mark)
+    __attribute__((nonnull));
 extern _Bool expand_line(
 	void *const *restrict args,
 	int *restrict argcp,
 	void ***restrict argvp)
     __attribute__((nonnull));
+extern _Bool expand_command_words(
+	void *const *restrict args, char *const *restrict mbswords,
+	int *restrict argcp, void ***restrict argvp, char ***restrict mbsargvp)
+    __attribute__((nonnull(1,3,4,5)));
 extern _Bool expand_multiple(
 	const struct wordunit_T *restrict w, struct plist_T *restrict list)
     __attribute__((nonnull(2)));
@@ -179,7 +179,9 @@ hashtable_T *ht_ensurecapacity(hashtable_T *ht, size_t capacity)
 /* Removes all the entries of a hashtable.
  * If `freer' is non-NULL, it is called for each entry removed (in an
  * unspecified order).
- * The capacity of the hashtable is not changed. */
+ * The capacity of the hashtable is not changed. Only the entries before
+ * `tailindex' are visited, so a large hashtable that contains few entries can
+ * be cleared quickly. */
 hashtable_T *ht_clear(hashtable_T *ht, void freer(kvpair_T kv))
 {
     size_t *indices = ht->indices;
@@ -188,9 +190,10 @@ hashtable_T *ht_clear(hashtable_T *ht, void freer(kvpair_T kv))
     if (ht->count == 0)
 	return ht;
 
-    for (size_t i = 0, cap = ht->capacity; i < cap; i++) {
-	indices[i] = NOTHING;
+    /* Only buckets that contain an occupied entry need resetting. */
+    for (size_t i = 0, tail = ht->tailindex; i < tail; i++) {
 	if (entries[i].kv.key != NULL) {
+	    indices[(size_t) entries[i].hash % ht->capacity] = NOTHING;
 	    if (freer)
 		freer(entries[i].kv);
 	    entries[i].kv.key = NULL;
@@ -122,6 +122,7 @@ read_input:  /* if there's nothing in the buffer, read the next input */
 		case W_READY:
 		    break;
 		case W_TIMED_OUT:
+		case W_CHILD:
 		    assert(false);
 		case W_INTERRUPTED:
 		    // Ignore interruption and continue reading, because:
@@ -151,27 +152,19 @@ read_input:  /* if there's nothing in the buffer, read the next input */
 	    info->bufmax = readcount;
 	}
 
-	/* convert bytes in `info->buf' into a wide character and
-	 * append it to `buf' */
-	wb_ensuremax(buf, add(buf->length, 1));
+	/* convert bytes in `info->buf' up to a newline into wide characters
+	 * and append them to `buf' */
 	assert(info->bufpos < info->bufmax);
-	size_t convcount = mbrtowc(&buf->contents[buf->length],
-		&info->buf[info->bufpos], info->bufmax - info->bufpos,
-		&info->state);
-	switch (convcount) {
-	    case 0:            /* read null character */
-		goto end;
-	    case (size_t) -1:  /* not a valid character */
-		goto error;
-	    case (size_t) -2:  /* needs more input */
-		goto read_input;
-	    default:
-		info->bufpos += convcount;
-		buf->contents[++buf->length] = L'\0';
-		if (buf->contents[buf->length - 1] == L'\n')
-		    goto end;
-		break;
-	}
+	size_t oldlen = buf->length;
+	size_t convcount = wb_mbsncat(buf, &info->buf[info->bufpos],
+		info->bufmax - info->bufpos, &info->state, true);
+	if (convcount == (size_t) -1)  /* not a valid character */
+	    goto error;
+	if (convcount == 0)            /* read null character */
+	    goto end;
+	info->bufpos += convcount;
+	if (buf->length > oldlen && buf->contents[buf->length - 1] == L'\n')
+	    goto end;
     }
 
 error:
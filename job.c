@@ -35,12 +35,15 @@
 #include <wctype.h>
 #include "builtin.h"
 #include "exec.h"
+#include "hashtable.h"
 #include "option.h"
+#include "parser.h"
 #include "plist.h"
 #include "redir.h"
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
+#include "variable.h"
 #include "yash.h"
 #if YASH_ENABLE_LINEEDIT
 # include "xfnmatch.h"
@@ -51,18 +54,22 @@
 #endif
 
 
-static inline job_T *get_job(size_t jobnumber)
-    __attribute__((pure));
+static hashval_T hashpid(const void *p)
+    __attribute__((nonnull,pure));
+static int pidcmp(const void *p1, const void *p2)
+    __attribute__((nonnull,pure));
 static inline void free_job(job_T *job);
 static void trim_joblist(void);
 static void set_current_jobnumber(size_t jobnumber);
 static size_t find_next_job(size_t numlimit);
 static void apply_curstop(void);
+static pid_t waitpid_indexed(int *statusp, int options)
+    __attribute__((nonnull));
 static int calc_status(int status)
     __attribute__((const));
-static inline int calc_status_of_process(const process_T *p)
-    __attribute__((nonnull,pure));
-static wchar_t *get_job_name(const job_T *job)
+static const wchar_t *get_process_name(process_T *p)
+    __attribute__((nonnull));
+static wchar_t *get_job_name(job_T *job)
     __attribute__((nonnull,warn_unused_result));
 static char *get_process_status_string(const process_T *p, bool *needfree)
     __attribute__((nonnull,malloc,warn_unused_result));
@@ -84,6 +91,7 @@ static int continue_job(size_t jobnumber, job_T *job, bool fg)
 static int wait_for_job_by_jobspec(const wchar_t *jobspec)
     __attribute__((nonnull));
 static bool wait_builtin_has_job(bool jobcontrol);
+static int wait_for_next_job(int limit, const wchar_t *pidvar);
 
 
 /* The list of jobs.
@@ -92,30 +100,91 @@ static bool wait_builtin_has_job(bool jobcontrol);
  * The list length is always non-zero. */
 static plist_T joblist;
 
+/* The index of the processes in the job list.
+ * The keys are pointers to the `process_T' structures in the jobs and the
+ * values are pointers to the jobs containing them. Only processes that have
+ * not finished are indexed so that `do_wait' can find the process of a reaped
+ * child in constant time. */
+static hashtable_T pidindex;
+
 /* number of the current/previous jobs. 0 if none. */
 static size_t current_jobnumber, previous_jobnumber;
 
+/* If true, `do_wait' waits only for the processes in `pidindex' rather than
+ * any child process so that the other children of the process are left to
+ * the host program that uses the shell as a library. */
+bool wait_indexed_only = false;
+
 /* Initializes the job list. */
 void init_job(void)
 {
     assert(joblist.contents == NULL);
     pl_init(&joblist);
     pl_add(&joblist, NULL);
+    ht_init(&pidindex, hashpid, pidcmp);
 }
 
 /* Sets the active job. */
 void set_active_job(job_T *job)
+{
+    assert(ACTIVE_JOBNO < joblist.length);
+    assert(joblist.contents[ACTIVE_JOBNO] == NULL);
+    joblist.contents[ACTIVE_JOBNO] = job;
+    index_job(job);
+}
+
+/* Detaches the active job from the job list and returns it.
+ * The processes of the detached job remain in `pidindex' so that `do_wait'
+ * keeps updating their status, but the job is no longer visible to the "jobs",
+ * "wait" and other built-ins or job specifications. The job must be given back
+ * to `set_detached_active_job' before it is waited for or removed. */
+job_T *detach_active_job(void)
+{
+    job_T *job = joblist.contents[ACTIVE_JOBNO];
+    assert(job != NULL);
+    joblist.contents[ACTIVE_JOBNO] = NULL;
+    return job;
+}
+
+/* Makes the job detached by `detach_active_job' the active job again.
+ * There must be no active job when this function is called. */
+void set_detached_active_job(job_T *job)
 {
     assert(ACTIVE_JOBNO < joblist.length);
     assert(joblist.contents[ACTIVE_JOBNO] == NULL);
     joblist.contents[ACTIVE_JOBNO] = job;
 }
 
+/* Adds the unfinished processes of the specified job to `pidindex'.
+ * This function must be called again when a process of the job is replaced
+ * with a new child process. */
+void index_job(job_T *job)
+{
+    for (size_t i = 0; i < job->j_pcount; i++) {
+	process_T *p = &job->j_procs[i];
+	if (p->pr_pid > 0 && p->pr_status != JS_DONE)
+	    ht_set(&pidindex, p, job);
+    }
+}
+
+/* Hashes the process ID of a `process_T' structure. */
+hashval_T hashpid(const void *p)
+{
+    return (hashval_T) ((const process_T *) p)->pr_pid * FNVPRIME;
+}
+
+/* Compares the process IDs of two `process_T' structures. */
+int pidcmp(const void *p1, const void *p2)
+{
+    return ((const process_T *) p1)->pr_pid != ((const process_T *) p2)->pr_pid;
+}
+
 /* Moves the active job into the job list.
  * If the newly added job is stopped, it becomes the current job.
  * If `current' is true or there is no current job, the newly added job becomes
- * the current job if there is no stopped job. */
-void add_job(bool current)
+ * the current job if there is no stopped job.
+ * Returns the job number of the added job. */
+size_t add_job(bool current)
 {
     job_T *job = joblist.contents[ACTIVE_JOBNO];
     size_t jobnumber;
@@ -140,6 +209,7 @@ set_current:
 	set_current_jobnumber(jobnumber);
     else
 	set_current_jobnumber(current_jobnumber);
+    return jobnumber;
 }
 
 /* Returns the job of the specified number or NULL if not found. */
@@ -170,19 +240,30 @@ void remove_all_jobs(void)
     current_jobnumber = previous_jobnumber = 0;
 }
 
-/* Frees the specified job. */
+/* Frees the specified job, removing its processes from `pidindex'. */
 void free_job(job_T *job)
 {
     if (job != NULL) {
-	for (size_t i = 0; i < job->j_pcount; i++)
-	    free(job->j_procs[i].pr_name);
+	for (size_t i = 0; i < job->j_pcount; i++) {
+	    process_T *p = &job->j_procs[i];
+	    if (ht_get(&pidindex, p).key == p)
+		ht_remove(&pidindex, p);
+	    free(p->pr_name);
+	    comsfree(p->pr_command);
+	    pipesfree(p->pr_pipelines);
+	}
 	free(job);
     }
 }
 
-/* Shrink the job list, removing unused elements. */
+/* Shrink the job list, removing unused elements.
+ * The process index is also shrunk if it has become empty. */
 void trim_joblist(void)
 {
+    if (pidindex.count == 0 &&
+	    pidindex.capacity > HASHTABLE_DEFAULT_INIT_CAPACITY)
+	ht_setcapacity(&pidindex, HASHTABLE_DEFAULT_INIT_CAPACITY);
+
     if (joblist.maxlength > 20 && joblist.maxlength / 2 > joblist.length) {
 	pl_setmax(&joblist, joblist.length * 2);
     } else {
@@ -359,7 +440,10 @@ void do_wait(void)
 #endif
 
 start:
-    pid = waitpid(-1, &status, waitpidoption);
+    if (wait_indexed_only)
+	pid = waitpid_indexed(&status, waitpidoption);
+    else
+	pid = waitpid(-1, &status, waitpidoption);
     if (pid < 0) {
 	switch (errno) {
 	    case EINTR:
@@ -386,26 +470,22 @@ start:
 	return;
     }
 
-    size_t jobnumber, pnumber;
-    job_T *job;
-    process_T *pr;
-
-    /* determine `jobnumber', `job' and `pr' from `pid' */
-    for (jobnumber = 0; jobnumber < joblist.length; jobnumber++)
-	if ((job = joblist.contents[jobnumber]) != NULL)
-	    for (pnumber = 0; pnumber < job->j_pcount; pnumber++)
-		if ((pr = &job->j_procs[pnumber])->pr_pid == pid &&
-			pr->pr_status != JS_DONE)
-		    goto found;
+    /* determine `job' and `pr' from `pid' */
+    process_T key = { .pr_pid = pid, };
+    kvpair_T kv = ht_get(&pidindex, &key);
+    process_T *pr = kv.key;
+    job_T *job = kv.value;
 
     /* If `pid' was not found in the job list, we simply ignore it. This may
      * happen on some occasions: e.g. the job has been "disown"ed. */
-    goto start;
+    if (pr == NULL)
+	goto start;
 
-found:
     pr->pr_statuscode = status;
-    if (WIFEXITED(status) || WIFSIGNALED(status))
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
 	pr->pr_status = JS_DONE;
+	ht_remove(&pidindex, pr);
+    }
     if (WIFSTOPPED(status))
 	pr->pr_status = JS_STOPPED;
 #ifdef HAVE_WCONTINUED
@@ -437,6 +517,34 @@ out_of_loop:
     goto start;
 }
 
+/* Like `waitpid(-1, statusp, options)', but waits only for the processes in
+ * `pidindex'. `options' must include WNOHANG.
+ * If a process has already been reaped by someone else, it is reported as if
+ * it exited successfully so that the shell does not wait for it forever. */
+pid_t waitpid_indexed(int *statusp, int options)
+{
+    assert(options & WNOHANG);
+    if (pidindex.count == 0) {
+	errno = ECHILD;
+	return -1;
+    }
+
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&pidindex, &i)).key != NULL) {
+	const process_T *pr = kv.key;
+	pid_t pid = waitpid(pr->pr_pid, statusp, options);
+	if (pid == 0)
+	    continue;
+	if (pid < 0 && errno == ECHILD) {
+	    *statusp = 0;
+	    return pr->pr_pid;
+	}
+	return pid;
+    }
+    return 0;
+}
+
 /* Waits for the specified job to finish (or stop).
  * `jobnumber' must be a valid job number.
  * If `return_on_stop' is false, waits for the job to finish.
@@ -501,6 +609,8 @@ wchar_t **wait_for_child(pid_t cpid, pid_t cpgid, bool return_on_stop)
     job->j_procs[0].pr_status = JS_RUNNING;
     job->j_procs[0].pr_statuscode = 0;
     job->j_procs[0].pr_name = NULL;
+    job->j_procs[0].pr_command = NULL;
+    job->j_procs[0].pr_pipelines = NULL;
     set_active_job(job);
     wait_for_job(ACTIVE_JOBNO, return_on_stop, false, false);
     if (doing_job_control_now)
@@ -646,21 +756,40 @@ int calc_status_of_job(const job_T *job)
     }
 }
 
+/* Returns the name of the specified process.
+ * If the name has not yet been made from the command or pipelines, it is made
+ * now. */
+const wchar_t *get_process_name(process_T *p)
+{
+    if (p->pr_name == NULL) {
+	if (p->pr_command != NULL) {
+	    p->pr_name = command_to_wcs(p->pr_command, false);
+	    comsfree(p->pr_command);
+	    p->pr_command = NULL;
+	} else if (p->pr_pipelines != NULL) {
+	    p->pr_name = pipelines_to_wcs(p->pr_pipelines);
+	    pipesfree(p->pr_pipelines);
+	    p->pr_pipelines = NULL;
+	}
+    }
+    return p->pr_name;
+}
+
 /* Returns the name of the specified job.
  * If the job has only one process, `job->j_procs[0].pr_name' is returned.
  * Otherwise, the names of all the process are concatenated and returned, which
  * must be freed by the caller. */
-wchar_t *get_job_name(const job_T *job)
+wchar_t *get_job_name(job_T *job)
 {
     if (job->j_pcount == 1)
-	return job->j_procs[0].pr_name;
+	return (wchar_t *) get_process_name(&job->j_procs[0]);
 
     xwcsbuf_T buf;
     wb_init(&buf);
     for (size_t i = 0; i < job->j_pcount; i++) {
 	if (i > 0)
 	    wb_cat(&buf, L" | ");
-	wb_cat(&buf, job->j_procs[i].pr_name);
+	wb_cat(&buf, get_process_name(&job->j_procs[i]));
     }
     return wb_towcs(&buf);
 }
@@ -792,7 +921,7 @@ int print_job_status(size_t jobnumber,
 	char *status = get_process_status_string(
 		&job->j_procs[posixly_correct ? job->j_pcount - 1 : 0],
 		&needfree);
-	wchar_t *jobname = job->j_procs[0].pr_name;
+	const wchar_t *jobname = get_process_name(&job->j_procs[0]);
 
 	/* TRANSLATORS: the translated format string can be different 
 	 * from the original only in the number of spaces. This is required
@@ -806,7 +935,7 @@ int print_job_status(size_t jobnumber,
 	for (size_t i = 1; result == 0 && i < job->j_pcount; i++) {
 	    pid = job->j_procs[i].pr_pid;
 	    status = get_process_status_string(&job->j_procs[i], &needfree);
-	    jobname = job->j_procs[i].pr_name;
+	    jobname = get_process_name(&job->j_procs[i]);
 
 	    /* TRANSLATORS: the translated format string can be different 
 	     * from the original only in the number of spaces. This is required
@@ -955,7 +1084,7 @@ void generate_job_candidates(const le_compopt_T *compopt)
 	return;
 
     for (size_t i = 1; i < joblist.length; i++) {
-	const job_T *job = joblist.contents[i];
+	job_T *job = joblist.contents[i];
 	if (job == NULL)
 	    continue;
 	switch (job->j_status) {
@@ -1272,16 +1401,54 @@ const char bg_syntax[] = Ngt(
 
 #endif /* YASH_ENABLE_HELP */
 
-/* The "wait" built-in */
+/* Options for the "wait" built-in. */
+const struct xgetopt_T wait_options[] = {
+    { L'l', L"limit",        OPTARG_REQUIRED, false, NULL, },
+    { L'n', L"next",         OPTARG_NONE,     false, NULL, },
+    { L'p', L"pid-variable", OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_HELP
+    { L'-', L"help",         OPTARG_NONE,     false, NULL, },
+#endif
+    { L'\0', NULL, 0, false, NULL, },
+};
+
+/* The "wait" built-in, which accepts the following options:
+ *  -l: wait for a job only if as many jobs as the limit are running
+ *  -n: wait for any one job to finish
+ *  -p: assign the process ID of the finished job to the variable */
 int wait_builtin(int argc, void **argv)
 {
     bool jobcontrol = doing_job_control_now;
     int status = Exit_SUCCESS;
+    int limit = 0;
+    const wchar_t *pidvar = NULL;
 
     const struct xgetopt_T *opt;
     xoptind = 0;
-    while ((opt = xgetopt(argv, help_option, 0)) != NULL) {
+    while ((opt = xgetopt(argv, wait_options, 0)) != NULL) {
 	switch (opt->shortopt) {
+	    case L'l':
+		if (!xwcstoi(xoptarg, 10, &limit)) {
+		    xerror(0, Ngt("`%ls' is not a valid integer"), xoptarg);
+		    return Exit_ERROR;
+		}
+		if (limit <= 0) {
+		    xerror(0, Ngt("`%ls' is not a positive integer"), xoptarg);
+		    return Exit_ERROR;
+		}
+		break;
+	    case L'n':
+		if (limit == 0)
+		    limit = 1;
+		break;
+	    case L'p':
+		pidvar = xoptarg;
+		if (wcschr(pidvar, L'=') != NULL) {
+		    xerror(0, Ngt("`%ls' is not a valid variable name"),
+			    pidvar);
+		    return Exit_ERROR;
+		}
+		break;
 #if YASH_ENABLE_HELP
 	    case L'-':
 		return print_builtin_help(ARGV(0));
@@ -1291,7 +1458,12 @@ int wait_builtin(int argc, void **argv)
 	}
     }
 
-    if (xoptind < argc) {
+    if (limit > 0 || pidvar != NULL) {
+	/* wait for any one job */
+	if (xoptind < argc)
+	    return too_many_operands_error(0);
+	status = wait_for_next_job(limit > 0 ? limit : 1, pidvar);
+    } else if (xoptind < argc) {
 	/* wait for the specified jobs */
 	for (; xoptind < argc; xoptind++) {
 	    int jobstatus = wait_for_job_by_jobspec(ARGV(xoptind));
@@ -1318,6 +1490,63 @@ int wait_builtin(int argc, void **argv)
     return status;
 }
 
+/* Waits until fewer than `limit' jobs are running or any job finishes.
+ * If a finished job is found, it is removed from the job list (or its status
+ * is printed if interactive) and its exit status is returned. The process ID
+ * of the last process of the job is assigned to the variable named `pidvar'
+ * if `pidvar' is non-NULL.
+ * If no job has finished and fewer than `limit' jobs are running, the
+ * variable is set to an empty string and Exit_SUCCESS is returned. If there
+ * is no job at all, Exit_NOTFOUND is returned instead.
+ * Returns a value greater than TERMSIGOFFSET if interrupted by a signal. */
+int wait_for_next_job(int limit, const wchar_t *pidvar)
+{
+    bool jobcontrol = doing_job_control_now;
+    size_t jobnumber;
+    job_T *job;
+
+    for (;;) {
+	size_t running = 0;
+	for (jobnumber = 1; jobnumber < joblist.length; jobnumber++) {
+	    job = joblist.contents[jobnumber];
+	    if (job == NULL)
+		continue;
+	    if (job->j_legacy)
+		remove_job(jobnumber);
+	    else if (job->j_status == JS_DONE)
+		goto found;
+	    else if (job->j_status == JS_RUNNING)
+		running++;
+	}
+
+	if (running < (size_t) limit) {
+	    if (pidvar != NULL && !set_variable(
+			pidvar, xwcsdup(L""), SCOPE_GLOBAL, false))
+		return Exit_FAILURE;
+	    return (running > 0) ? Exit_SUCCESS : Exit_NOTFOUND;
+	}
+
+	int signum = wait_for_sigchld(jobcontrol, true);
+	if (signum != 0) {
+	    assert(TERMSIGOFFSET >= 128);
+	    return signum + TERMSIGOFFSET;
+	}
+    }
+
+found:;
+    int status = calc_status_of_job(job);
+    pid_t pid = job->j_procs[job->j_pcount - 1].pr_pid;
+    if (jobcontrol && is_interactive_now && !posixly_correct)
+	print_job_status(jobnumber, false, false, true, stdout);
+    else
+	remove_job(jobnumber);
+    if (pidvar != NULL && !set_variable(pidvar,
+		malloc_wprintf(L"%jd", (intmax_t) pid),
+		SCOPE_GLOBAL, false))
+	return Exit_FAILURE;
+    return status;
+}
+
 /* Finds a job specified by the argument and waits for it.
  * Returns a negated exit status if interrupted. */
 int wait_for_job_by_jobspec(const wchar_t *jobspec)
@@ -1388,6 +1617,7 @@ const char wait_help[] = Ngt(
 );
 const char wait_syntax[] = Ngt(
 "\twait [job or process_id...]\n"
+"\twait -n [-l limit] [-p variable]\n"
 );
 #endif
 
@@ -29,17 +29,24 @@ typedef enum jobstatus_T {
     JS_RUNNING, JS_STOPPED, JS_DONE,
 } jobstatus_T;
 
+struct command_T;
+
 /* info about a process in a job */
 typedef struct process_T {
     pid_t        pr_pid;          /* process ID */
     jobstatus_T  pr_status;
     int          pr_statuscode;
     wchar_t     *pr_name;         /* process name made from command line */
+    struct command_T *pr_command; /* command to make `pr_name' from */
+    struct pipeline_T *pr_pipelines; /* pipelines to make `pr_name' from */
 } process_T;
 /* If `pr_pid' is 0, the process was finished without `fork'ing from the shell.
  * In this case, `pr_status' is JS_DONE and `pr_statuscode' is the exit status.
  * If `pr_pid' is a positive number, it's the process ID. In this case,
- * `pr_statuscode' is the status code returned by `waitpid'. */
+ * `pr_statuscode' is the status code returned by `waitpid'.
+ * If `pr_name' is NULL and `pr_command' or `pr_pipelines' is non-NULL, the name
+ * has not yet been made from the command or pipelines. It is made when it is
+ * first needed. */
 
 /* info about a job */
 typedef struct job_T {
@@ -71,7 +78,14 @@ extern void init_job(void);
 
 extern void set_active_job(job_T *job)
     __attribute__((nonnull));
-extern void add_job(_Bool current);
+extern job_T *detach_active_job(void);
+extern void set_detached_active_job(job_T *job)
+    __attribute__((nonnull));
+extern void index_job(job_T *job)
+    __attribute__((nonnull));
+extern size_t add_job(_Bool current);
+extern job_T *get_job(size_t jobnumber)
+    __attribute__((pure));
 extern void remove_job(size_t jobnumber);
 extern void remove_job_nofitying_signal(size_t jobnumber);
 extern void remove_all_jobs(void);
@@ -81,6 +95,7 @@ extern size_t job_count(void)
 extern size_t stopped_job_count(void)
     __attribute__((pure));
 
+extern _Bool wait_indexed_only;
 extern void do_wait(void);
 extern int wait_for_job(size_t jobnumber, _Bool return_on_stop,
 	_Bool interruptible, _Bool return_on_trap);
@@ -91,6 +106,8 @@ extern pid_t get_job_pgid(const wchar_t *jobname)
 extern void put_foreground(pid_t pgrp);
 extern void ensure_foreground(void);
 
+extern int calc_status_of_process(const process_T *p)
+    __attribute__((pure,nonnull));
 extern int calc_status_of_job(const job_T *job)
     __attribute__((pure,nonnull));
 
@@ -117,6 +134,7 @@ extern int wait_builtin(int argc, void **argv)
 #if YASH_ENABLE_HELP
 extern const char wait_help[], wait_syntax[];
 #endif
+extern const struct xgetopt_T wait_options[];
 
 extern int disown_builtin(int argc, void **argv)
     __attribute__((nonnull));
@@ -0,0 +1,390 @@
+/* Yash: yet another shell */
+/* libyash.c: interface for embedding the shell in another program */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "libyash.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#if HAVE_GETTEXT
+# include <libintl.h>
+#endif
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "exec.h"
+#include "hashtable.h"
+#include "job.h"
+#include "option.h"
+#include "path.h"
+#include "redir.h"
+#include "sig.h"
+#include "strbuf.h"
+#include "util.h"
+#include "variable.h"
+#include "yash.h"
+
+
+/* About the library interface:
+ *
+ * The shell keeps its state in global variables, so the library does not
+ * create a separate instance of the shell for each context. Instead, the
+ * shell is initialized when the first context is created and each context
+ * owns the part of the state that belongs to a single run of the shell: a
+ * variable environment that is opened on top of the global environment, the
+ * exit status of the last run, and the state of the executor (`execstate'),
+ * which is reset for every run. Only one context can exist at a time so that
+ * the variable environment of the context is always the current one.
+ *
+ * Scripts may also change the rest of the state: global variables, functions,
+ * shell options, traps, the working directory, and the umask. That state is
+ * saved when a context is created and restored when it is destroyed, so the
+ * next context starts with the same state as the previous one did. Traps are
+ * simply reset since no trap is set when a context is created.
+ *
+ * The signal mask and signal handlers of the host program are saved when a
+ * context is created and the shell's own are installed. They are given back
+ * when the context is destroyed. While the shell is initialized, `do_wait'
+ * waits only for the shell's own child processes (`wait_indexed_only') so that
+ * it does not reap the children of the host program.
+ *
+ * Commands are executed as if in a subshell executed in the shell process
+ * (see `enter_inline_subshell'), so the "exit" built-in, the "errexit"
+ * option, and errors that would make a non-interactive shell exit end the run
+ * rather than the host program. The "exec" built-in is refused because it
+ * would replace the host program. */
+
+struct yash_T {
+    bool capture;       /* whether to capture the standard output */
+    int laststatus;     /* exit status of the last run */
+    xstrbuf_T output;   /* standard output captured in the last run */
+
+    /* state of the shell saved when the context was created */
+    struct savedvar_T *variables;
+    struct hashtable_T *functions;
+    bool *options;
+    int cwdfd;          /* shell FD of the working directory */
+    mode_t umask;
+    struct sigstate_T *signals;  /* signal settings of the host program */
+};
+
+/* Saved state of the shell during a run. */
+struct run_T {
+    int savestdout;     /* shell FD that saves the standard output */
+    int capturefd;      /* shell FD of the file capturing the output */
+    struct execstate_T *execstate;
+};
+
+static bool begin_run(yash_T *yash, struct run_T *run)
+    __attribute__((nonnull));
+static bool begin_capture(struct run_T *run)
+    __attribute__((nonnull));
+static void end_run(yash_T *yash, struct run_T *run)
+    __attribute__((nonnull));
+static void end_capture(yash_T *yash, struct run_T *run)
+    __attribute__((nonnull));
+
+/* The context that currently exists, if any. */
+static yash_T *current_yash = NULL;
+
+/* Set to true when the shell has been initialized. */
+static bool initialized = false;
+
+
+/* Creates a new context.
+ * The shell is initialized when this function is first called.
+ * If another context exists, `errno' is set to EBUSY and NULL is returned.
+ * If the working directory cannot be saved, NULL is returned with `errno'
+ * set. */
+yash_T *yash_create(void)
+{
+    if (current_yash != NULL) {
+	errno = EBUSY;
+	return NULL;
+    }
+
+    int cwdfd = move_to_shellfd(open(".", O_RDONLY));
+    if (cwdfd < 0)
+	return NULL;
+
+    struct sigstate_T *signals = save_signal_state();
+    if (!initialized) {
+	yash_program_invocation_name = L"yash";
+	yash_program_invocation_short_name = L"yash";
+	command_name = L"yash";
+	wait_indexed_only = true;
+	init_shell();
+	init_variables();
+	set_positional_parameters((void *[]) { NULL });
+	shell_initialized = true;
+	initialized = true;
+    } else {
+	init_signal();
+    }
+    set_signals();
+
+    yash_T *yash = xmalloc(sizeof *yash);
+    yash->capture = false;
+    yash->laststatus = Exit_SUCCESS;
+    sb_init(&yash->output);
+
+    yash->variables = save_global_variables();
+    yash->functions = save_functions();
+    yash->options = save_shell_options();
+    yash->cwdfd = cwdfd;
+    yash->umask = umask(0);
+    umask(yash->umask);
+    yash->signals = signals;
+
+    open_new_environment(false);
+    set_positional_parameters((void *[]) { NULL });
+
+    current_yash = yash;
+    return yash;
+}
+
+/* Destroys the specified context, which may be NULL.
+ * The variables in the context's environment are removed and the rest of the
+ * state of the shell is restored to that when the context was created. The
+ * signal settings of the host program are restored. */
+void yash_destroy(yash_T *yash)
+{
+    if (yash == NULL)
+	return;
+
+    assert(yash == current_yash);
+    close_current_environment();
+    restore_global_variables(yash->variables);
+    restore_functions(yash->functions);
+    restore_shell_options(yash->options);
+    reset_traps();
+    restore_signal_state(yash->signals);
+    if (fchdir(yash->cwdfd) < 0)
+	xerror(errno, Ngt("cannot restore the working directory"));
+    remove_shellfd(yash->cwdfd);
+    xclose(yash->cwdfd);
+    umask(yash->umask);
+
+    sb_destroy(&yash->output);
+    free(yash);
+    current_yash = NULL;
+}
+
+/* Assigns a value to the variable in the context's environment.
+ * Returns false if the name or value cannot be converted into a wide string
+ * or the variable is read-only. */
+bool yash_set_variable(yash_T *yash, const char *name, const char *value)
+{
+    assert(yash == current_yash);
+
+    wchar_t *wname = malloc_mbstowcs(name);
+    if (wname == NULL)
+	return false;
+
+    wchar_t *wvalue = malloc_mbstowcs(value);
+    if (wvalue == NULL) {
+	free(wname);
+	return false;
+    }
+
+    bool ok = set_variable(wname, wvalue, SCOPE_LOCAL, false);
+    free(wname);
+    return ok;
+}
+
+/* Returns the value of the scalar variable in a newly malloced string.
+ * Returns NULL if the variable is not set, is an array, or cannot be converted
+ * into a multibyte string. */
+char *yash_get_variable(yash_T *yash, const char *name)
+{
+    assert(yash == current_yash);
+
+    wchar_t *wname = malloc_mbstowcs(name);
+    if (wname == NULL)
+	return NULL;
+
+    const wchar_t *value = getvar(wname);
+    free(wname);
+    return value != NULL ? malloc_wcstombs(value) : NULL;
+}
+
+/* Sets whether the standard output of the following runs is captured.
+ * The captured output can be obtained by `yash_output'. */
+void yash_set_capture(yash_T *yash, bool capture)
+{
+    yash->capture = capture;
+}
+
+/* Parses and executes the specified string in the context.
+ * Returns the exit status. */
+int yash_run_string(yash_T *yash, const char *code)
+{
+    wchar_t *wcode = malloc_mbstowcs(code);
+    if (wcode == NULL) {
+	xerror(EILSEQ, Ngt("cannot convert the multibyte characters "
+		    "into wide characters"));
+	sb_clear(&yash->output);
+	return yash->laststatus = Exit_ERROR;
+    }
+
+    struct run_T run;
+    if (begin_run(yash, &run)) {
+	exec_wcs(wcode, NULL, false);
+	end_run(yash, &run);
+    }
+    free(wcode);
+    return yash->laststatus;
+}
+
+/* Parses and executes the specified file in the context.
+ * Returns the exit status. */
+int yash_run_file(yash_T *yash, const char *path)
+{
+    int fd = move_to_shellfd(open(path, O_RDONLY));
+    if (fd < 0) {
+	int errno_ = errno;
+	xerror(errno_, Ngt("cannot open file `%s'"), path);
+	sb_clear(&yash->output);
+	return yash->laststatus =
+	    (errno_ == ENOENT ? Exit_NOTFOUND : Exit_NOEXEC);
+    }
+
+    struct run_T run;
+    if (begin_run(yash, &run)) {
+	exec_input(fd, path, XIO_SUBST_ALIAS);
+	end_run(yash, &run);
+    }
+    remove_shellfd(fd);
+    xclose(fd);
+    return yash->laststatus;
+}
+
+/* Returns the exit status of the last run in the context. */
+int yash_exit_status(const yash_T *yash)
+{
+    return yash->laststatus;
+}
+
+/* Returns the standard output captured in the last run.
+ * The returned string is valid until the next run or the destruction of the
+ * context. If `lengthp' is non-NULL, the length of the output is assigned to
+ * `*lengthp'. */
+const char *yash_output(const yash_T *yash, size_t *lengthp)
+{
+    if (lengthp != NULL)
+	*lengthp = yash->output.length;
+    return yash->output.contents;
+}
+
+/* Prepares the shell for executing commands in the context.
+ * Returns false if the output cannot be captured. */
+bool begin_run(yash_T *yash, struct run_T *run)
+{
+    assert(yash == current_yash);
+
+    sb_clear(&yash->output);
+    run->savestdout = run->capturefd = -1;
+    if (yash->capture && !begin_capture(run)) {
+	yash->laststatus = Exit_FAILURE;
+	return false;
+    }
+
+    laststatus = yash->laststatus;
+    run->execstate = save_execstate();
+    reset_execstate(true);
+    enter_inline_subshell();
+    return true;
+}
+
+/* Redirects the standard output to a temporary file. */
+bool begin_capture(struct run_T *run)
+{
+    char *filename;
+    int fd = create_temporary_file(&filename, "", S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+	xerror(errno, Ngt("cannot create a temporary file "
+		    "to capture the output"));
+	return false;
+    }
+    unlink(filename);
+    free(filename);
+
+    run->capturefd = move_to_shellfd(fd);
+    if (run->capturefd < 0) {
+	xerror(errno, Ngt("cannot create a temporary file "
+		    "to capture the output"));
+	return false;
+    }
+
+    fflush(stdout);
+    run->savestdout = copy_as_shellfd(STDOUT_FILENO);
+    xdup2(run->capturefd, STDOUT_FILENO);
+    return true;
+}
+
+/* Restores the state of the shell saved in `begin_run' and saves the result of
+ * the run in the context. */
+void end_run(yash_T *yash, struct run_T *run)
+{
+    leave_inline_subshell();
+    restore_execstate(run->execstate);
+    yash->laststatus = laststatus & 0xFF;
+
+    if (run->capturefd >= 0)
+	end_capture(yash, run);
+}
+
+/* Restores the standard output and reads the captured output. */
+void end_capture(yash_T *yash, struct run_T *run)
+{
+    fflush(stdout);
+    if (run->savestdout >= 0) {
+	xdup2(run->savestdout, STDOUT_FILENO);
+	remove_shellfd(run->savestdout);
+	xclose(run->savestdout);
+    } else {
+	xclose(STDOUT_FILENO);
+    }
+
+    if (lseek(run->capturefd, 0, SEEK_SET) < 0) {
+	xerror(errno, Ngt("cannot read the captured output"));
+    } else {
+	for (;;) {
+	    char buf[BUFSIZ];
+	    ssize_t n = read(run->capturefd, buf, sizeof buf);
+	    if (n < 0) {
+		if (errno == EINTR)
+		    continue;
+		xerror(errno, Ngt("cannot read the captured output"));
+		break;
+	    }
+	    if (n == 0)
+		break;
+	    sb_ncat_force(&yash->output, buf, (size_t) n);
+	}
+    }
+    remove_shellfd(run->capturefd);
+    xclose(run->capturefd);
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
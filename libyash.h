@@ -0,0 +1,80 @@
+/* Yash: yet another shell */
+/* libyash.h: interface for embedding the shell in another program */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_LIBYASH_H
+#define YASH_LIBYASH_H
+
+#include <stddef.h>
+
+
+/* A shell context, in which scripts are executed in the calling process.
+ * Only one context can exist at a time, but contexts can be created one after
+ * another. Variables, functions, options, traps, the working directory, and
+ * the umask changed in a context do not remain after the context is destroyed.
+ * The host program should call `setlocale' before creating the first
+ * context.
+ *
+ * The shell runs in the host process and uses the following process-wide
+ * state, which the host program must take into account:
+ *  - Signals: while a context exists, SIGCHLD is blocked and caught by the
+ *    shell, and traps and interactive or job-control settings may change
+ *    other signals. The signal mask and the signal handlers of all signals
+ *    are saved by `yash_create' and restored by `yash_destroy'.
+ *  - Child processes: once the first context has been created, the shell
+ *    waits only for the processes it started, so the host program can wait
+ *    for its own children as usual. The host program must not wait for the
+ *    shell's children, e.g. by `waitpid(-1, ...)', while a context exists.
+ *  - The working directory and the umask: they are restored by
+ *    `yash_destroy'.
+ *  - File descriptors: the shell keeps some file descriptors open for its own
+ *    use with the close-on-exec flag set. The standard output is temporarily
+ *    redirected while a run's output is being captured.
+ *  - Environment variables and the locale: exported variables that affect
+ *    the C library (LANG, LC_*, TZ, TERM, etc.) are also set in `environ',
+ *    and assigning to LANG or LC_* changes the locale of the process. The
+ *    host program should set its locale again after destroying a context if
+ *    a script may have changed it. Other variables are only passed to the
+ *    commands the shell executes. */
+typedef struct yash_T yash_T;
+
+extern yash_T *yash_create(void)
+    __attribute__((warn_unused_result));
+extern void yash_destroy(yash_T *yash);
+
+extern _Bool yash_set_variable(
+	yash_T *yash, const char *name, const char *value)
+    __attribute__((nonnull));
+extern char *yash_get_variable(yash_T *yash, const char *name)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
+extern void yash_set_capture(yash_T *yash, _Bool capture)
+    __attribute__((nonnull));
+extern int yash_run_string(yash_T *yash, const char *code)
+    __attribute__((nonnull));
+extern int yash_run_file(yash_T *yash, const char *path)
+    __attribute__((nonnull));
+extern int yash_exit_status(const yash_T *yash)
+    __attribute__((nonnull,pure));
+extern const char *yash_output(const yash_T *yash, size_t *lengthp)
+    __attribute__((nonnull(1),pure));
+
+
+#endif /* YASH_LIBYASH_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -0,0 +1,201 @@
+/* Yash: yet another shell */
+/* libyashtest.c: test host program for the library interface */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+/* This program is linked with libyash.a and exercises the library interface.
+ * It exits with a non-zero status if any check fails. */
+
+#define _POSIX_C_SOURCE 200809L
+#include <locale.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "libyash.h"
+
+
+static void check_run(yash_T *yash, const char *code,
+	int expected_status, const char *expected_output)
+    __attribute__((nonnull));
+static char *run_and_copy_output(yash_T *yash, const char *code)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool is_sigchld_blocked(void);
+static void check(bool ok, const char *what)
+    __attribute__((nonnull));
+
+static int failure_count = 0;
+
+
+int main(void)
+{
+    setlocale(LC_ALL, "");
+
+    yash_T *yash = yash_create();
+    check(yash != NULL, "creating a context");
+    if (yash == NULL)
+	return EXIT_FAILURE;
+    check(yash_create() == NULL, "rejecting a second context");
+
+    yash_set_capture(yash, true);
+    char *initial_state = run_and_copy_output(yash, "echo \"$-\"; pwd; umask");
+    check_run(yash, "echo foo; echo bar", 0, "foo\nbar\n");
+    check_run(yash, "false", 1, "");
+    check_run(yash, "echo $?", 0, "1\n");
+
+    check(yash_set_variable(yash, "greeting", "hello"), "setting a variable");
+    check_run(yash, "echo \"$greeting\"", 0, "hello\n");
+    check_run(yash, "answer=42", 0, "");
+    char *answer = yash_get_variable(yash, "answer");
+    check(answer != NULL && strcmp(answer, "42") == 0, "getting a variable");
+    free(answer);
+
+    check_run(yash, "echo before; exit 3; echo after", 3, "before\n");
+    check_run(yash, "set -e; false; echo after", 1, "");
+    check_run(yash, "set +e; (", 2, "");
+    check_run(yash, "f() { return 5; }; f", 5, "");
+    check_run(yash, "sh -c 'echo external; exit 4'", 4, "external\n");
+
+    /* errors that make a non-interactive shell exit end only the run */
+    check_run(yash, "x=${y?oops}; echo after", 2, "");
+    check_run(yash, "readonly r=1; r=2; echo after", 2, "");
+    check_run(yash, "set +o forlocal; for r in 3; do echo in; done; echo after",
+	    2, "");
+    check_run(yash, "set -u; echo $nosuch; echo after", 2, "");
+    check_run(yash, "set +u; (; echo after", 2, "");
+    check_run(yash, "set +e; exec true; echo $?", 0, "2\n");
+    check_run(yash, "exec sh -c 'echo replaced'; echo $?", 0, "2\n");
+    check_run(yash, "set -o posixlycorrect; set --nosuch; echo after", 2, "");
+    check_run(yash, "echo alive", 0, "alive\n");
+
+    char path[] = "/tmp/libyashtest.XXXXXX";
+    int fd = mkstemp(path);
+    check(fd >= 0, "creating a script file");
+    if (fd >= 0) {
+	const char script[] = "echo \"script $greeting\"\nexit 6\n";
+	check(write(fd, script, sizeof script - 1)
+		== (ssize_t) (sizeof script - 1), "writing a script file");
+	close(fd);
+	check(yash_run_file(yash, path) == 6, "running a file");
+	check(strcmp(yash_output(yash, NULL), "script hello\n") == 0,
+		"capturing the output of a file");
+	unlink(path);
+    }
+    check(yash_run_file(yash, "/nonexistent/libyashtest") == 127,
+	    "running a non-existent file");
+    check(yash_exit_status(yash) == 127, "saving the exit status");
+
+    /* state that must not leak into the next context */
+    check_run(yash, "f() { echo function; }; trap 'echo trapped' USR1; "
+	    "cd /; umask 077; set -o allexport", 0, "");
+
+    yash_destroy(yash);
+
+    yash = yash_create();
+    check(yash != NULL, "creating another context");
+    if (yash == NULL)
+	return EXIT_FAILURE;
+    yash_set_capture(yash, true);
+    check_run(yash, "echo $? \"${greeting-unset}\" \"${answer-unset}\" "
+	    "\"${r-unset}\"", 0, "0 unset unset unset\n");
+    check_run(yash, "r=4; echo $r", 0, "4\n");
+    check_run(yash, "command -v f || echo no function", 0, "no function\n");
+    check_run(yash, "trap", 0, "");
+
+    /* the shell must not reap the children of the host program */
+    pid_t child = fork();
+    if (child == 0)
+	_exit(7);
+    check(child > 0, "forking a child of the host");
+    check_run(yash, "sleep 0.3", 0, "");
+    if (child > 0) {
+	int status;
+	check(waitpid(child, &status, 0) == child
+		&& WIFEXITED(status) && WEXITSTATUS(status) == 7,
+		"waiting for a child of the host");
+    }
+
+    char *state = run_and_copy_output(yash, "echo \"$-\"; pwd; umask");
+    check(strcmp(state, initial_state) == 0,
+	    "restoring the options, working directory, and umask");
+    free(state);
+    free(initial_state);
+    yash_destroy(yash);
+
+    struct sigaction action;
+    sigaction(SIGCHLD, NULL, &action);
+    check(!is_sigchld_blocked() && action.sa_handler == SIG_DFL,
+	    "restoring the signal mask and handlers");
+
+    if (failure_count > 0) {
+	fprintf(stderr, "%d check(s) failed\n", failure_count);
+	return EXIT_FAILURE;
+    }
+    printf("all checks passed\n");
+    return EXIT_SUCCESS;
+}
+
+/* Runs `code' and checks the exit status and captured output. */
+void check_run(yash_T *yash, const char *code,
+	int expected_status, const char *expected_output)
+{
+    int status = yash_run_string(yash, code);
+    size_t length;
+    const char *output = yash_output(yash, &length);
+
+    if (status != expected_status) {
+	fprintf(stderr, "%s: exit status %d, expected %d\n",
+		code, status, expected_status);
+	failure_count++;
+    } else if (length != strlen(expected_output)
+	    || memcmp(output, expected_output, length) != 0) {
+	fprintf(stderr, "%s: output \"%.*s\", expected \"%s\"\n",
+		code, (int) length, output, expected_output);
+	failure_count++;
+    }
+}
+
+/* Runs `code' and returns a copy of the captured output. */
+char *run_and_copy_output(yash_T *yash, const char *code)
+{
+    size_t length;
+    yash_run_string(yash, code);
+    const char *output = yash_output(yash, &length);
+    return strndup(output != NULL ? output : "", length);
+}
+
+/* Returns true if SIGCHLD is blocked in the calling thread. */
+bool is_sigchld_blocked(void)
+{
+    sigset_t ss;
+    sigprocmask(SIG_SETMASK, NULL, &ss);
+    return sigismember(&ss, SIGCHLD);
+}
+
+void check(bool ok, const char *what)
+{
+    if (!ok) {
+	fprintf(stderr, "failed: %s\n", what);
+	failure_count++;
+    }
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
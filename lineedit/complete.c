@@ -983,8 +983,8 @@ void generate_keyword_candidates(const le_compopt_T *compopt)
 	return;
 
     static const wchar_t *keywords[] = {
-	L"case", L"do", L"done", L"elif", L"else", L"esac", L"fi", L"for",
-	L"function", L"if", L"then", L"until", L"while", NULL,
+	L"case", L"coproc", L"do", L"done", L"elif", L"else", L"esac", L"fi",
+	L"for", L"function", L"if", L"then", L"until", L"while", NULL,
 	// XXX "select" is not currently supported
     };
 
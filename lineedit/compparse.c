@@ -24,6 +24,7 @@
 #include <wchar.h>
 #include <wctype.h>
 #include "../alias.h"
+#include "../arena.h"
 #include "../expand.h"
 #include "../option.h"
 #include "../parser.h"
@@ -259,6 +260,9 @@ bool cparse_command(void)
 	return cparse_case_command();
     } else if (!posixly_correct && has_token(L"function")) {
 	return cparse_function_definition();
+    } else if (!posixly_correct && has_token(L"coproc")) {
+	INDEX += 6;
+	return false;
     } else {
 	return cparse_simple_command();
     }
@@ -311,7 +315,10 @@ cparse_simple_command:
 	    set_pwords(&pwords);
 	    return true;
 	} else {
+	    arenamark_T mark;
+	    begin_expansion(&mark);
 	    expand_multiple(w, &pwords);
+	    end_expansion(&mark);
 	    wordfree(w);
 	}
 
@@ -388,7 +395,10 @@ bool ctryparse_assignment(void)
 		set_pwords(&pwords);
 		return true;
 	    } else {
+		arenamark_T mark;
+		begin_expansion(&mark);
 		expand_multiple(w, &pwords);
+		end_expansion(&mark);
 		wordfree(w);
 	    }
 	}
@@ -499,7 +509,10 @@ bool cparse_for_command(void)
 		set_pwords(&pwords);
 		return true;
 	    } else {
+		arenamark_T mark;
+		begin_expansion(&mark);
 		expand_multiple(w, &pwords);
+		end_expansion(&mark);
 		wordfree(w);
 	    }
 	}
@@ -237,6 +237,8 @@ direct_first_buffer:
 	case W_TIMED_OUT:
 	    timeout = true;
 	    break;
+	case W_CHILD:
+	    assert(false);
 	case W_INTERRUPTED:
 	    le_editstate = LE_EDITSTATE_INTERRUPTED;
 	    return;
@@ -91,6 +91,12 @@ bool shopt_allexport = false;
 bool shopt_hashondef = false;
 /* If set, the 'for' loop iteration variable will be made local. */
 bool shopt_forlocal = true;
+/* If set, subshells that can be emulated are executed in the shell process
+ * instead of a child process. Corresponds to the --inlinesubshell option. */
+bool shopt_inlinesubshell = false;
+/* If set, loops and function bodies are compiled into bytecode before they are
+ * executed. Corresponds to the --bytecode option. */
+bool shopt_bytecode = false;
 
 /* If set, when a command returns a non-zero status, the shell exits.
  * Corresponds to the -e/--errexit option. */
@@ -103,6 +109,10 @@ bool shopt_errreturn = false;
  * defines the exit status of the whole pipeline. Corresponds to the --pipefail
  * option. */
 bool shopt_pipefail = false;
+/* If set, the last command of a pipeline is executed in the current shell
+ * process when job control is inactive. Corresponds to the --lastpipe option.
+ */
+bool shopt_lastpipe = false;
 /* If set, undefined variables are expanded to an empty string.
  * Corresponds to the +u/--unset option. */
 bool shopt_unset = true;
@@ -213,6 +223,7 @@ struct option_T {
 static const struct option_T shell_options[] = {
     { L'a', 0,    L"allexport",      &shopt_allexport,      true, },
     { 0,    0,    L"braceexpand",    &shopt_braceexpand,    true, },
+    { 0,    0,    L"bytecode",       &shopt_bytecode,       true, },
     { 0,    0,    L"caseglob",       &shopt_caseglob,       true, },
     { 0,    L'C', L"clobber",        &shopt_clobber,        true, },
     { L'c', 0,    L"cmdline",        &shopt_cmdline,        false, },
@@ -235,7 +246,9 @@ static const struct option_T shell_options[] = {
     { 0,    0,    L"histspace",      &shopt_histspace,      true, },
 #endif
     { 0,    0,    L"ignoreeof",      &shopt_ignoreeof,      true, },
+    { 0,    0,    L"inlinesubshell", &shopt_inlinesubshell, true, },
     { L'i', 0,    L"interactive",    &is_interactive,       false, },
+    { 0,    0,    L"lastpipe",       &shopt_lastpipe,       true, },
 #if YASH_ENABLE_LINEEDIT
     { 0,    0,    L"lealwaysrp",     &shopt_le_alwaysrp,    true, },
     { 0,    0,    L"lecompdebug",    &shopt_le_compdebug,   true, },
@@ -278,6 +291,10 @@ enum normal_option_index_T {
     NOI_NORCFILE,
     NOI_PROFILE,
     NOI_RCFILE,
+#if YASH_ENABLE_SOCKET
+    NOI_SERVER,
+    NOI_CLIENT,
+#endif
     NOI_N,
 };
 
@@ -296,6 +313,10 @@ static const struct xgetopt_T normal_options[] = {
     [NOI_NORCFILE]  = { L'-', L"norcfile",  OPTARG_NONE,     false, NULL, },
     [NOI_PROFILE]   = { L'-', L"profile",   OPTARG_REQUIRED, false, NULL, },
     [NOI_RCFILE]    = { L'-', L"rcfile",    OPTARG_REQUIRED, false, NULL, },
+#if YASH_ENABLE_SOCKET
+    [NOI_SERVER]    = { L'-', L"server",    OPTARG_REQUIRED, false, NULL, },
+    [NOI_CLIENT]    = { L'-', L"client",    OPTARG_REQUIRED, false, NULL, },
+#endif
     [NOI_N]         = { L'\0', NULL, 0, false, NULL, },
 };
 
@@ -776,6 +797,16 @@ int set_normal_option(const struct xgetopt_T *opt, const wchar_t *arg,
 		assert(arg != NULL);
 		shell_invocation->rcfile = arg;
 		break;
+#if YASH_ENABLE_SOCKET
+	    case NOI_SERVER:
+		assert(arg != NULL);
+		shell_invocation->server = arg;
+		break;
+	    case NOI_CLIENT:
+		assert(arg != NULL);
+		shell_invocation->client = arg;
+		break;
+#endif
 	    case NOI_N:
 		assert(false);
 	}
@@ -857,6 +888,38 @@ wchar_t *get_hyphen_parameter(void)
     return wb_towcs(&buf);
 }
 
+/* Saves the values of all the shell options in a newly malloced array, which
+ * must be passed to `restore_shell_options'. */
+bool *save_shell_options(void)
+{
+    size_t count = 0;
+    while (shell_options[count].longopt != NULL)
+	count++;
+
+    bool *saved = xmallocn(count, sizeof *saved);
+    for (size_t i = 0; i < count; i++)
+	saved[i] = *shell_options[i].optp;
+    return saved;
+}
+
+/* Restores the values of the shell options saved by `save_shell_options' and
+ * frees `saved'. Options that cannot be changed by the "set" built-in are not
+ * restored. */
+void restore_shell_options(bool *saved)
+{
+    bool savejobcontrol = do_job_control;
+    for (size_t i = 0; shell_options[i].longopt != NULL; i++)
+	if (shell_options[i].resettable)
+	    *shell_options[i].optp = saved[i];
+    if (do_job_control != savejobcontrol)
+	reset_job_signals();
+#if YASH_ENABLE_LINEEDIT
+    update_lineedit_option();
+    update_le_convmeta_option();
+#endif
+    free(saved);
+}
+
 #if YASH_ENABLE_HELP
 
 /* Prints a list of all shell options to the standard output.
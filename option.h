@@ -41,9 +41,10 @@ extern _Bool is_interactive, is_interactive_now;
 extern _Bool shopt_cmdline, shopt_stdin;
 extern _Bool do_job_control, shopt_notify, shopt_notifyle,
        shopt_curasync, shopt_curbg, shopt_curstop;
-extern _Bool shopt_allexport, shopt_hashondef, shopt_forlocal;
-extern _Bool shopt_errexit, shopt_errreturn, shopt_pipefail, shopt_unset,
-       shopt_exec, shopt_ignoreeof, shopt_verbose, shopt_xtrace;
+extern _Bool shopt_allexport, shopt_hashondef, shopt_forlocal,
+       shopt_inlinesubshell, shopt_bytecode;
+extern _Bool shopt_errexit, shopt_errreturn, shopt_pipefail, shopt_lastpipe,
+       shopt_unset, shopt_exec, shopt_ignoreeof, shopt_verbose, shopt_xtrace;
 extern _Bool shopt_traceall;
 #if YASH_ENABLE_HISTORY
 extern _Bool shopt_histspace;
@@ -68,6 +69,9 @@ struct shell_invocation_T {
     _Bool help, version;
     _Bool noprofile, norcfile;
     const wchar_t *profile, *rcfile;
+#if YASH_ENABLE_SOCKET
+    const wchar_t *server, *client;
+#endif
     _Bool is_interactive_set, do_job_control_set, lineedit_set;
 };
 
@@ -79,6 +83,10 @@ extern void set_lineedit_option(enum shopt_lineedit_T v);
 #endif
 extern wchar_t *get_hyphen_parameter(void)
     __attribute__((malloc,warn_unused_result));
+extern _Bool *save_shell_options(void)
+    __attribute__((malloc,warn_unused_result));
+extern void restore_shell_options(_Bool *saved)
+    __attribute__((nonnull));
 #if YASH_ENABLE_TEST
 extern _Bool is_valid_option_name(const wchar_t *s)
     __attribute__((nonnull,pure));
@@ -34,6 +34,7 @@
 #include <wchar.h>
 #include <wctype.h>
 #include "alias.h"
+#include "exec.h"
 #include "expand.h"
 #include "input.h"
 #include "option.h"
@@ -50,7 +51,6 @@
 
 /********** Functions That Free Parse Trees **********/
 
-static void pipesfree(pipeline_T *p);
 static void ifcmdsfree(ifcommand_T *i);
 static void caseitemsfree(caseitem_T *i);
 #if YASH_ENABLE_DOUBLE_BRACKET
@@ -59,6 +59,8 @@ static void dbexpfree(dbexp_T *e);
 static void wordunitfree(wordunit_T *wu)
     __attribute__((nonnull));
 static void wordfree_vp(void *w);
+static void mbswordsfree(char **mbswords, void *const *words)
+    __attribute__((nonnull(2)));
 static void assignsfree(assign_T *a);
 static void redirsfree(redir_T *r);
 static void embedcmdfree(embedcmd_T c);
@@ -85,6 +87,25 @@ void pipesfree(pipeline_T *p)
     }
 }
 
+/* Duplicates the specified pipelines.
+ * Only the list of pipelines is copied; the commands are shared with the
+ * original (see `comsdup'), so the cost does not depend on their size. */
+pipeline_T *pipesdup(const pipeline_T *p)
+{
+    pipeline_T *first = NULL, **lastp = &first;
+
+    for (; p != NULL; p = p->next) {
+	pipeline_T *q = xmalloc(sizeof *q);
+	q->next = NULL;
+	q->pl_commands = comsdup(p->pl_commands);
+	q->pl_neg = p->pl_neg;
+	q->pl_cond = p->pl_cond;
+	*lastp = q;
+	lastp = &q->next;
+    }
+    return first;
+}
+
 void comsfree(command_T *c)
 {
     while (c != NULL) {
@@ -92,10 +113,13 @@ void comsfree(command_T *c)
 	    break;
 
 	redirsfree(c->c_redirs);
+	bytecodefree(c->c_code);
 	switch (c->c_type) {
 	    case CT_SIMPLE:
 		assignsfree(c->c_assigns);
+		mbswordsfree(c->c_mbswords, c->c_words);
 		plfree(c->c_words, wordfree_vp);
+		free(c->c_cmdcache);
 		break;
 	    case CT_GROUP:
 	    case CT_SUBSHELL:
@@ -126,6 +150,10 @@ void comsfree(command_T *c)
 		wordfree(c->c_funcname);
 		comsfree(c->c_funcbody);
 		break;
+	    case CT_COPROC:
+		free(c->c_coname);
+		comsfree(c->c_cocmd);
+		break;
 	}
 
 	command_T *next = c->next;
@@ -216,6 +244,16 @@ void wordfree_vp(void *w)
     wordfree((wordunit_T *) w);
 }
 
+/* Frees `c_mbswords' of a simple command whose `c_words' is `words'. */
+void mbswordsfree(char **mbswords, void *const *words)
+{
+    if (mbswords == NULL)
+	return;
+    for (size_t i = 0; words[i] != NULL; i++)
+	free(mbswords[i]);
+    free(mbswords);
+}
+
 void paramfree(paramexp_T *p)
 {
     if (p != NULL) {
@@ -300,7 +338,7 @@ typedef enum tokentype_T {
     /* reserved words */
     TT_IF, TT_THEN, TT_ELSE, TT_ELIF, TT_FI, TT_DO, TT_DONE, TT_CASE, TT_ESAC,
     TT_WHILE, TT_UNTIL, TT_FOR, TT_LBRACE, TT_RBRACE, TT_BANG, TT_IN,
-    TT_FUNCTION,
+    TT_FUNCTION, TT_COPROC,
 #if YASH_ENABLE_DOUBLE_BRACKET
     TT_DOUBLE_LBRACKET,
 #endif
@@ -392,14 +430,17 @@ bool is_name(const wchar_t *s)
 tokentype_T identify_reserved_word_string(const wchar_t *s)
 {
     /* List of keywords:
-     *    case do done elif else esac fi for function if in then until while
-     *    { } [[ !
+     *    case coproc do done elif else esac fi for function if in then until
+     *    while { } [[ !
      * The following words are currently not keywords:
      *    select ]] */
     switch (s[0]) {
 	case L'c':
 	    if (s[1] == L'a' && s[2] == L's' && s[3] == L'e' && s[4]== L'\0')
 		return TT_CASE;
+	    if (s[1] == L'o' && s[2] == L'p' && s[3] == L'r' && s[4] == L'o' &&
+		    s[5] == L'c' && s[6] == L'\0')
+		return TT_COPROC;
 	    break;
 	case L'd':
 	    if (s[1] == L'o') {
@@ -599,6 +640,8 @@ static wordunit_T *parse_paramexp_in_brace(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
 static wordunit_T *parse_cmdsubst_in_paren(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
+static bool is_file_read_command(const and_or_T *a)
+    __attribute__((pure,warn_unused_result));
 static embedcmd_T extract_command_in_paren(parsestate_T *ps)
     __attribute__((nonnull,warn_unused_result));
 static wchar_t *extract_command_in_paren_unparsed(parsestate_T *ps)
@@ -642,6 +685,12 @@ static command_T *parse_command(parsestate_T *ps)
 static void **parse_simple_command_tokens(
 	parsestate_T *ps, assign_T **assigns, redir_T **redirs)
     __attribute__((nonnull,malloc,warn_unused_result));
+static char **make_mbswords(void *const *words)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool is_literal_word(const wordunit_T *w)
+    __attribute__((nonnull,pure));
+static char *literal_word_mbs(const wordunit_T *w)
+    __attribute__((nonnull,malloc,warn_unused_result));
 static void **parse_words(parsestate_T *ps, bool skip_newlines)
     __attribute__((nonnull,malloc,warn_unused_result));
 static void parse_redirect_list(parsestate_T *ps, redir_T **lastp)
@@ -688,6 +737,10 @@ static command_T *parse_function(parsestate_T *ps)
     __attribute__((nonnull,malloc,warn_unused_result));
 static command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     __attribute__((nonnull,warn_unused_result));
+static command_T *parse_coproc(parsestate_T *ps)
+    __attribute__((nonnull,malloc,warn_unused_result));
+static bool is_compound_command_tokentype(tokentype_T tt)
+    __attribute__((const));
 
 static void read_heredoc_contents(parsestate_T *ps, redir_T *redir)
     __attribute__((nonnull));
@@ -1522,6 +1575,8 @@ end:;
 wordunit_T *parse_cmdsubst_in_paren(parsestate_T *ps)
 {
     embedcmd_T cmd = extract_command_in_paren(ps);
+    if (cmd.is_preparsed)
+	cmd.is_file_read = is_file_read_command(cmd.value.preparsed);
 
     maybe_line_continuations(ps, ps->index);
     if (ps->src.contents[ps->index] == L')')
@@ -1536,6 +1591,27 @@ wordunit_T *parse_cmdsubst_in_paren(parsestate_T *ps)
     return result;
 }
 
+/* Checks if the specified and-or list consists only of an input redirection
+ * from a file without a command word, as in "$(<file)". */
+bool is_file_read_command(const and_or_T *a)
+{
+    if (a == NULL || a->next != NULL || a->ao_async)
+	return false;
+
+    const pipeline_T *p = a->ao_pipelines;
+    if (p->next != NULL || p->pl_neg)
+	return false;
+
+    const command_T *c = p->pl_commands;
+    if (c->next != NULL || c->c_type != CT_SIMPLE
+	    || c->c_assigns != NULL || c->c_words[0] != NULL)
+	return false;
+
+    const redir_T *r = c->c_redirs;
+    return r != NULL && r->next == NULL
+	&& r->rd_type == RT_INPUT && r->rd_fd == STDIN_FILENO;
+}
+
 /* Extracts commands between '(' and ')'.
  * When this function is called, `ps->next_index' must be just after the opening
  * "(". When this function returns, the current token will be the closing ")".
@@ -1551,6 +1627,7 @@ embedcmd_T extract_command_in_paren(parsestate_T *ps)
     save_pending_heredocs = ps->pending_heredocs;
     pl_init(&ps->pending_heredocs);
 
+    result.is_file_read = false;
     if (posixly_correct && ps->info->enable_alias) {
 	result.is_preparsed = false;
 	result.value.unparsed = extract_command_in_paren_unparsed(ps);
@@ -1635,6 +1712,7 @@ end:;
     result->next = NULL;
     result->wu_type = WT_CMDSUB;
     result->wu_cmdsub.is_preparsed = false;
+    result->wu_cmdsub.is_file_read = false;
     result->wu_cmdsub.value.unparsed = wb_towcs(&buf);
     return result;
 }
@@ -2053,11 +2131,14 @@ command_T *parse_command(parsestate_T *ps)
     result->next = NULL;
     result->refcount = 1;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_type = CT_SIMPLE;
     result->c_assigns = NULL;
     result->c_redirs = NULL;
+    result->c_cmdcache = NULL;
     result->c_words = parse_simple_command_tokens(
 	    ps, &result->c_assigns, &result->c_redirs);
+    result->c_mbswords = make_mbswords(result->c_words);
 
     if (result->c_words[0] == NULL && result->c_assigns == NULL &&
 	    result->c_redirs == NULL) {
@@ -2121,6 +2202,58 @@ next:
     return pl_toary(&words);
 }
 
+/* Returns the multibyte forms of the literal words in `words' as described for
+ * `c_mbswords' in parser.h, or NULL if none of the words is literal. */
+char **make_mbswords(void *const *words)
+{
+    size_t count = plcount(words);
+    char **mbswords = NULL;
+    for (size_t i = 0; i < count; i++) {
+	char *mbs = literal_word_mbs(words[i]);
+	if (mbs == NULL)
+	    continue;
+	if (mbswords == NULL) {
+	    mbswords = xmallocn(count, sizeof *mbswords);
+	    for (size_t j = 0; j < count; j++)
+		mbswords[j] = NULL;
+	}
+	mbswords[i] = mbs;
+    }
+    return mbswords;
+}
+
+/* Checks if the specified word is literal as described for `c_mbswords' in
+ * parser.h. A bracket that is not closed (like the "[" command) is literal
+ * because it does not make the word a pathname expansion pattern. */
+bool is_literal_word(const wordunit_T *w)
+{
+    if (w->next != NULL || w->wu_type != WT_STRING)
+	return false;
+    const wchar_t *s = w->wu_string;
+    bool bracket = wcschr(s, L']') != NULL;
+    for (; *s != L'\0'; s++)
+	if ((unsigned long) *s >= 0x80 || wcschr(L"\\\'\"*?{~", *s) != NULL
+		|| (*s == L'[' && bracket))
+	    return false;
+    return true;
+}
+
+/* Returns the multibyte form of the specified word as a newly malloced string
+ * if the word is literal. Otherwise, returns NULL. */
+char *literal_word_mbs(const wordunit_T *w)
+{
+    if (!is_literal_word(w))
+	return NULL;
+
+    const wchar_t *s = w->wu_string;
+    size_t length = wcslen(s);
+    char *mbs = xmalloc(length + 1);
+    for (size_t i = 0; i < length; i++)
+	mbs[i] = (char) s[i];
+    mbs[length] = '\0';
+    return mbs;
+}
+
 /* Parses words.
  * The resultant words are returned as a newly-malloced NULL-terminated array of
  * pointers to word units that are cast to (void *).
@@ -2365,6 +2498,9 @@ command_T *parse_compound_command(parsestate_T *ps)
     case TT_FUNCTION:
 	result = parse_function(ps);
 	break;
+    case TT_COPROC:
+	result = parse_coproc(ps);
+	break;
     case TT_WHILE:
     case TT_UNTIL:
 	result = parse_while(ps);
@@ -2440,6 +2576,7 @@ command_T *parse_group(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = type;
     result->c_lineno = lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_subcmds = cmd;
     return result;
@@ -2457,6 +2594,7 @@ command_T *parse_if(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_IF;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_ifcmds = NULL;
 
@@ -2513,6 +2651,7 @@ command_T *parse_for(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_FOR;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
 
     result->c_forname =
@@ -2586,6 +2725,7 @@ command_T *parse_while(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_WHILE;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_whltype = whltype;
 
@@ -2625,6 +2765,7 @@ command_T *parse_case(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_CASE;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_casword = ps->token, ps->token = NULL;
     if (result->c_casword != NULL)
@@ -2752,6 +2893,7 @@ command_T *parse_double_bracket(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_BRACKET;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_dbexp = parse_double_bracket_ors(ps);
 
@@ -3048,6 +3190,7 @@ command_T *parse_function(parsestate_T *ps)
     result->refcount = 1;
     result->c_type = CT_FUNCDEF;
     result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
     result->c_redirs = NULL;
     result->c_funcname = ps->token, ps->token = NULL;
     if (result->c_funcname == NULL)
@@ -3127,6 +3270,7 @@ command_T *try_reparse_as_function(parsestate_T *ps, command_T *c)
     }
     next_token(ps);
 
+    mbswordsfree(c->c_mbswords, c->c_words);
     free(c->c_words);
     c->c_type = CT_FUNCDEF;
     c->c_funcname = name;
@@ -3143,6 +3287,74 @@ parse_function_body:
     return c;
 }
 
+/* Parses a coproc command.
+ * The current token must be "coproc". Never returns NULL. */
+command_T *parse_coproc(parsestate_T *ps)
+{
+    if (posixly_correct)
+	serror(ps, Ngt("`%ls' cannot be used as a command name"), L"coproc");
+
+    assert(ps->tokentype == TT_COPROC);
+    next_token(ps);
+
+    command_T *result = xmalloc(sizeof *result);
+    result->next = NULL;
+    result->refcount = 1;
+    result->c_type = CT_COPROC;
+    result->c_lineno = ps->info->lineno;
+    result->c_code = NULL;
+    result->c_redirs = NULL;
+    result->c_coname = NULL;
+
+    /* The first word is the name of the coprocess only if it is followed by a
+     * compound command. Otherwise, it is the first word of a simple command,
+     * so we rewind to re-parse it. */
+    if (ps->tokentype == TT_WORD && is_name_word(ps->token)) {
+	size_t saveindex = ps->index;
+	wordunit_T *name = ps->token;
+	ps->token = NULL;
+	next_token(ps);
+	if (is_compound_command_tokentype(ps->tokentype)) {
+	    result->c_coname = name->wu_string, name->wu_string = NULL;
+	} else {
+	    rewind_index(ps, saveindex);
+	    ps->next_index = ps->index;
+	    next_token(ps);
+	}
+	wordfree(name);
+    }
+
+    for (;;) {
+	result->c_cocmd = parse_command(ps);
+	if (!ps->reparse)
+	    break;
+	ps->reparse = false;
+    }
+
+    return result;
+}
+
+/* Returns true iff the specified token type starts a compound command that can
+ * follow the name of a coprocess. */
+bool is_compound_command_tokentype(tokentype_T tt)
+{
+    switch (tt) {
+	case TT_LPAREN:
+	case TT_LBRACE:
+	case TT_IF:
+	case TT_FOR:
+	case TT_WHILE:
+	case TT_UNTIL:
+	case TT_CASE:
+#if YASH_ENABLE_DOUBLE_BRACKET
+	case TT_DOUBLE_LBRACKET:
+#endif
+	    return true;
+	default:
+	    return false;
+    }
+}
+
 /***** Here-document contents *****/
 
 /* Reads the contents of a here-document. */
@@ -3405,6 +3617,10 @@ static void print_function_definition(
 	struct print *restrict pr, const command_T *restrict command,
 	unsigned indent)
     __attribute__((nonnull));
+static void print_coproc(
+	struct print *restrict pr, const command_T *restrict command,
+	unsigned indent)
+    __attribute__((nonnull));
 static void print_assignments(
 	struct print *restrict pr, const assign_T *restrict assigns,
 	unsigned indent)
@@ -3557,6 +3773,10 @@ void print_one_command(
 	    print_function_definition(pr, c, indent);
 	    assert(c->c_redirs == NULL);
 	    return;  // break;
+	case CT_COPROC:
+	    print_coproc(pr, c, indent);
+	    assert(c->c_redirs == NULL);
+	    return;  // break;
     }
     print_redirections(pr, c->c_redirs, indent);
 }
@@ -3806,6 +4026,19 @@ void print_function_definition(
     print_one_command(pr, c->c_funcbody, indent);
 }
 
+void print_coproc(
+	struct print *restrict pr, const command_T *restrict c, unsigned indent)
+{
+    assert(c->c_type == CT_COPROC);
+
+    wb_cat(&pr->buffer, L"coproc ");
+    if (c->c_coname != NULL) {
+	wb_cat(&pr->buffer, c->c_coname);
+	wb_wccat(&pr->buffer, L' ');
+    }
+    print_one_command(pr, c->c_cocmd, indent);
+}
+
 void print_assignments(
 	struct print *restrict pr, const assign_T *restrict a, unsigned indent)
 {
@@ -66,6 +66,7 @@ typedef enum {
     CT_BRACKET,    /* double-bracket command */
 #endif
     CT_FUNCDEF,    /* function definition */
+    CT_COPROC,     /* coprocess */
 } commandtype_T;
 
 /* command in a pipeline */
@@ -75,10 +76,13 @@ typedef struct command_T {
     commandtype_T     c_type;
     unsigned long     c_lineno;   /* line number */
     struct redir_T   *c_redirs;   /* redirections */
+    struct bytecode_T *c_code;    /* compiled code (see exec.c) */
     union {
 	struct {
 	    struct assign_T *assigns;  /* assignments */
 	    void           **words;    /* command name and arguments */
+	    char           **mbswords; /* multibyte forms of literal words */
+	    struct cmdcache_T *cache;  /* cached result of command search */
 	} simplecommand;
 	struct and_or_T     *subcmds;  /* contents of command group */
 	struct ifcommand_T  *ifcmds;   /* contents of if command */
@@ -101,10 +105,16 @@ typedef struct command_T {
 	    struct wordunit_T *funcname;  /* name of function */
 	    struct command_T  *funcbody;  /* body of function */
 	} funcdef;
+	struct {
+	    wchar_t           *coname;    /* name of coprocess variable */
+	    struct command_T  *cocmd;     /* command run in coprocess */
+	} coproc;
     } c_content;
 } command_T;
 #define c_assigns  c_content.simplecommand.assigns
 #define c_words    c_content.simplecommand.words
+#define c_mbswords c_content.simplecommand.mbswords
+#define c_cmdcache c_content.simplecommand.cache
 #define c_subcmds  c_content.subcmds
 #define c_ifcmds   c_content.ifcmds
 #define c_forname  c_content.forloop.forname
@@ -118,10 +128,19 @@ typedef struct command_T {
 #define c_dbexp    c_content.dbexp
 #define c_funcname c_content.funcdef.funcname
 #define c_funcbody c_content.funcdef.funcbody
+#define c_coname   c_content.coproc.coname
+#define c_cocmd    c_content.coproc.cocmd
 /* `c_words' and `c_forwords' are NULL-terminated arrays of pointers to
  * `wordunit_T' that are cast to `void *'.
+ * `c_mbswords' is NULL if none of `c_words' is literal. Otherwise, it is an
+ * array that has as many elements as `c_words' (excluding the terminating
+ * NULL), each of which is the multibyte form of the corresponding word if it is
+ * literal or NULL otherwise. A literal word consists of a single WT_STRING unit
+ * of ASCII characters that are not subject to any expansion or quote removal,
+ * so the word expands to itself in any (ASCII-compatible) locale.
  * If `c_forwords' is NULL, the for loop doesn't have the "in" clause.
- * If `c_forwords[0]' is NULL, the "in" clause exists and is empty. */
+ * If `c_forwords[0]' is NULL, the "in" clause exists and is empty.
+ * If `c_coname' is NULL, the default name "COPROC" is used. */
 
 /* condition and commands of an if command */
 typedef struct ifcommand_T {
@@ -167,12 +186,15 @@ typedef struct dbexp_T {
 
 /* embedded command */
 typedef struct embedcmd_T {
-    _Bool is_preparsed;
+    _Bool is_preparsed, is_file_read;
     union {
 	wchar_t         *unparsed;
 	struct and_or_T *preparsed;
     } value;
 } embedcmd_T;
+/* `is_file_read' is true if the command substitution is of the form
+ * "$(<file)", in which case `preparsed' contains a simple command that consists
+ * only of the input redirection. */
 
 /* type of wordunit_T */
 typedef enum {
@@ -380,7 +402,12 @@ extern wchar_t *command_to_wcs(const command_T *command, _Bool multiline)
 /********** Functions That Free/Duplicate Parse Trees **********/
 
 extern void andorsfree(and_or_T *a);
+extern void pipesfree(pipeline_T *p);
+extern pipeline_T *pipesdup(const pipeline_T *p)
+    __attribute__((malloc,warn_unused_result));
 static inline command_T *comsdup(command_T *c);
+static inline _Bool is_literal_command_word(const command_T *c, size_t index)
+    __attribute__((nonnull,pure));
 extern void comsfree(command_T *c);
 extern void wordfree(wordunit_T *w);
 extern void paramfree(paramexp_T *p);
@@ -393,6 +420,13 @@ command_T *comsdup(command_T *c)
     return c;
 }
 
+/* Checks if the `index'th word of the specified simple command is literal (see
+ * `c_mbswords'). `index' must be less than the number of the words. */
+_Bool is_literal_command_word(const command_T *c, size_t index)
+{
+    return c->c_mbswords != NULL && c->c_mbswords[index] != NULL;
+}
+
 
 #endif /* YASH_PARSER_H */
 
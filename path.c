@@ -379,6 +379,7 @@ void init_cmdhash(void)
 void clear_cmdhash(void)
 {
     ht_clear(&cmdhash, vfree);
+    cmdsearch_generation++;
 }
 
 /* Searches PATH for the specified command and returns its full pathname.
@@ -412,6 +413,7 @@ const char *get_command_path(const char *name, bool forcelookup)
 void forget_command_path(const char *command)
 {
     vfree(ht_remove(&cmdhash, command));
+    cmdsearch_generation++;
 }
 
 /* Last result of `get_command_path_default'. */
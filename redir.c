@@ -39,6 +39,16 @@
 #endif
 #include <sys/stat.h>
 #include <unistd.h>
+#if HAVE_CLOSE_RANGE
+# ifndef close_range
+extern int close_range(unsigned int fd, unsigned int maxfd, int flags);
+# endif
+#endif
+#if HAVE_F_SETPIPE_SZ
+# ifndef F_SETPIPE_SZ
+#  define F_SETPIPE_SZ 1031  /* the value in Linux */
+# endif
+#endif
 #include "exec.h"
 #include "expand.h"
 #include "input.h"
@@ -48,6 +58,7 @@
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
+#include "variable.h"
 #include "yash.h"
 
 
@@ -60,6 +71,9 @@
  * printed. */
 int xclose(int fd)
 {
+#if HAVE_SIGNALFD
+    unwatch_sigfd_input(fd);
+#endif
     while (close(fd) < 0) {
 	switch (errno) {
 	case EINTR:
@@ -111,15 +125,38 @@ bool write_all(int fd, const void *data, size_t size)
     return true;
 }
 
+/* Changes the capacity of the pipe whose writing end is `fd' to the value of
+ * $YASH_PIPE_SIZE if it is a positive integer. The kernel may round up the
+ * capacity. Errors are ignored since the pipe is usable anyway. */
+void apply_pipe_size(int fd)
+{
+#if HAVE_F_SETPIPE_SZ
+    const wchar_t *value = getvar(L VAR_YASH_PIPE_SIZE);
+    int size;
+    if (value != NULL && xwcstoi(value, 10, &size) && size > 0)
+	fcntl(fd, F_SETPIPE_SZ, size);
+#endif
+}
+
 
 /********** Shell FDs **********/
 
 static void reset_shellfdmin(void);
+static inline bool shellfds_contain(int fd)
+    __attribute__((pure));
+static int find_shellfd(int fd, bool member)
+    __attribute__((pure));
+static void close_fd_range(int minfd, int maxfd);
 
 
-/* Set of file descriptors used by the shell.
- * These file descriptors cannot be used by the user. */
-static fd_set shellfds;
+/* number of bits in an element of `shellfds' */
+#define SHELLFDS_BITS (CHAR_BIT * sizeof (unsigned long))
+
+/* Bitmap of file descriptors used by the shell.
+ * These file descriptors cannot be used by the user.
+ * File descriptor `fd' is in the set iff the `fd % SHELLFDS_BITS'th bit of
+ * `shellfds[fd / SHELLFDS_BITS]' is set. */
+static unsigned long shellfds[(FD_SETSIZE + SHELLFDS_BITS - 1) / SHELLFDS_BITS];
 /* The minimum file descriptor that can be used for shell FD. */
 static int shellfdmin;
 /* The maximum file descriptor in `shellfds'.
@@ -146,7 +183,7 @@ void init_shellfds(void)
     initialized = true;
 #endif
 
-    FD_ZERO(&shellfds);
+    memset(shellfds, 0, sizeof shellfds);
     reset_shellfdmin();
     assert(shellfdmax == -1);  // shellfdmax = -1;
 }
@@ -172,46 +209,91 @@ void reset_shellfdmin(void)
     }
 }
 
+/* Checks if `fd' (0 <= fd < FD_SETSIZE) is in `shellfds'. */
+bool shellfds_contain(int fd)
+{
+    return (shellfds[fd / SHELLFDS_BITS] >> (fd % SHELLFDS_BITS)) & 1;
+}
+
 /* Adds the specified file descriptor (>= `shellfdmin') to `shellfds'. */
 void add_shellfd(int fd)
 {
     assert(fd >= shellfdmin);
     if (fd < FD_SETSIZE)
-	FD_SET(fd, &shellfds);
+	shellfds[fd / SHELLFDS_BITS] |= 1UL << (fd % SHELLFDS_BITS);
     if (shellfdmax < fd)
 	shellfdmax = fd;
 }
 
-/* Removes the specified file descriptor from `shellfds'.
- * Must be called BEFORE `xclose(fd)'. */
+/* Removes the specified file descriptor from `shellfds'. */
 void remove_shellfd(int fd)
 {
     if (0 <= fd && fd < FD_SETSIZE)
-	FD_CLR(fd, &shellfds);
+	shellfds[fd / SHELLFDS_BITS] &= ~(1UL << (fd % SHELLFDS_BITS));
     if (fd == shellfdmax) {
 	do
 	    shellfdmax--;
-	while (shellfdmax >= 0 && !FD_ISSET(shellfdmax, &shellfds));
+	while (shellfdmax >= 0 && !is_shellfd(shellfdmax));
     }
 }
-/* The argument to `FD_CLR' must be a valid (open) file descriptor. This is why
- * `remove_shellfd' must be called before closing the file descriptor. */
 
 /* Checks if the specified file descriptor is in `shellfds'. */
 bool is_shellfd(int fd)
 {
-    return fd >= FD_SETSIZE || (fd >= 0 && FD_ISSET(fd, &shellfds));
+    return fd >= FD_SETSIZE || (fd >= 0 && shellfds_contain(fd));
+}
+
+/* Returns the least file descriptor not less than `fd' that is in `shellfds'
+ * (if `member' is true) or not in `shellfds' (if `member' is false).
+ * Whole words of the bitmap are skipped at a time.
+ * If `member' is true and there is no such file descriptor, -1 is returned. */
+int find_shellfd(int fd, bool member)
+{
+    int maxfd = (shellfdmax < FD_SETSIZE) ? shellfdmax : FD_SETSIZE - 1;
+    while (fd <= maxfd) {
+	unsigned long word = shellfds[fd / SHELLFDS_BITS];
+	if (!member)
+	    word = ~word;
+	word >>= fd % SHELLFDS_BITS;
+	if (word == 0) {
+	    fd = (fd / SHELLFDS_BITS + 1) * SHELLFDS_BITS;
+	    continue;
+	}
+	while (!(word & 1)) {
+	    word >>= 1;
+	    fd++;
+	}
+	return fd;
+    }
+    return member ? -1 : fd;
+}
+
+/* Closes the file descriptors from `minfd' to `maxfd' (inclusive). */
+void close_fd_range(int minfd, int maxfd)
+{
+#if HAVE_CLOSE_RANGE
+    /* The OS kernel may not support `close_range' even if the C library
+     * does. */
+    if (close_range(minfd, maxfd, 0) == 0)
+	return;
+#endif
+    for (int fd = minfd; fd <= maxfd; fd++)
+	xclose(fd);
 }
 
 /* Clears `shellfds'.
- * If `leavefds' is false, the file descriptors in `shellfds' are closed. */
+ * If `leavefds' is false, the file descriptors in `shellfds' are closed.
+ * Consecutive file descriptors are closed at once by `close_fd_range'. */
 void clear_shellfds(bool leavefds)
 {
     if (!leavefds) {
-	for (int fd = 0; fd <= shellfdmax; fd++)
-	    if (FD_ISSET(fd, &shellfds))
-		xclose(fd);
-	FD_ZERO(&shellfds);
+	int fd = 0;
+	while ((fd = find_shellfd(fd, true)) >= 0) {
+	    int end = find_shellfd(fd, false);
+	    close_fd_range(fd, end - 1);
+	    fd = end;
+	}
+	memset(shellfds, 0, sizeof shellfds);
 	shellfdmax = -1;
     }
     ttyfd = -1;
@@ -808,6 +890,29 @@ int open_herestring(char *s, bool appendnewline)
     }
 #endif /* defined(PIPE_BUF) */
 
+#if HAVE_F_SETPIPE_SZ
+    /* use a pipe if it can be enlarged to hold the whole contents */
+    if (len <= INT_MAX) {
+	int pipefd[2];
+
+	if (pipe(pipefd) >= 0) {
+	    int size = fcntl(pipefd[PIPE_OUT], F_SETPIPE_SZ, (int) len);
+	    if (size >= 0 && (size_t) size >= len) {
+		/* The pipe is empty and large enough, so writing never
+		 * blocks. */
+		if (!write_all(pipefd[PIPE_OUT], s, len))
+		    xerror(errno, Ngt("cannot write the here-document "
+				"contents to the temporary file"));
+		xclose(pipefd[PIPE_OUT]);
+		free(s);
+		return pipefd[PIPE_IN];
+	    }
+	    xclose(pipefd[PIPE_IN]);
+	    xclose(pipefd[PIPE_OUT]);
+	}
+    }
+#endif /* HAVE_F_SETPIPE_SZ */
+
     char *tempfile;
     fd = create_temporary_file(&tempfile, "", 0);
     if (fd < 0) {
@@ -829,6 +934,75 @@ int open_herestring(char *s, bool appendnewline)
     return fd;
 }
 
+/* Expands the filename of the specified RT_INPUT redirection and opens the file
+ * for reading without redirecting any FD. This is used for "$(<file)".
+ * Returns a new FD if successful. Otherwise, an error message is printed and -1
+ * is returned. */
+int open_input_redirection_file(const redir_T *r)
+{
+    assert(r->rd_type == RT_INPUT);
+
+    char *filename = expand_redir_filename(r->rd_filename);
+    if (filename == NULL)
+	return -1;
+
+    int fd = open_file(filename, O_RDONLY);
+    if (fd < 0)
+	xerror(errno, Ngt("redirection: cannot open file `%s'"), filename);
+    free(filename);
+    return fd;
+}
+
+/* Redirects the standard output to a new anonymous temporary file so that the
+ * output of commands executed in the shell process can be read back.
+ * The original standard output is saved and a pointer to the restoration info
+ * is assigned to `*save'.
+ * Returns a shell FD open for the temporary file if successful. On error, -1 is
+ * returned without an error message and the standard output is not changed. */
+int redirect_stdout_to_temporary_file(savefd_T **save)
+{
+    *save = NULL;
+
+    char *tempfile;
+    int fd = create_temporary_file(&tempfile, "", 0);
+    if (fd < 0)
+	return -1;
+    unlink(tempfile);
+    free(tempfile);
+
+    fd = move_to_shellfd(fd);
+    if (fd < 0)
+	return -1;
+
+    save_fd(STDOUT_FILENO, save);
+#if HAVE_SIGNALFD
+    unwatch_sigfd_input(STDOUT_FILENO);
+#endif
+    if (dup2(fd, STDOUT_FILENO) < 0) {
+	undo_redirections(*save);
+	*save = NULL;
+	remove_shellfd(fd);
+	xclose(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/* Redirects the standard input to the reading end of a pipe so that the last
+ * command of a pipeline can be executed in the shell process.
+ * `fd' is closed in this function. If `fd' is negative, the standard input is
+ * not changed. The original standard input is saved and a pointer to the
+ * restoration info is assigned to `*save'. */
+void redirect_stdin_from_pipe(int fd, savefd_T **save)
+{
+    *save = NULL;
+    if (fd >= 0) {
+	save_fd(STDIN_FILENO, save);
+	xdup2(fd, STDIN_FILENO);
+	xclose(fd);
+    }
+}
+
 /* Opens process redirection and returns the file descriptor.
  * `type' must be RT_PROCIN or RT_PROCOUT.
  * The return value is -1 if failed. */
@@ -26,6 +26,7 @@ extern int xclose(int fd);
 extern int xdup2(int oldfd, int newfd);
 extern _Bool write_all(int fd, const void *data, size_t size)
     __attribute__((nonnull));
+extern void apply_pipe_size(int fd);
 
 extern int ttyfd;
 
@@ -47,6 +48,12 @@ extern _Bool open_redirections(const struct redir_T *r, savefd_T **save)
 extern void undo_redirections(savefd_T *save);
 extern void clear_savefd(savefd_T *save);
 extern void maybe_redirect_stdin_to_devnull(void);
+extern int open_input_redirection_file(const struct redir_T *r)
+    __attribute__((nonnull));
+extern int redirect_stdout_to_temporary_file(savefd_T **save)
+    __attribute__((nonnull,warn_unused_result));
+extern void redirect_stdin_from_pipe(int fd, savefd_T **save)
+    __attribute__((nonnull));
 
 #define PIPE_IN  0   /* index of the reading end of a pipe */
 #define PIPE_OUT 1   /* index of the writing end of a pipe */
@@ -0,0 +1,636 @@
+/* Yash: yet another shell */
+/* server.c: pre-initialized shell server and its client */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include "common.h"
+#include "server.h"
+#include <errno.h>
+#include <fcntl.h>
+#if HAVE_GETTEXT
+# include <libintl.h>
+#endif
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "exec.h"
+#include "job.h"
+#include "path.h"
+#include "plist.h"
+#include "redir.h"
+#include "sig.h"
+#include "strbuf.h"
+#include "util.h"
+#include "variable.h"
+#include "yash.h"
+
+
+/* About the server mode:
+ *
+ * A shell invoked with the --server option initializes itself and listens on
+ * a Unix-domain socket. For each connection, the server forks a child process
+ * that receives a request from the client and then continues as if it were a
+ * shell newly invoked with the request's arguments. This saves the cost of
+ * the initialization, which is already done in the server.
+ *
+ * A shell invoked with the --client option connects to the server and sends a
+ * request, which consists of a `request_T' header passed together with the
+ * client's standard input, output, and error (by SCM_RIGHTS), followed by the
+ * strings described in `request_T'.
+ * The server replies with the process ID of the child (a `pid_t') and, when
+ * the child has finished, its status as returned by `waitpid' (an `int').
+ * The child is made a process group leader so that the client can forward
+ * signals to it and its descendants. */
+
+/* The header of a request. */
+struct request_T {
+    unsigned fdmask; /* set of the file descriptors 0-2 passed with the header */
+    mode_t umask;
+    size_t argc, envc;
+    size_t size;     /* total size of the strings following the header */
+};
+/* The strings are null-terminated and in the following order: the working
+ * directory, `argc' command line arguments, and `envc' environment variables
+ * in the "name=value" form. */
+
+/* A connection from a client being served. */
+struct session_T {
+    int fd;            /* socket connected to the client */
+    size_t jobnumber;  /* job number of the child serving the client */
+};
+
+static int open_server_socket(const struct sockaddr_un *addr)
+    __attribute__((nonnull));
+static bool start_session(int listenfd, plist_T *sessions, pid_t *pidp)
+    __attribute__((nonnull));
+static void finish_sessions(plist_T *sessions)
+    __attribute__((nonnull));
+static bool receive_request(int fd, int *argcp, char ***argvp)
+    __attribute__((nonnull));
+static bool install_client_fds(unsigned fdmask, const int fds[], size_t nfds)
+    __attribute__((nonnull));
+static void import_client_environment(char *const *envp)
+    __attribute__((nonnull));
+static int connect_to_server(const wchar_t *path)
+    __attribute__((nonnull));
+static bool send_request(int fd, char **argv)
+    __attribute__((nonnull));
+static void forward_signal(int signum);
+static int client_exit_status(int status);
+static bool read_all(int fd, void *buf, size_t size)
+    __attribute__((nonnull));
+static bool make_sockaddr(const wchar_t *path, struct sockaddr_un *addr)
+    __attribute__((nonnull));
+
+/* The process group ID of the child serving the client.
+ * Used in the client only. */
+static volatile pid_t server_child_pgid;
+
+/* The signals the client forwards to the server's child. */
+static const int forwarded_signals[] = { SIGHUP, SIGINT, SIGQUIT, SIGTERM, };
+
+
+/********** Server **********/
+
+/* Runs the server that listens on the socket at `path'.
+ * This function returns only in a child process that has received a request
+ * from a client, in which case true is returned and the arguments of the
+ * request are assigned to `*argcp' and `*argvp'. If the server cannot be
+ * started, an error message is printed and false is returned. */
+bool serve(const wchar_t *path, int *argcp, char ***argvp)
+{
+    struct sockaddr_un addr;
+    if (!make_sockaddr(path, &addr))
+	return false;
+
+    int listenfd = open_server_socket(&addr);
+    if (listenfd < 0)
+	return false;
+
+    plist_T sessions;
+    pl_init(&sessions);
+    for (;;) {
+	switch (wait_for_input_or_sigchld(listenfd, true)) {
+	    case W_READY:
+		break;
+	    case W_TIMED_OUT:
+	    case W_INTERRUPTED:
+	    case W_CHILD:
+		finish_sessions(&sessions);
+		continue;
+	    case W_ERROR:
+		return false;
+	}
+
+	pid_t pid;
+	if (!start_session(listenfd, &sessions, &pid))
+	    continue;
+	if (pid == 0) {
+	    /* child process */
+	    const struct session_T *s = sessions.contents[sessions.length - 1];
+	    int fd = s->fd;
+	    xclose(listenfd);
+	    for (size_t i = 0; i < sessions.length - 1; i++)
+		xclose(((struct session_T *) sessions.contents[i])->fd);
+	    plfree(pl_toary(&sessions), free);
+	    remove_all_jobs();
+#if HAVE_SIGNALFD
+	    close_sigfd();
+#endif
+
+	    bool ok = receive_request(fd, argcp, argvp);
+	    xclose(fd);
+	    if (!ok)
+		exit(Exit_FAILURE);
+	    return true;
+	}
+    }
+}
+
+/* Creates a socket listening on the specified address.
+ * An existing socket file at the path is replaced.
+ * The socket file is made accessible only to the owner.
+ * Returns the file descriptor of the socket or -1 on error. */
+int open_server_socket(const struct sockaddr_un *addr)
+{
+    const char *path = addr->sun_path;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	xerror(errno, Ngt("cannot create a socket"));
+	return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    struct stat st;
+    if (lstat(path, &st) >= 0 && S_ISSOCK(st.st_mode))
+	unlink(path);
+
+    mode_t savemask = umask(S_IRWXG | S_IRWXO);
+    int result = bind(fd, (const struct sockaddr *) addr, sizeof *addr);
+    umask(savemask);
+    if (result < 0 || listen(fd, SOMAXCONN) < 0) {
+	xerror(errno, Ngt("cannot listen on socket `%s'"), path);
+	xclose(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/* Accepts a connection and forks a child process to serve it.
+ * The connection is added to `sessions' and the child is registered as a job.
+ * The child's process ID is assigned to `*pidp' (0 in the child).
+ * Returns false if no connection was accepted. */
+bool start_session(int listenfd, plist_T *sessions, pid_t *pidp)
+{
+    int fd = accept(listenfd, NULL, NULL);
+    if (fd < 0) {
+	if (errno != EINTR && errno != ECONNABORTED)
+	    xerror(errno, Ngt("cannot accept a connection"));
+	return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    struct session_T *s = xmalloc(sizeof *s);
+    s->fd = fd;
+    pl_add(sessions, s);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+	xerror(errno, Ngt("cannot make a child process"));
+	goto fail;
+    }
+    if (pid == 0) {
+	/* child process */
+	setpgid(0, 0);
+	shell_pid = shell_pgid = getpid();
+	*pidp = 0;
+	return true;
+    }
+
+    /* parent process */
+    /* If the client has gone away, the child fails to read the request. */
+    setpgid(pid, pid);
+    send(fd, &pid, sizeof pid, MSG_NOSIGNAL);
+
+    job_T *job = xmallocs(sizeof *job, 1, sizeof *job->j_procs);
+    process_T *p = &job->j_procs[0];
+    p->pr_pid = pid;
+    p->pr_status = JS_RUNNING;
+    p->pr_statuscode = 0;
+    p->pr_name = xwcsdup(L"");
+    p->pr_command = NULL;
+    p->pr_pipelines = NULL;
+    job->j_pgid = 0;
+    job->j_status = JS_RUNNING;
+    job->j_statuschanged = false;
+    job->j_legacy = false;
+    job->j_nonotify = true;
+    job->j_pcount = 1;
+    set_active_job(job);
+    s->jobnumber = add_job(false);
+    *pidp = pid;
+    return true;
+
+fail:
+    pl_remove(sessions, sessions->length - 1, 1);
+    free(s);
+    xclose(fd);
+    return false;
+}
+
+/* Sends the exit status to the clients whose child processes have finished
+ * and closes their connections. */
+void finish_sessions(plist_T *sessions)
+{
+    for (size_t i = 0; i < sessions->length; ) {
+	struct session_T *s = sessions->contents[i];
+	job_T *job = get_job(s->jobnumber);
+	if (job->j_status != JS_DONE) {
+	    i++;
+	    continue;
+	}
+
+	int status = job->j_procs[0].pr_statuscode;
+	send(s->fd, &status, sizeof status, MSG_NOSIGNAL);
+	xclose(s->fd);
+	remove_job(s->jobnumber);
+	free(s);
+	pl_remove(sessions, i, 1);
+    }
+}
+
+/* Receives a request from the client and prepares the current process to run
+ * as specified by the request.
+ * The standard input, output, and error are replaced with those of the client,
+ * and the working directory, umask, and environment variables are taken from
+ * the request. The command line arguments are assigned to `*argcp' and
+ * `*argvp'.
+ * Returns false if the request could not be received or applied. */
+bool receive_request(int fd, int *argcp, char ***argvp)
+{
+    struct request_T req;
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof (int))];
+    } control;
+    struct iovec iov = { .iov_base = &req, .iov_len = sizeof req, };
+    struct msghdr msg = {
+	.msg_name = NULL, .msg_namelen = 0,
+	.msg_iov = &iov, .msg_iovlen = 1,
+	.msg_control = control.buf, .msg_controllen = sizeof control.buf,
+	.msg_flags = 0,
+    };
+
+    ssize_t n;
+    do
+	n = recvmsg(fd, &msg, 0);
+    while (n < 0 && errno == EINTR);
+    if (n != (ssize_t) sizeof req) {
+	xerror(n < 0 ? errno : 0, Ngt("cannot receive a request"));
+	return false;
+    }
+
+    int fds[3];
+    size_t nfds = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+	    c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+	if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+	    continue;
+	size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof (int);
+	if (count > 3 - nfds)
+	    count = 3 - nfds;
+	memcpy(&fds[nfds], CMSG_DATA(c), count * sizeof (int));
+	nfds += count;
+    }
+    if (!install_client_fds(req.fdmask, fds, nfds))
+	return false;
+
+    char *strings = xmalloc(req.size);
+    if (req.size == 0 || !read_all(fd, strings, req.size)
+	    || strings[req.size - 1] != '\0') {
+	xerror(0, Ngt("cannot receive a request"));
+	return false;
+    }
+
+    /* split the strings */
+    char **ss = xmallocn(add(add(req.argc, req.envc), 3), sizeof *ss);
+    char *s = strings, *end = &strings[req.size];
+    for (size_t i = 0; i < 1 + req.argc + req.envc; i++) {
+	if (s == end) {
+	    xerror(0, Ngt("cannot receive a request"));
+	    return false;
+	}
+	ss[i] = s;
+	s += strlen(s) + 1;
+    }
+    char **argv = &ss[1], **envp = &ss[1 + req.argc + 1];
+    memmove(envp, &argv[req.argc], req.envc * sizeof *envp);
+    argv[req.argc] = NULL;
+    envp[req.envc] = NULL;
+
+    if (chdir(ss[0]) < 0) {
+	xerror(errno, Ngt("cannot change the working directory to `%s'"),
+		ss[0]);
+	return false;
+    }
+    umask(req.umask);
+    import_client_environment(envp);
+
+    *argcp = (int) req.argc;
+    *argvp = argv;
+    return true;
+}
+
+/* Replaces the standard input, output, and error with the file descriptors
+ * received from the client. `fdmask' specifies which of the standard file
+ * descriptors are sent from the client. Those not sent are closed.
+ * The received file descriptors are closed after being duplicated. */
+bool install_client_fds(unsigned fdmask, const int fds[], size_t nfds)
+{
+    int newfds[3];
+    size_t n = 0;
+
+    /* move the received FDs out of the range 0-2 to avoid clobbering */
+    for (size_t i = 0; i < nfds; i++) {
+	newfds[i] = fds[i];
+	if (newfds[i] < 3)
+	    newfds[i] = fcntl(newfds[i], F_DUPFD, 3);
+    }
+
+    bool ok = true;
+    for (int i = 0; i < 3; i++) {
+	if (fdmask & (1u << i)) {
+	    if (n < nfds && newfds[n] >= 0)
+		xdup2(newfds[n], i);
+	    else
+		ok = false;
+	    n++;
+	} else {
+	    close(i);
+	}
+    }
+    for (size_t i = 0; i < nfds; i++)
+	if (newfds[i] >= 0)
+	    xclose(newfds[i]);
+
+    if (!ok)
+	xerror(0, Ngt("cannot receive a request"));
+    return ok;
+}
+
+/* Assigns and exports the specified environment variables.
+ * Strings that cannot be converted or that contain no '=' are ignored. */
+void import_client_environment(char *const *envp)
+{
+    for (; *envp != NULL; envp++) {
+	wchar_t *name = malloc_mbstowcs(*envp);
+	if (name == NULL)
+	    continue;
+
+	wchar_t *eqp = wcschr(name, L'=');
+	if (eqp != NULL) {
+	    *eqp = L'\0';
+	    set_variable(name, xwcsdup(&eqp[1]), SCOPE_GLOBAL, true);
+	}
+	free(name);
+    }
+}
+
+
+/********** Client **********/
+
+/* Runs the client that sends the arguments in `argv' to the server listening
+ * on the socket at `path' and waits for the server to run them.
+ * The signals in `forwarded_signals' are forwarded to the server's child.
+ * Returns the exit status of the server's child. If the child was killed by a
+ * signal, the client kills itself with the same signal. */
+int run_client(const wchar_t *path, char **argv)
+{
+    int fd = connect_to_server(path);
+    if (fd < 0)
+	return Exit_FAILURE;
+
+    if (!send_request(fd, argv)) {
+	xclose(fd);
+	return Exit_FAILURE;
+    }
+
+    pid_t pid;
+    if (!read_all(fd, &pid, sizeof pid)) {
+	xerror(errno, Ngt("the server closed the connection"));
+	xclose(fd);
+	return Exit_FAILURE;
+    }
+    server_child_pgid = pid;
+
+    struct sigaction action;
+    action.sa_handler = forward_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigset_t ss;
+    sigemptyset(&ss);
+    for (size_t i = 0; i < sizeof forwarded_signals / sizeof *forwarded_signals;
+	    i++) {
+	sigaction(forwarded_signals[i], &action, NULL);
+	sigaddset(&ss, forwarded_signals[i]);
+    }
+    sigprocmask(SIG_UNBLOCK, &ss, NULL);
+
+    int status;
+    bool ok = read_all(fd, &status, sizeof status);
+    int saveerrno = errno;
+    xclose(fd);
+    if (!ok) {
+	xerror(saveerrno, Ngt("the server closed the connection"));
+	return Exit_FAILURE;
+    }
+    return client_exit_status(status);
+}
+
+/* Connects to the server listening on the socket at `path'.
+ * Returns the file descriptor of the socket or -1 on error. */
+int connect_to_server(const wchar_t *path)
+{
+    struct sockaddr_un addr;
+    if (!make_sockaddr(path, &addr))
+	return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	xerror(errno, Ngt("cannot create a socket"));
+	return -1;
+    }
+    if (connect(fd, (struct sockaddr *) &addr, sizeof addr) < 0) {
+	xerror(errno, Ngt("cannot connect to socket `%s'"), addr.sun_path);
+	xclose(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/* Sends a request containing the standard input, output, and error, the
+ * working directory, umask, environment variables, and the specified arguments
+ * of the current process.
+ * Returns true iff successful. */
+bool send_request(int fd, char **argv)
+{
+    char *cwd = xgetcwd();
+    if (cwd == NULL) {
+	xerror(errno, Ngt("cannot get the current working directory"));
+	return false;
+    }
+
+    struct request_T req = { .fdmask = 0, .argc = 0, .envc = 0, };
+    xstrbuf_T strings;
+    sb_init(&strings);
+    sb_ncat_force(&strings, cwd, strlen(cwd) + 1);
+    free(cwd);
+    for (char **a = argv; *a != NULL; a++, req.argc++)
+	sb_ncat_force(&strings, *a, strlen(*a) + 1);
+    for (char **e = environ; *e != NULL; e++, req.envc++)
+	sb_ncat_force(&strings, *e, strlen(*e) + 1);
+    req.size = strings.length;
+    req.umask = umask(0);
+    umask(req.umask);
+
+    int fds[3];
+    size_t nfds = 0;
+    for (int i = 0; i < 3; i++) {
+	if (fcntl(i, F_GETFD) >= 0) {
+	    req.fdmask |= 1u << i;
+	    fds[nfds++] = i;
+	}
+    }
+
+    union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE(3 * sizeof (int))];
+    } control;
+    memset(&control, 0, sizeof control);
+    struct iovec iov = { .iov_base = &req, .iov_len = sizeof req, };
+    struct msghdr msg = {
+	.msg_name = NULL, .msg_namelen = 0,
+	.msg_iov = &iov, .msg_iovlen = 1,
+	.msg_control = nfds > 0 ? control.buf : NULL,
+	.msg_controllen = nfds > 0 ? CMSG_SPACE(nfds * sizeof (int)) : 0,
+	.msg_flags = 0,
+    };
+    if (nfds > 0) {
+	struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(nfds * sizeof (int));
+	memcpy(CMSG_DATA(c), fds, nfds * sizeof (int));
+    }
+
+    bool ok = sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t) sizeof req
+	&& write_all(fd, strings.contents, strings.length);
+    if (!ok)
+	xerror(errno, Ngt("cannot send a request"));
+    sb_destroy(&strings);
+    return ok;
+}
+
+/* Sends the signal to the process group of the server's child. */
+void forward_signal(int signum)
+{
+    if (server_child_pgid > 0)
+	kill(-server_child_pgid, signum);
+}
+
+/* Converts the status of the server's child into the client's exit status.
+ * If the child was killed by a signal, the client kills itself with the
+ * signal. */
+int client_exit_status(int status)
+{
+    if (WIFEXITED(status))
+	return WEXITSTATUS(status);
+    if (!WIFSIGNALED(status))
+	return Exit_FAILURE;
+
+    int signum = WTERMSIG(status);
+    struct sigaction action;
+    action.sa_handler = SIG_DFL;
+    action.sa_flags = 0;
+    sigemptyset(&action.sa_mask);
+    sigaction(signum, &action, NULL);
+
+    sigset_t ss;
+    sigemptyset(&ss);
+    sigaddset(&ss, signum);
+    sigprocmask(SIG_UNBLOCK, &ss, NULL);
+    raise(signum);
+    return signum + TERMSIGOFFSET;
+}
+
+
+/********** Auxiliaries **********/
+
+/* Reads exactly `size' bytes from the specified file descriptor.
+ * Returns false on error or end-of-file, in which case `errno' is zero on
+ * end-of-file. */
+bool read_all(int fd, void *buf, size_t size)
+{
+    while (size > 0) {
+	ssize_t n = read(fd, buf, size);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+	if (n == 0) {
+	    errno = 0;
+	    return false;
+	}
+	buf = (char *) buf + n;
+	size -= n;
+    }
+    return true;
+}
+
+/* Converts the pathname of a socket into a socket address.
+ * Prints an error message and returns false on error. */
+bool make_sockaddr(const wchar_t *path, struct sockaddr_un *addr)
+{
+    char *mbspath = malloc_wcstombs(path);
+    if (mbspath == NULL) {
+	xerror(EILSEQ, Ngt("cannot convert wide characters into "
+		    "multibyte characters"));
+	return false;
+    }
+
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    size_t length = strlen(mbspath);
+    bool ok = length < sizeof addr->sun_path;
+    if (ok)
+	memcpy(addr->sun_path, mbspath, length + 1);
+    else
+	xerror(ENAMETOOLONG, Ngt("invalid socket `%s'"), mbspath);
+    free(mbspath);
+    return ok;
+}
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -0,0 +1,34 @@
+/* Yash: yet another shell */
+/* server.h: pre-initialized shell server and its client */
+/* (C) 2026 magicant */
+
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#ifndef YASH_SERVER_H
+#define YASH_SERVER_H
+
+#include <stddef.h>
+
+
+extern _Bool serve(const wchar_t *path, int *argcp, char ***argvp)
+    __attribute__((nonnull,warn_unused_result));
+extern int run_client(const wchar_t *path, char **argv)
+    __attribute__((nonnull));
+
+
+#endif /* YASH_SERVER_H */
+
+
+/* vim: set ts=8 sts=4 sw=4 noet tw=80: */
@@ -29,6 +29,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/select.h>
+#if HAVE_SIGNALFD
+# include <sys/epoll.h>
+# include <sys/signalfd.h>
+# include <unistd.h>
+#endif
 #include <wchar.h>
 #include <wctype.h>
 #if HAVE_GETTEXT
@@ -88,7 +93,19 @@ static void set_special_handler(int signum, void (*handler)(int signum));
 static void reset_special_handler(
 	int signum, void (*handler)(int signum), bool leave);
 static void sig_handler(int signum);
+#if HAVE_SIGNALFD
+static bool open_sigfd(void);
+static bool is_handled_by_sig_handler(int signum);
+static const sigset_t *set_sigfd_mask(const sigset_t *ss)
+    __attribute__((nonnull));
+static int watch_sigfd_input(int fd);
+static int wait_for_sigfd(const sigset_t *ss, int fd, int timeout)
+    __attribute__((nonnull));
+static void read_sigfd(void);
+#endif
 static void handle_sigchld(void);
+static enum wait_for_input_T do_wait_for_input(
+	int fd, bool trap, int timeout, bool sigchld);
 static void set_trap(int signum, const wchar_t *command);
 static bool is_originally_ignored(int signum);
 static void banish_phantoms(void);
@@ -235,6 +252,9 @@ int get_signal_number_toupper(wchar_t *name)
 
 /* set to true when any trap other than "ignore" is set */
 bool any_trap_set = false;
+/* set to true while traps must not be executed because the shell is running a
+ * command substitution without a subshell */
+bool traps_deferred = false;
 
 /* flag to indicate a signal is caught. */
 static volatile sig_atomic_t any_signal_received = false;
@@ -295,6 +315,27 @@ static volatile sig_atomic_t sigchld_received, sigint_received;
 static volatile sig_atomic_t sigwinch_received;
 #endif
 
+#if HAVE_SIGNALFD
+/* The signalfd and epoll file descriptors used to wait for signals and input.
+ * While waiting, the signals that would be caught by `sig_handler' are kept
+ * blocked and read from `sigfd' instead. Both are -1 if not yet opened. */
+static int sigfd = -1, epfd = -1;
+/* The mask of `sigfd' and the signal mask used while waiting for `sigfd' are
+ * computed from `sigfd_base_mask' by `set_sigfd_mask'. They are recomputed
+ * only when the base mask differs or `sigfd_mask_valid' is false, which is the
+ * case after a trap or signal handler has been changed. */
+static bool sigfd_mask_valid = false;
+static sigset_t sigfd_base_mask, sigfd_mask, sigfd_waitmask;
+/* The input file descriptor that is registered in `epfd', or -1 if none.
+ * If `sigfd_input_regular' is true, `sigfd_input' is not actually registered
+ * because it is a regular file, which epoll does not support. */
+static int sigfd_input = -1;
+static bool sigfd_input_regular;
+/* The process that opened `epfd'. A child process shares the epoll instance
+ * until it calls `close_sigfd', so it must not modify the instance. */
+static pid_t sigfd_owner;
+#endif
+
 /* true iff SIGCHLD is handled. */
 static bool main_handler_set = false;
 /* true iff SIGTTIN, SIGTTOU, and SIGTSTP are ignored. */
@@ -345,6 +386,9 @@ void set_signals(void)
 	set_special_handler(SIGCHLD, sig_handler);
     }
 
+#if HAVE_SIGNALFD
+    sigfd_mask_valid = false;
+#endif
     sigprocmask(SIG_BLOCK, &block, NULL);
 }
 
@@ -370,6 +414,9 @@ void restore_signals(bool leave)
 	reset_special_handler(SIGWINCH, sig_handler, leave);
 #endif
     }
+#if HAVE_SIGNALFD
+    close_sigfd();
+#endif
     if (main_handler_set) {
 	sigset_t ss = official_sigmask;
 	if (leave) {
@@ -399,6 +446,74 @@ void reset_job_signals(void)
     }
 }
 
+/* Checks if an external command can be invoked without resetting any signal
+ * handler before `execve', that is, if `execve' alone would leave the signal
+ * handlers as `restore_signals(true)' would. Signals caught by `sig_handler'
+ * are reset to "default" by `execve', so this is the case unless the shell has
+ * installed a handler that must be reset to "ignore" or has ignored a signal
+ * that must be reset to "default".
+ * If true is returned, the signal mask the command should inherit is assigned
+ * to `*mask'. */
+bool get_sigmask_for_exec(sigset_t *mask)
+{
+    if (job_handlers_set || interactive_handlers_set)
+	return false;
+    if (main_handler_set
+	    && !sigismember(&trapped_signals, SIGCHLD)
+	    && sigismember(&officially_ignored_signals, SIGCHLD))
+	return false;
+
+    *mask = official_sigmask;
+    return true;
+}
+
+/* The signal mask and the handlers of all the signals known to the shell,
+ * saved by `save_signal_state'. */
+struct sigstate_T {
+    sigset_t mask;
+    struct sigaction actions[MAXSIGIDX];
+#if defined SIGRTMIN && defined SIGRTMAX
+    struct sigaction rtactions[RTSIZE];
+#endif
+};
+
+/* Saves the current signal mask and signal handlers in a newly malloced
+ * structure. The result must be passed to `restore_signal_state'.
+ * This function is used by the library interface to give the signal settings
+ * of the host program back when the shell is no longer used. */
+struct sigstate_T *save_signal_state(void)
+{
+    struct sigstate_T *state = xmalloc(sizeof *state);
+    sigprocmask(SIG_SETMASK, NULL, &state->mask);
+    for (const signal_T *s = signals; s->no != 0; s++)
+	sigaction(s->no, NULL, &state->actions[sigindex(s->no)]);
+#if defined SIGRTMIN && defined SIGRTMAX
+    for (int sigrtmin = SIGRTMIN, i = 0; i < RTSIZE; i++)
+	if (sigrtmin + i <= SIGRTMAX)
+	    sigaction(sigrtmin + i, NULL, &state->rtactions[i]);
+#endif
+    return state;
+}
+
+/* Stops the signal handling of the shell and restores the signal mask and
+ * signal handlers saved by `save_signal_state'. `state' is freed.
+ * The traps must have been reset before calling this function. After this
+ * function, `init_signal' and `set_signals' must be called again before the
+ * shell executes any command. */
+void restore_signal_state(struct sigstate_T *state)
+{
+    restore_signals(true);
+    for (const signal_T *s = signals; s->no != 0; s++)
+	sigaction(s->no, &state->actions[sigindex(s->no)], NULL);
+#if defined SIGRTMIN && defined SIGRTMAX
+    for (int sigrtmin = SIGRTMIN, i = 0; i < RTSIZE; i++)
+	if (sigrtmin + i <= SIGRTMAX)
+	    sigaction(sigrtmin + i, &state->rtactions[i], NULL);
+#endif
+    sigprocmask(SIG_SETMASK, &state->mask, NULL);
+    free(state);
+}
+
 /* Calls `sigaction' and, if the signal is not in either of
  * `originally_defaulted_signals' and `originally_ignored_signals', adds it to
  * one of them. */
@@ -600,6 +715,15 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
 	    break;
 	if (sigchld_received)
 	    break;
+#if HAVE_SIGNALFD
+	if (open_sigfd()) {
+	    if (wait_for_sigfd(&ss, -1, -1) < 0 && errno != EINTR) {
+		xerror(errno, "epoll_pwait");
+		break;
+	    }
+	    continue;
+	}
+#endif
 	if (sigsuspend(&ss) < 0) {
 	    if (errno != EINTR) {
 		xerror(errno, "sigsuspend");
@@ -627,6 +751,21 @@ int wait_for_sigchld(bool interruptible, bool return_on_trap)
  * specified timeout, which means that this function may wait for a time length
  * longer than the specified timeout. */
 enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
+{
+    return do_wait_for_input(fd, trap, timeout, false);
+}
+
+/* Like `wait_for_input', but returns W_CHILD as soon as SIGCHLD is caught and
+ * handled so that the caller can examine the updated job statuses.
+ * The wait time is unlimited. */
+enum wait_for_input_T wait_for_input_or_sigchld(int fd, bool trap)
+{
+    return do_wait_for_input(fd, trap, -1, true);
+}
+
+/* Implements `wait_for_input' and `wait_for_input_or_sigchld'. */
+enum wait_for_input_T do_wait_for_input(
+	int fd, bool trap, int timeout, bool sigchld)
 {
     sigset_t ss;
     struct timespec to;
@@ -659,6 +798,10 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
     }
 
     for (;;) {
+	if (sigchld && sigchld_received) {
+	    handle_sigchld();
+	    return W_CHILD;
+	}
 	handle_sigchld();
 	if (trap)
 	    handle_traps();
@@ -670,11 +813,24 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
 	    return W_INTERRUPTED;
 	}
 
-	fd_set fdset;
-	FD_ZERO(&fdset);
-	FD_SET(fd, &fdset);
-
-	int count = pselect(fd + 1, &fdset, NULL, NULL, top, &ss);
+	int count;
+	const char *funcname;
+#if HAVE_SIGNALFD
+	if (open_sigfd()) {
+	    count = wait_for_sigfd(&ss, fd, timeout);
+	    funcname = "epoll_pwait";
+	} else
+#endif
+	{
+	    fd_set fdset;
+	    FD_ZERO(&fdset);
+	    FD_SET(fd, &fdset);
+
+	    count = pselect(fd + 1, &fdset, NULL, NULL, top, &ss);
+	    if (count > 0 && !FD_ISSET(fd, &fdset))
+		count = 0;
+	    funcname = "pselect";
+	}
 
 	if (trap && sigint_received) {
 	    sigint_received = false;
@@ -682,15 +838,230 @@ enum wait_for_input_T wait_for_input(int fd, bool trap, int timeout)
 	}
 
 	if (count >= 0)
-	    return FD_ISSET(fd, &fdset) ? W_READY : W_TIMED_OUT;
+	    return (count > 0) ? W_READY : W_TIMED_OUT;
 
 	if (errno != EINTR) {
-	    xerror(errno, "pselect");
+	    xerror(errno, "%s", funcname);
 	    return W_ERROR;
 	}
     }
 }
 
+#if HAVE_SIGNALFD
+
+/* Opens `sigfd' and `epfd' if not yet opened.
+ * Returns false if they are not available, in which case the caller should
+ * fall back on `sigsuspend' or `pselect'. */
+bool open_sigfd(void)
+{
+    static bool unavailable = false;
+
+    if (sigfd >= 0)
+	return true;
+    if (unavailable)
+	return false;
+
+    sigset_t ss;
+    sigemptyset(&ss);
+    sigfd = move_to_shellfd(signalfd(-1, &ss, SFD_NONBLOCK | SFD_CLOEXEC));
+    if (sigfd < 0)
+	goto fail;
+    epfd = move_to_shellfd(epoll_create1(EPOLL_CLOEXEC));
+    if (epfd < 0)
+	goto fail;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = sigfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev) < 0)
+	goto fail;
+    sigfd_mask = ss;
+    sigfd_mask_valid = false;
+    sigfd_owner = getpid();
+    return true;
+
+fail:
+    close_sigfd();
+    unavailable = true;
+    return false;
+}
+
+/* Closes `sigfd' and `epfd' if open.
+ * A child process that continues as the shell without `become_child' must call
+ * this function so that it does not share the epoll instance with its parent.
+ */
+void close_sigfd(void)
+{
+    if (sigfd >= 0) {
+	remove_shellfd(sigfd);
+	xclose(sigfd);
+	sigfd = -1;
+    }
+    if (epfd >= 0) {
+	remove_shellfd(epfd);
+	xclose(epfd);
+	epfd = -1;
+    }
+    sigfd_input = -1;
+}
+
+/* Removes the specified file descriptor from `epfd' if registered.
+ * This function must be called before the file descriptor is closed or
+ * replaced. Otherwise, the epoll instance may keep watching the file that was
+ * previously open at the file descriptor. */
+void unwatch_sigfd_input(int fd)
+{
+    if (fd < 0 || fd != sigfd_input)
+	return;
+    if (!sigfd_input_regular && getpid() == sigfd_owner) {
+	struct epoll_event ev = { .events = 0 };
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+    }
+    sigfd_input = -1;
+}
+
+/* Checks if the signal handler for the specified signal is `sig_handler'. */
+bool is_handled_by_sig_handler(int signum)
+{
+    if (sigismember(&trapped_signals, signum))
+	return true;
+    switch (signum) {
+	case SIGCHLD:
+	    return main_handler_set;
+	case SIGINT:
+#if YASH_ENABLE_LINEEDIT && defined SIGWINCH
+	case SIGWINCH:
+#endif
+	    return interactive_handlers_set;
+	default:
+	    return false;
+    }
+}
+
+/* Sets the mask of `sigfd' to the signals that would be unblocked by signal
+ * mask `ss' and caught by `sig_handler'. Returns `ss' plus those signals,
+ * which must be blocked while waiting for `sigfd'. Other signals unblocked by
+ * `ss' are delivered as usual.
+ * The result of the previous call is reused if `ss' is the same and no trap or
+ * signal handler has been changed since then. */
+const sigset_t *set_sigfd_mask(const sigset_t *ss)
+{
+    if (sigfd_mask_valid && memcmp(ss, &sigfd_base_mask, sizeof *ss) == 0)
+	return &sigfd_waitmask;
+
+    sigset_t fdmask;
+    sigemptyset(&fdmask);
+    sigfd_base_mask = sigfd_waitmask = *ss;
+
+    for (const signal_T *s = signals; s->no != 0; s++) {
+	if (!sigismember(ss, s->no) && is_handled_by_sig_handler(s->no)) {
+	    sigaddset(&fdmask, s->no);
+	    sigaddset(&sigfd_waitmask, s->no);
+	}
+    }
+#if defined SIGRTMIN && defined SIGRTMAX
+    int sigrtmin = SIGRTMIN, range = SIGRTMAX - sigrtmin + 1;
+    if (range > RTSIZE)
+	range = RTSIZE;
+    for (int i = 0; i < range; i++) {
+	int signum = sigrtmin + i;
+	if (!sigismember(ss, signum) && is_handled_by_sig_handler(signum)) {
+	    sigaddset(&fdmask, signum);
+	    sigaddset(&sigfd_waitmask, signum);
+	}
+    }
+#endif
+
+    if (memcmp(&fdmask, &sigfd_mask, sizeof fdmask) != 0) {
+	signalfd(sigfd, &fdmask, 0);
+	sigfd_mask = fdmask;
+    }
+    sigfd_mask_valid = true;
+    return &sigfd_waitmask;
+}
+
+/* Registers the specified file descriptor in `epfd' unless already registered.
+ * The previously registered file descriptor, if any, is removed. If `fd' is
+ * negative, no file descriptor remains registered.
+ * Returns 1 if registered, 0 if `fd' is negative or a regular file, or -1 with
+ * `errno' set on error. */
+int watch_sigfd_input(int fd)
+{
+    if (fd == sigfd_input)
+	return fd >= 0 && !sigfd_input_regular;
+
+    unwatch_sigfd_input(sigfd_input);
+    if (fd < 0)
+	return 0;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) >= 0)
+	sigfd_input_regular = false;
+    else if (errno == EPERM)
+	sigfd_input_regular = true;
+    else
+	return -1;
+    sigfd_input = fd;
+    return !sigfd_input_regular;
+}
+
+/* Waits for a signal that would be unblocked by signal mask `ss' or, if `fd'
+ * is non-negative, for `fd' to be available for reading.
+ * `timeout' is the maximum time length of wait in milliseconds, or negative
+ * for unlimited wait.
+ * `sigfd' must be open. Signals read from `sigfd' are passed to `sig_handler'.
+ * Returns 1 if `fd' is ready or 0 if timed out. Otherwise, returns -1 with
+ * `errno' set; `errno' is EINTR if a signal was caught. */
+int wait_for_sigfd(const sigset_t *ss, int fd, int timeout)
+{
+    const sigset_t *waitmask = set_sigfd_mask(ss);
+
+    /* The input file descriptor is left registered after the wait so that it
+     * does not have to be registered again on the next wait. */
+    int watched = watch_sigfd_input(fd);
+    if (watched < 0)
+	return -1;
+    if (fd >= 0 && watched == 0)
+	timeout = 0;  /* Regular files are always ready for reading. */
+
+    struct epoll_event events[2];
+    int count = epoll_pwait(epfd, events, 2, timeout, waitmask);
+    if (count < 0)
+	return -1;
+    if (count == 0)
+	return (fd >= 0 && watched == 0) ? 1 : 0;
+
+    bool fdready = false, signaled = false;
+    for (int i = 0; i < count; i++) {
+	if (events[i].data.fd == sigfd)
+	    signaled = true;
+	else
+	    fdready = true;
+    }
+    if (signaled)
+	read_sigfd();
+    if (fdready)
+	return 1;
+    errno = EINTR;
+    return -1;
+}
+
+/* Reads all the signals pending in `sigfd' and passes them to `sig_handler'.
+ */
+void read_sigfd(void)
+{
+    struct signalfd_siginfo info[8];
+    ssize_t size;
+
+    while ((size = read(sigfd, info, sizeof info)) > 0)
+	for (size_t i = 0; i < (size_t) size / sizeof *info; i++)
+	    sig_handler((int) info[i].ssi_signo);
+}
+
+#endif /* HAVE_SIGNALFD */
+
 /* Handles SIGCHLD if caught. */
 void handle_sigchld(void)
 {
@@ -734,7 +1105,8 @@ int handle_traps(void)
     /* Signal handler execution is not reentrant because the value of
      * `savelaststatus' would be lost. But the EXIT is the only exception:
      * The EXIT trap may be executed inside another trap. */
-    if (!any_trap_set || !any_signal_received || handled_signal >= 0)
+    if (!any_trap_set || !any_signal_received || handled_signal >= 0
+	    || traps_deferred)
 	return 0;
 #if YASH_ENABLE_LINEEDIT
     /* Don't handle traps during command line completion. Otherwise, the command
@@ -910,6 +1282,9 @@ void set_trap(int signum, const wchar_t *command)
     } else {
 	sigdelset(&trapped_signals, signum);
     }
+#if HAVE_SIGNALFD
+    sigfd_mask_valid = false;
+#endif
 
     switch (signum) {
 	case SIGCHLD:
@@ -976,6 +1351,22 @@ void clear_exit_trap(void)
     set_trap(0, NULL);
 }
 
+/* Resets all the traps to the default. */
+void reset_traps(void)
+{
+    if (trap_command[sigindex(0)] != NULL)
+	set_trap(0, NULL);
+    for (const signal_T *s = signals; s->no != 0; s++)
+	if (trap_command[sigindex(s->no)] != NULL)
+	    set_trap(s->no, NULL);
+#if defined SIGRTMIN && defined SIGRTMAX
+    for (int sigrtmin = SIGRTMIN, i = 0; i < RTSIZE; i++)
+	if (rttrap_command[i] != NULL)
+	    set_trap(sigrtmin + i, NULL);
+#endif
+    any_trap_set = false;
+}
+
 /* Change all traps into phantom except that are set to SIG_IGN. */
 void phantomize_traps(void)
 {
@@ -19,6 +19,7 @@
 #ifndef YASH_SIG_H
 #define YASH_SIG_H
 
+#include <signal.h>
 #include <stddef.h>
 #include <sys/types.h>
 #include "xgetopt.h"
@@ -32,12 +33,19 @@ extern int get_signal_number(const wchar_t *name)
 extern int get_signal_number_toupper(wchar_t *name)
     __attribute__((nonnull));
 
-extern _Bool any_trap_set;
+extern _Bool any_trap_set, traps_deferred;
 
 extern void init_signal(void);
 extern void set_signals(void);
 extern void restore_signals(_Bool leave);
 extern void reset_job_signals(void);
+struct sigstate_T;
+extern struct sigstate_T *save_signal_state(void)
+    __attribute__((malloc,warn_unused_result));
+extern void restore_signal_state(struct sigstate_T *state)
+    __attribute__((nonnull));
+extern _Bool get_sigmask_for_exec(sigset_t *mask)
+    __attribute__((nonnull));
 extern void set_interruptible_by_sigint(_Bool onoff);
 extern void ignore_sigquit_and_sigint(void);
 extern void ignore_sigtstp(void);
@@ -47,14 +55,20 @@ extern void handle_signals(void);
 extern int wait_for_sigchld(_Bool interruptible, _Bool return_on_trap);
 
 enum wait_for_input_T {
-    W_READY, W_TIMED_OUT, W_INTERRUPTED, W_ERROR,
+    W_READY, W_TIMED_OUT, W_INTERRUPTED, W_CHILD, W_ERROR,
 };
 
 extern enum wait_for_input_T wait_for_input(int fd, _Bool trap, int timeout);
+extern enum wait_for_input_T wait_for_input_or_sigchld(int fd, _Bool trap);
+#if HAVE_SIGNALFD
+extern void close_sigfd(void);
+extern void unwatch_sigfd_input(int fd);
+#endif
 
 extern int handle_traps(void);
 extern void execute_exit_trap(void);
 extern void clear_exit_trap(void);
+extern void reset_traps(void);
 extern void phantomize_traps(void);
 extern _Bool is_interrupted(void);
 extern void set_laststatus_if_interrupted(void);
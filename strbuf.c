@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -36,6 +37,8 @@ size_t wcsnrtombs(char *restrict dst, const wchar_t **restrict src, size_t nwc,
 	size_t len, mbstate_t *restrict ps);
 #endif
 
+static bool is_ascii_compatible_locale(void);
+
 
 /* If the type of the return value of the functions below is string buffer,
  * the return value is the argument buffer. */
@@ -437,6 +440,97 @@ char *wb_mbscat(xwcsbuf_T *restrict buf, const char *restrict s)
     return (char *) s;
 }
 
+/* Converts the first `n' bytes of multibyte string `s' into wide characters
+ * and appends them to buffer `buf'. The conversion starts in and updates the
+ * shift state `*ps', so a character split between two calls is converted
+ * correctly. Null bytes are converted into null wide characters unless
+ * `linewise' is true, in which case the conversion stops before a null byte
+ * and after a newline.
+ * Returns the number of bytes converted. If `s' starts with an invalid byte
+ * sequence, `errno' is set to EILSEQ and (size_t) -1 is returned. An invalid
+ * sequence found after some characters stops the conversion before it.
+ * The buffer is enlarged at most once in each call. */
+size_t wb_mbsncat(xwcsbuf_T *restrict buf, const char *restrict s,
+	size_t n, mbstate_t *restrict ps, bool linewise)
+{
+    /* No byte is converted into more than one wide character. */
+    wb_ensuremax(buf, add(buf->length, n));
+
+    bool ascii = is_ascii_compatible_locale();
+    wchar_t *w = &buf->contents[buf->length];
+    size_t i = 0;
+    while (i < n) {
+	if (ascii && mbsinit(ps)) {
+	    /* fast path: ASCII characters are copied as they are */
+	    for (; i < n && (unsigned char) s[i] < 0x80; i++) {
+		if (linewise) {
+		    if (s[i] == '\0')
+			goto done;
+		    if (s[i] == '\n') {
+			*w++ = L'\n', i++;
+			goto done;
+		    }
+		}
+		*w++ = (wchar_t) s[i];
+	    }
+	    if (i >= n)
+		break;
+	}
+
+	size_t count = mbrtowc(w, &s[i], n - i, ps);
+	switch (count) {
+	    case 0:            /* null character */
+		if (linewise)
+		    goto done;
+		w++, i++;
+		break;
+	    case (size_t) -1:  /* not a valid character */
+		if (i == 0)
+		    return (size_t) -1;
+		goto done;
+	    case (size_t) -2:  /* incomplete character kept in the state */
+		i = n;
+		break;
+	    default:
+		i += count;
+		if (*w++ == L'\n' && linewise)
+		    goto done;
+		break;
+	}
+    }
+
+done:
+    buf->length = w - buf->contents;
+    buf->contents[buf->length] = L'\0';
+    return i;
+}
+
+/* Returns true if every ASCII character is a single-byte character whose wide
+ * character value equals its byte value in the current locale.
+ * The result is cached while the locale for LC_CTYPE is unchanged. */
+bool is_ascii_compatible_locale(void)
+{
+    static char *locale = NULL;
+    static bool result;
+
+    const char *current = setlocale(LC_CTYPE, NULL);
+    if (current == NULL)
+	return false;
+    if (locale != NULL && strcmp(locale, current) == 0)
+	return result;
+
+    free(locale);
+    locale = xstrdup(current);
+    result = true;
+    for (int c = 1; c < 0x80; c++) {
+	if (btowc(c) != (wint_t) c) {
+	    result = false;
+	    break;
+	}
+    }
+    return result;
+}
+
 /* Appends the result of `vswprintf' to the specified buffer.
  * `format' and the following arguments must not be part of `buf->contents'.
  * Returns the number of appended characters if successful.
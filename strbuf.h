@@ -169,6 +169,9 @@ extern xwcsbuf_T *wb_wccat(xwcsbuf_T *buf, wchar_t c)
     __attribute__((nonnull));
 extern char *wb_mbscat(xwcsbuf_T *restrict buf, const char *restrict s)
     __attribute__((nonnull));
+extern size_t wb_mbsncat(xwcsbuf_T *restrict buf, const char *restrict s,
+	size_t n, mbstate_t *restrict ps, _Bool linewise)
+    __attribute__((nonnull));
 extern int wb_vwprintf(
 	xwcsbuf_T *restrict buf, const wchar_t *restrict format, va_list ap)
     __attribute__((nonnull(1,2)));
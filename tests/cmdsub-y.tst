@@ -91,4 +91,91 @@ __ERR__
 #`
 #`
 
+test_oE 'command substitution of built-ins and functions needs no subshell'
+f() { printf '%s\n' "$@"; pwd >/dev/null; }
+times -c >before
+a=$(echo foo; f bar baz) b=$(true) c=$(f "$(echo qux)")
+times -c >after
+echo "$a" "$b" "$c"
+{ read -r _ f1; read -r _ s1; } <before
+{ read -r _ f2; read -r _ s2; } <after
+echo $((f2 + s2 - f1 - s1))
+__IN__
+foo
+bar
+baz  qux
+0
+__OUT__
+
+test_oE 'exit status of command substitution without subshell'
+a=$(false)
+echo $?
+a=$(echo x; true)
+echo $?
+__IN__
+1
+0
+__OUT__
+
+test_oE 'reading variable with getter in command substitution'
+RANDOM=1; a=$(echo $RANDOM); b=$RANDOM
+RANDOM=1; c=$(echo $RANDOM; exit); d=$RANDOM
+[ "$a $b" = "$c $d" ] && echo ok
+__IN__
+ok
+__OUT__
+
+test_oE 'standard output is restored after command substitution'
+a=$(echo foo >/dev/null; echo bar)
+echo "$a"
+echo baz
+__IN__
+bar
+baz
+__OUT__
+
+test_oE 'output longer than read buffer'
+a=$(dd if=/dev/zero bs=1000 count=200 2>/dev/null | tr '\0' x; echo; echo)
+echo ${#a}
+b=$(printf '%s\n' "$a" "$a" "$a")
+echo ${#b}
+__IN__
+200000
+600002
+__OUT__
+
+test_oE 'command substitution reading file'
+printf 'foo\nbar\n\n\n' >file
+times -c >before
+a=$(<file) b=$( < "fi""le" ) c=$(<file )
+times -c >after
+printf '[%s]\n' "$a" "$b" "$c"
+{ read -r _ f1; read -r _ s1; } <before
+{ read -r _ f2; read -r _ s2; } <after
+echo $((f2 + s2 - f1 - s1))
+__IN__
+[foo
+bar]
+[foo
+bar]
+[foo
+bar]
+0
+__OUT__
+
+test_oE 'command substitution reading file with side effects in filename'
+echo foo >file1
+a=$(<file$((i=1)))
+echo "$a" "${i-unset}"
+__IN__
+foo unset
+__OUT__
+
+test_oE 'command substitution reading non-existing file'
+{ a=$(<_no_such_file_); } 2>/dev/null
+echo $? "[$a]"
+__IN__
+2 []
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 noet:
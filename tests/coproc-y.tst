@@ -0,0 +1,110 @@
+# coproc-y.tst: yash-specific test of coprocesses
+
+test_oE 'coprocess reads from and writes to shell'
+coproc { read -r line; echo "received $line"; }
+echo hello >&"${COPROC[2]}"
+read -r reply <&"${COPROC[1]}"
+echo "$reply"
+__IN__
+received hello
+__OUT__
+
+test_oE 'coprocess serves many requests'
+coproc while read -r x; do echo $((x * x)); done
+for i in 1 2 3; do
+    echo $i >&"${COPROC[2]}"
+    read -r y <&"${COPROC[1]}"
+    echo $y
+done
+__IN__
+1
+4
+9
+__OUT__
+
+test_oE 'named coprocess'
+coproc SQUARE { read -r x; echo $((x * x)); }
+echo 7 >&"${SQUARE[2]}"
+read -r y <&"${SQUARE[1]}"
+echo $y
+__IN__
+49
+__OUT__
+
+test_oE 'name is a command word unless followed by compound command'
+coproc echo foo
+read -r x <&"${COPROC[1]}"
+echo "$x"
+__IN__
+foo
+__OUT__
+
+test_oE 'file descriptors are not less than 10'
+coproc cat
+[ "${COPROC[1]}" -ge 10 ] && [ "${COPROC[2]}" -ge 10 ] && echo ok
+__IN__
+ok
+__OUT__
+
+test_oE 'closing input lets coprocess finish'
+coproc cat
+echo foo >&"${COPROC[2]}"
+eval "exec ${COPROC[2]}>&-"
+cat <&"${COPROC[1]}"
+wait $!
+echo $?
+__IN__
+foo
+0
+__OUT__
+
+test_oE '$! is process ID of coprocess'
+coproc { exit 3; }
+wait $!
+echo $?
+__IN__
+3
+__OUT__
+
+test_oE 'exit status of coproc command'
+coproc { exit 3; }
+echo $?
+__IN__
+0
+__OUT__
+
+test_oE 'coprocess is a job'
+coproc cat
+jobs
+eval "exec ${COPROC[2]}>&-"
+wait
+__IN__
+[1] + Running              coproc cat
+__OUT__
+
+test_oE 'printing coproc command'
+f() {
+    coproc cat
+    coproc NAME { cat; }
+}
+typeset -fp f
+__IN__
+f()
+{
+   coproc cat
+   coproc NAME {
+      cat
+   }
+}
+__OUT__
+
+test_Oe -e 2 'coproc in POSIXly-correct mode'
+set -o posix
+coproc cat
+__IN__
+syntax error: `coproc' cannot be used as a command name
+__ERR__
+#'`
+#'`
+
+# vim: set ft=sh ts=8 sts=4 sw=4 noet:
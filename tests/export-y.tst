@@ -53,6 +53,23 @@ __IN__
 A
 __OUT__
 
+test_oE 'changes to exported variable are passed to later commands'
+export a=1
+sh -c 'echo $a'
+a=2
+sh -c 'echo $a'
+a=3 sh -c 'echo $a'
+sh -c 'echo $a'
+unset a
+sh -c 'echo ${a-unset}'
+__IN__
+1
+2
+3
+2
+unset
+__OUT__
+
 test_O -d -e 1 'assigning to ill-named variable'
 export =A
 __IN__
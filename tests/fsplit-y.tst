@@ -80,4 +80,24 @@ __IN__
 [1][][][][]
 __OUT__
 
+test_oE 'long fields with quoted IFS characters'
+IFS=' ,'
+a=abcdefghijklmnopqrstuvwxyz
+b="$a,$a $a"
+bracket $b"$b"$b
+__IN__
+[abcdefghijklmnopqrstuvwxyz][abcdefghijklmnopqrstuvwxyz][abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz,abcdefghijklmnopqrstuvwxyz abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz][abcdefghijklmnopqrstuvwxyz][abcdefghijklmnopqrstuvwxyz]
+__OUT__
+
+test_oE 'IFS with many distinct characters'
+IFS=' ,;:-'
+a='1,2;3:4-5 6'
+bracket $a
+a='aaaaaaaaaaaa:bbbbbbbbbbbb-cccccccccccc'
+bracket $a
+__IN__
+[1][2][3][4][5][6]
+[aaaaaaaaaaaa][bbbbbbbbbbbb][cccccccccccc]
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 noet:
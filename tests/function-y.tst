@@ -141,6 +141,46 @@ readonly -f func
 func() { :; }
 __IN__
 
+test_oE 'long chain of tail calls'
+count() {
+    if [ "$1" -gt 0 ]; then
+	count "$(($1 - 1))" "$(($2 + 1))"
+    else
+	case $2 in (*) echo "$2";; esac
+    fi
+}
+count 100000 0
+__IN__
+100000
+__OUT__
+
+test_oE 'local variables and positional parameters in tail calls'
+f() { typeset a=1 b=1; g x; }
+g() { typeset b=2 c=2; h "$@" y; }
+h() { echo "$a $b $c" "$#" "$@"; }
+f 1 2 3
+echo "${a-unset} ${b-unset} ${c-unset}" "$#"
+__IN__
+1 2 2 2 x y
+unset unset unset 0
+__OUT__
+
+test_x -e 3 'exit status of tail call'
+f() { return 3; echo not reached; }
+g() { true && f; }
+g
+__IN__
+
+test_oE 'function call with redirection is not tail call'
+f() { g >/dev/null; echo f; }
+g() { echo g; }
+f
+h() { g; } >/dev/null
+h
+__IN__
+f
+__OUT__
+
 test_Oe -e 2 'simple command as function body (w/o function keyword)'
 foo() echo >/dev/null
 __IN__
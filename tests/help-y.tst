@@ -601,6 +601,24 @@ Try `man yash' for details.
 __OUT__
 #`
 
+test_oE -e 0 'help of parmap'
+help parmap
+__IN__
+parmap: execute a command for each item in parallel
+
+Syntax:
+	parmap [-j count] [-s array] [-a array] command [argument...]
+
+Options:
+	-a ...   --array=...
+	-j ...   --jobs=...
+	-s ...   --status=...
+	         --help
+
+Try `man yash' for details.
+__OUT__
+#`
+
 (
 if ! testee -c 'command -bv popd' >/dev/null; then
     skip="true"
@@ -762,6 +780,7 @@ Syntax:
 Options:
 	-a       -o allexport
 	         -o braceexpand
+	         -o bytecode
 	         -o caseglob
 	+C       -o clobber
 	-c       -o cmdline
@@ -780,7 +799,9 @@ Options:
 	-h       -o hashondef
 	         -o histspace
 	         -o ignoreeof
+	         -o inlinesubshell
 	-i       -o interactive
+	         -o lastpipe
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
@@ -883,10 +904,11 @@ __IN__
 times: print CPU time usage
 
 Syntax:
-	times
+	times [-c]
 
 Options:
-	--help
+	-c       --count
+	         --help
 
 Try `man yash' for details.
 __OUT__
@@ -1060,9 +1082,13 @@ wait: wait for jobs to terminate
 
 Syntax:
 	wait [job or process_id...]
+	wait -n [-l limit] [-p variable]
 
 Options:
-	--help
+	-l ...   --limit=...
+	-n       --next
+	-p ...   --pid-variable=...
+	         --help
 
 Try `man yash' for details.
 __OUT__
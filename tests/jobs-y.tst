@@ -48,6 +48,32 @@ __IN__
 $?=0
 __OUT__
 
+test_oE 'jobs: name of job started in unset function'
+mkfifo fifo
+f() { cat fifo | cat & }
+f
+unset -f f
+jobs
+echo >fifo
+wait
+__IN__
+[1] + Running              cat fifo | cat
+
+__OUT__
+
+test_oE 'jobs: name of and-or list started in unset function'
+mkfifo fifo2
+f() { ! cat fifo2 && cat || cat & }
+f
+unset -f f
+jobs
+echo >fifo2
+wait
+__IN__
+[1] + Running              ! cat fifo2 && cat || cat
+
+__OUT__
+
 test_oE 'exit status of suspended job' -m
 "$TESTEE" -cim --norcfile 'echo 1; suspend; echo 2'
 kill -l $?
@@ -10,6 +10,114 @@ __IN__
 1 2
 __OUT__
 
+test_oE 'bytecode on: loops and conditionals' --bytecode
+i=0
+while [ $i -lt 5 ]; do
+    i=$((i+1))
+    case $i in
+	(2) continue ;;
+	(4) echo four ;;
+	(*) if [ $i -eq 5 ]; then echo last; else echo $i; fi ;;
+    esac
+done
+until ! false; do echo not reached; done
+echo $i $?
+__IN__
+1
+3
+four
+last
+5 0
+__OUT__
+
+test_oE 'bytecode on: break and continue out of nested loops' --bytecode
+for a in 1 2 3; do
+    for b in x y z; do
+	[ $b = y ] && continue 2
+	[ $a = 3 ] && break 2
+	echo $a$b
+    done
+    echo not reached
+done
+echo done
+__IN__
+1x
+2x
+done
+__OUT__
+
+test_oE 'bytecode on: function bodies' --bytecode
+f() {
+    for arg do
+	echo "[$arg]"
+    done
+    ! true && echo not reached
+    true && return 3
+    echo not reached
+}
+f 'a  b' c
+echo $?
+__IN__
+[a  b]
+[c]
+3
+__OUT__
+
+test_oE 'bytecode on: exit status of literal and expanded commands' --bytecode
+f() { echo literal; false; echo "$1"; (exit 4); }
+f expanded
+echo $?
+__IN__
+literal
+expanded
+4
+__OUT__
+
+test_oE 'bytecode on: quoted variables in simple commands' --bytecode
+a='1  2' b=(x y)
+for i in 1 2; do
+    printf '[%s]' "$a" "$b" "$unset" "$i"
+    echo
+    unset a
+done
+__IN__
+[1  2][x][y][][1]
+[][x][y][][2]
+__OUT__
+
+test_oe 'bytecode on: xtrace' --bytecode
+a=1
+for i in 1; do set -x; echo "$a" [; set +x; done
+__IN__
+1 [
+__OUT__
++ echo 1 '['
++ set '+x'
+__ERR__
+
+test_o 'bytecode on: nounset' --bytecode -u
+for i in 1; do echo "$unset"; echo not reached; done
+__IN__
+__OUT__
+
+test_oE 'bytecode on: built-in replaced by function in loop' --bytecode
+for i in 1 2; do
+    echo "$i"
+    echo() { printf 'function %s\n' "$@"; }
+done
+__IN__
+1
+function 2
+__OUT__
+
+test_oE -e 1 'bytecode on: errexit' --bytecode -e
+f() { echo a; false; echo not reached; }
+while true; do f; done
+echo not reached
+__IN__
+a
+__OUT__
+
 test_x -e 0 'hashondef (long) on: $-' -o hashondef
 printf '%s\n' "$-" | grep -q h
 __IN__
@@ -18,6 +126,134 @@ test_x -e 0 'hashondef (long) off: $-' +o hashondef
 printf '%s\n' "$-" | grep -qv h
 __IN__
 
+test_oE 'inlinesubshell on: variables are restored' --inlinesubshell
+a=1 b=2
+(a=3; unset b; export c=4; echo $a ${b-unset} $c; sh -c 'echo ${c-unset}')
+echo $a $b ${c-unset}
+sh -c 'echo ${c-unset}'
+__IN__
+3 unset 4
+4
+1 2 unset
+unset
+__OUT__
+
+test_oE 'inlinesubshell on: working directory and umask are restored' \
+    --inlinesubshell
+mkdir dir
+d=$PWD
+umask 022
+(cd dir; umask 077; [ "$(pwd)" = "$d/dir" ] && echo in; umask)
+[ "$(pwd)" = "$d" ] && [ "$PWD" = "$d" ] && echo out
+umask
+__IN__
+in
+0077
+out
+0022
+__OUT__
+
+test_oE 'inlinesubshell on: exit status' --inlinesubshell
+f() { echo f; exit 3; }
+(echo a; exit 2; echo not reached)
+echo $?
+(f; echo not reached)
+echo $?
+(false)
+echo $?
+__IN__
+a
+2
+f
+3
+1
+__OUT__
+
+test_oE -e 5 'inlinesubshell on: errexit' --inlinesubshell -e
+(echo a; sh -c 'exit 5'; echo not reached)
+echo not reached
+__IN__
+a
+__OUT__
+
+test_o 'inlinesubshell on: errors exit only the subshell' --inlinesubshell
+(x=${y?}; echo not reached)
+echo $?
+readonly r=1
+(r=2; echo not reached)
+echo $?
+__IN__
+2
+2
+__OUT__
+
+test_oE 'inlinesubshell on: no child process' --inlinesubshell
+times -c >before
+(a=1; echo $a; cd /; umask 0; exit)
+times -c >after
+diff before after && echo same
+__IN__
+1
+same
+__OUT__
+
+test_oE 'inlinesubshell on: falling back on a child process' --inlinesubshell
+a=1
+(trap 'echo trapped' EXIT; a=2)
+echo $a
+__IN__
+trapped
+1
+__OUT__
+
+test_oE 'inlinesubshell on: last command of pipeline' --inlinesubshell
+x=1
+printf '%s\n' foo bar | while read -r x; do echo "$x"; done
+echo "$x"
+__IN__
+foo
+bar
+1
+__OUT__
+
+test_oE 'lastpipe on: variables assigned in last command' --lastpipe
+printf '%s\n' 1 2 3 | while read -r x; do total=$((${total-0} + x)); done
+echo $total
+__IN__
+6
+__OUT__
+
+test_oE 'lastpipe on: exit status' --lastpipe
+true | false
+echo $?
+false | true
+echo $?
+set -o pipefail
+(exit 3) | true
+echo $?
+__IN__
+1
+0
+3
+__OUT__
+
+test_oE 'lastpipe on: pipeline is hidden from last command' --lastpipe
+set -o pipefail
+exit 3 | { sleep 0.1; wait; jobs; }
+echo $?
+exit 4 | { wait %1; echo $?; }
+__IN__
+3
+127
+__OUT__
+
+test_oE 'lastpipe off: variables assigned in last command' +o lastpipe
+echo 1 | read x
+echo ${x-unset}
+__IN__
+unset
+__OUT__
+
 test_o 'noexec is linewise'
 set -n; echo executed
 echo not executed
@@ -0,0 +1,107 @@
+# parmap-y.tst: yash-specific test of the parmap built-in
+
+test_oE 'output is printed in the order of items'
+f() { sleep "0.$((4 - $1))"; echo "$1"; }
+a=(1 2 3)
+parmap -j 3 -a a f
+__IN__
+1
+2
+3
+__OUT__
+
+test_oE 'arguments precede item'
+a=(x y)
+parmap -a a echo foo bar
+__IN__
+foo bar x
+foo bar y
+__OUT__
+
+test_oE 'items are read from standard input by default'
+printf '%s\n' 'a b' c | parmap echo
+__IN__
+a b
+c
+__OUT__
+
+test_oE 'exit statuses are stored in array'
+f() { return "$1"; }
+a=(0 3 0 5)
+parmap -j 2 -s st -a a f
+echo $? "${st}"
+__IN__
+3 0 3 0 5
+__OUT__
+
+test_oE 'command exiting subshell during item'
+f() { if [ "$1" = 2 ]; then exit 7; fi; echo "$1"; }
+a=(1 2 3 4)
+parmap -j 1 -s st -a a f
+echo $? "${st}"
+__IN__
+1
+3
+4
+7 0 7 0 0
+__OUT__
+
+test_oE 'items do not affect shell environment'
+f() { x=$1; }
+x=0 a=(1 2)
+parmap -a a f
+echo "$x"
+__IN__
+0
+__OUT__
+
+test_oE 'items do not affect each other'
+f() { n=$((n+1)); [ "$PWD" = / ] && d=/ || d=.; echo "$1 n=$n $d"; cd /; }
+a=(1 2 3 4 5 6) n=0
+parmap -j 2 -a a f
+__IN__
+1 n=1 .
+2 n=1 .
+3 n=1 .
+4 n=1 .
+5 n=1 .
+6 n=1 .
+__OUT__
+
+test_oE 'no items'
+a=()
+parmap -a a echo foo
+echo $?
+__IN__
+0
+__OUT__
+
+test_Oe -e 2 'non-positive number of jobs'
+parmap -j 0 echo
+__IN__
+parmap: `0' is not a positive integer
+__ERR__
+#'`
+#'`
+
+test_Oe -e 2 'non-numeric number of jobs'
+parmap -j x echo
+__IN__
+parmap: `x' is not a valid integer
+__ERR__
+#'`
+#'`
+
+test_Oe -e 1 'non-existing array'
+parmap -a none echo
+__IN__
+parmap: no such array $none
+__ERR__
+
+test_Oe -e 2 'missing operand'
+parmap
+__IN__
+parmap: this command requires an operand
+__ERR__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 noet:
@@ -0,0 +1,29 @@
+# pipebench.sh: measures the throughput of a pipeline with and without
+# enlarged pipes
+# (C) 2026 magicant
+
+# Usage: sh pipebench.sh [shell [megabytes [pipe_size]]]
+# The shell defaults to the yash built in the parent directory, the amount of
+# data defaults to 1024 megabytes, and the pipe size defaults to 1048576 bytes.
+# The data is passed through a pipeline of three commands, first with the
+# default pipe capacity and then with $YASH_PIPE_SIZE set to the pipe size.
+# The "times" built-in is run after each pipeline; the second line of its
+# output is the CPU time the commands of the pipeline spent, which includes
+# the system time spent switching between the commands.
+
+set -o errexit
+cd -- "$(dirname -- "$0")"
+
+shell="${1-../yash}"
+megabytes="${2-1024}"
+pipesize="${3-1048576}"
+
+for size in '' "$pipesize"; do
+    printf '%s: transferring %d MB with YASH_PIPE_SIZE=%s\n' \
+	"$0" "$megabytes" "$size"
+    "$shell" -c '
+    YASH_PIPE_SIZE="$2"
+    dd if=/dev/zero bs=1048576 count="$1" 2>/dev/null | cat | wc -c
+    times
+    ' pipebench "$megabytes" "$size"
+done
@@ -51,4 +51,25 @@ syntax error: ksh-like extended glob pattern `!(...)' is not supported
 __ERR__
 #`
 
+test_oE 'pipeline with enlarged pipes'
+YASH_PIPE_SIZE=1048576
+i=0
+while [ "$i" -lt 10000 ]; do
+    echo "$i"
+    i=$((i+1))
+done | cat | tail -n 1
+__IN__
+9999
+__OUT__
+
+test_oE 'invalid pipe size is ignored'
+YASH_PIPE_SIZE=foo
+echo foo | cat
+YASH_PIPE_SIZE=-1
+echo bar | cat
+__IN__
+foo
+bar
+__OUT__
+
 # vim: set ft=sh ts=8 sts=4 sw=4 noet:
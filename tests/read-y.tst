@@ -58,6 +58,15 @@ __IN__
 0 [A] [B] [C -]
 __OUT__
 
+test_oE 'comma-separated fields with long values'
+IFS=, read -r a b c <<\END
+the first field,the second field,the third field,and the rest
+END
+echoraw $? "[${a-unset}]" "[${b-unset}]" "[${c-unset}]"
+__IN__
+0 [the first field] [the second field] [the third field,and the rest]
+__OUT__
+
 test_oE 'too many fields are joined with trailing whitespaces removed'
 IFS=' -' read a b c <<\END
 A B C-C C\\C\
@@ -0,0 +1,36 @@
+# reapbench.sh: measures the time to reap many concurrent asynchronous jobs
+# (C) 2026 magicant
+
+# Usage: sh reapbench.sh [shell [number_of_jobs]]
+# The shell defaults to the yash built in the parent directory and the number
+# of jobs defaults to 10000.
+# All the jobs are started at once and they exit while the shell is waiting
+# for a foreground command, so the shell reaps all of them while keeping track
+# of them in the job list. The "times" built-in is run before and after that;
+# the difference in the first line of its output is the CPU time the shell
+# spent reaping the jobs. The last "times" shows the time spent in the "wait"
+# built-in removing the finished jobs.
+
+set -o errexit
+cd -- "$(dirname -- "$0")"
+
+shell="${1-../yash}"
+count="${2-10000}"
+
+printf '%s: reaping %d jobs with %s\n' "$0" "$count" "$shell"
+"$shell" -c '
+count="$1" delay="$(($1 / 2000 + 2))"
+i=0
+while [ "$i" -lt "$count" ]; do
+    sleep "$delay" &
+    i=$((i+1))
+done
+echo "after starting jobs:"
+times
+sleep "$((delay * 2))"
+echo "after reaping jobs:"
+times
+wait
+echo "after removing jobs:"
+times
+' reapbench "$count"
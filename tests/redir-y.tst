@@ -334,6 +334,16 @@ __IN__
 foo
 __OUT__
 
+test_oE -e 0 'here-string longer than pipe buffer'
+s=0123456789 s=$s$s$s$s$s$s$s$s$s$s s=$s$s$s$s$s$s$s$s$s$s
+s=$s$s$s$s$s$s$s$s$s$s s=$s$s$s$s$s$s$s$s$s$s s=$s$s$s$s$s$s$s$s$s$s
+cat <<<"$s" | wc -c | tr -d ' '
+cat <<<"$s" | tail -c 11
+__IN__
+1000001
+0123456789
+__OUT__
+
 test_OE -e 0 'IO_NUMBER can be redirection operand'
 > 1> 2< 2>>3 <<4
 4
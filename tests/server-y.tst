@@ -0,0 +1,103 @@
+# server-y.tst: yash-specific test of the server and client modes
+
+if ! testee --version --verbose | grep -Fqx ' * socket'; then
+    skip="true"
+fi
+
+cat >rcfile <<\__END__
+greet() { echo "hello, $1"; }
+__END__
+
+setup <<\__END__
+start_server() {
+    rm -f sock
+    "$TESTEE" --server=sock "$@" &
+    server=$!
+    # The socket file appears before the server starts listening on it.
+    while ! "$TESTEE" --client=sock -c : 2>/dev/null; do sleep 0; done
+}
+stop_server() {
+    kill $server
+    wait $server
+    rm -f sock
+}
+__END__
+
+test_oE 'client runs command string in server'
+start_server --norcfile
+"$TESTEE" --client=sock -c 'echo foo'
+stop_server
+__IN__
+foo
+__OUT__
+
+test_oE 'functions from initialization file are available'
+start_server --rcfile=rcfile
+"$TESTEE" --client=sock -c 'greet world'
+"$TESTEE" --client=sock -c 'greet again'
+stop_server
+__IN__
+hello, world
+hello, again
+__OUT__
+
+test_oE 'command name and positional parameters'
+start_server --norcfile
+"$TESTEE" --client=sock -c 'printf "[%s]\n" "$0" "$@"' name 1 '2  2'
+stop_server
+__IN__
+[name]
+[1]
+[2  2]
+__OUT__
+
+test_oE 'script file operand and standard input'
+start_server --norcfile
+echo 'read -r x; echo "read $x"' >script
+echo foo | "$TESTEE" --client=sock script
+echo 'echo from stdin' | "$TESTEE" --client=sock
+stop_server
+__IN__
+read foo
+from stdin
+__OUT__
+
+test_oE 'exit status is returned to client'
+start_server --norcfile
+"$TESTEE" --client=sock -c 'exit 3'
+echo $?
+"$TESTEE" --client=sock -c 'exec sh -c "exit 5"'
+echo $?
+stop_server
+__IN__
+3
+5
+__OUT__
+
+test_oE 'working directory and environment of client are used'
+start_server --norcfile
+mkdir -p dir
+(cd dir && FOO=bar "$TESTEE" --client=../sock -c 'echo "${PWD##*/}" $FOO')
+stop_server
+__IN__
+dir bar
+__OUT__
+
+test_oE 'clients do not affect each other'
+start_server --norcfile
+"$TESTEE" --client=sock -c 'x=1; f() { :; }'
+"$TESTEE" --client=sock -c 'echo "[${x-unset}]"; command -v f || echo no f'
+stop_server
+__IN__
+[unset]
+no f
+__OUT__
+
+test_O -e 1 'connecting to non-existing socket' \
+    --client=_no_such_socket_ -c 'echo foo'
+__IN__
+
+test_O -e 2 'server with operand' --server=sock foo
+__IN__
+
+# vim: set ft=sh ts=8 sts=4 sw=4 noet:
@@ -187,6 +187,7 @@ __IN__
 
 test_long_option_default_off "$LINENO" allexport
 test_long_option_default_off "$LINENO" braceexpand
+test_long_option_default_off "$LINENO" bytecode
 test_long_option_default_on  "$LINENO" caseglob
 test_long_option_default_on  "$LINENO" clobber
 test_long_option_default_on  "$LINENO" curasync
@@ -201,6 +202,8 @@ test_long_option_default_off "$LINENO" extendedglob
 test_long_option_default_on  "$LINENO" glob
 test_long_option_default_off "$LINENO" hashondef
 test_long_option_default_off "$LINENO" ignoreeof
+test_long_option_default_off "$LINENO" inlinesubshell
+test_long_option_default_off "$LINENO" lastpipe
 test_long_option_default_off "$LINENO" markdirs
 # The monitor option cannot be tested here due to dependency on the terminal.
 test_long_option_default_off "$LINENO" notify
@@ -395,10 +398,11 @@ set -o | grep -v '^histspace ' |
 grep -v '^le' | grep -v '^emacs ' | grep -v '^notifyle ' | grep -v '^vi '
 echo ---
 set -a +o caseglob -o dotglob
-set -o | head -n 9
+set -o | head -n 10
 __IN__
 allexport       off
 braceexpand     off
+bytecode        off
 caseglob        on
 clobber         on
 cmdline         off
@@ -415,7 +419,9 @@ forlocal        on
 glob            on
 hashondef       off
 ignoreeof       off
+inlinesubshell  off
 interactive     off
+lastpipe        off
 log             on
 login           off
 markdirs        off
@@ -432,6 +438,7 @@ xtrace          off
 ---
 allexport       on
 braceexpand     off
+bytecode        off
 caseglob        off
 clobber         on
 cmdline         off
@@ -459,6 +466,7 @@ grep -Fvx 'set +o vi'
 __IN__
 set +o allexport
 set +o braceexpand
+set +o bytecode
 set -o caseglob
 set -o clobber
 set -o curasync
@@ -474,6 +482,8 @@ set -o forlocal
 set -o glob
 set +o hashondef
 set +o ignoreeof
+set +o inlinesubshell
+set +o lastpipe
 set -o log
 set +o markdirs
 set +o monitor
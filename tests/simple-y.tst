@@ -9,6 +9,14 @@ __IN__
 [1-2-3][][1][2][3]
 __OUT__
 
+test_oE 'literal and expanded words are passed to external command'
+a='x y'
+env printf '[%s]' -v $a --color=never /usr/bin/foo "$a" a=b
+echo
+__IN__
+[-v][x][y][--color=never][/usr/bin/foo][x y][a=b]
+__OUT__
+
 test_oE 'assignment is exported during and after special built-in execution'
 a=1 eval 'sh -c "echo \$a"'
 sh -c "echo \$a"
@@ -33,6 +41,53 @@ __IN__
 1
 __OUT__
 
+test_oE 'function redefined in loop is found by same command'
+f() { echo 1; }
+for i in 1 2; do
+    f
+    f() { echo 2; }
+done
+__IN__
+1
+2
+__OUT__
+
+test_oE 'function defined in loop overrides built-in run by same command'
+for i in 1 2; do
+    echo $i
+    echo() { printf 'function %s\n' "$@"; }
+done
+__IN__
+1
+function 2
+__OUT__
+
+test_o -e 127 'substitutive built-in is not found after PATH is changed'
+for p in "$PATH" /_no_such_dir_; do
+    PATH=$p
+    echo $p >/dev/null && bracket ok
+done
+__IN__
+[ok]
+__OUT__
+
+test_o -e 127 'substitutive built-in is not found with temporary PATH'
+for p in "$PATH" /_no_such_dir_; do
+    PATH=$p echo ok
+done
+__IN__
+ok
+__OUT__
+
+test_o 'extension built-in is not found after POSIXly-correct mode is set'
+for i in 1 2; do
+    array a 1 && bracket ok
+    set -o posix
+done
+__IN__
+[ok]
+__OUT__
+
 test_O -d 'redirections do not apply to assignments w/o command name'
 readonly x=x
 x=y 2>/dev/null
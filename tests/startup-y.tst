@@ -520,7 +520,8 @@ __OUT__
 
 (
 if ! testee --version --verbose | grep -Fqx ' * help' ||
-    ! testee --version --verbose | grep -Fqx ' * lineedit'; then
+    ! testee --version --verbose | grep -Fqx ' * lineedit' ||
+    ! testee --version --verbose | grep -Fqx ' * socket'; then
     skip="true"
 fi
 
@@ -538,8 +539,11 @@ Options:
 	         --norcfile
 	         --profile=...
 	         --rcfile=...
+	         --server=...
+	         --client=...
 	-a       -o allexport
 	         -o braceexpand
+	         -o bytecode
 	         -o caseglob
 	+C       -o clobber
 	-c       -o cmdline
@@ -558,7 +562,9 @@ Options:
 	-h       -o hashondef
 	         -o histspace
 	         -o ignoreeof
+	         -o inlinesubshell
 	-i       -o interactive
+	         -o lastpipe
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
@@ -599,6 +605,7 @@ Syntax:
 Options:
 	-a       -o allexport
 	         -o braceexpand
+	         -o bytecode
 	         -o caseglob
 	+C       -o clobber
 	-c       -o cmdline
@@ -617,7 +624,9 @@ Options:
 	-h       -o hashondef
 	         -o histspace
 	         -o ignoreeof
+	         -o inlinesubshell
 	-i       -o interactive
+	         -o lastpipe
 	         -o lealwaysrp
 	         -o lecompdebug
 	         -o leconvmeta
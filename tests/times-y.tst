@@ -1,5 +1,23 @@
 # times-y.tst: yash-specific test of the times built-in
 
+test_oE 'counting child processes'
+times -c >before
+env true
+times -c >after
+{ read -r _ f1; read -r _ s1; } <before
+{ read -r _ f2; read -r _ s2; } <after
+echo $((f2 + s2 - f1 - s1))
+__IN__
+1
+__OUT__
+
+test_oE 'counting child processes (long option)'
+times --count | cut -d ' ' -f 1
+__IN__
+fork
+spawn
+__OUT__
+
 test_Oe -e 2 'too many operands'
 times foo
 __IN__
@@ -66,6 +66,85 @@ wait
 wait $pid
 __IN__
 
+test_x -e 17 'wait -n returns exit status of finished job'
+(cat sync; exit 17) &
+: >sync
+wait -n
+__IN__
+
+test_oE -e 0 'wait -n waits for any one job'
+exit 3 &
+(cat sync; exit 5) &
+wait -n
+echo $?
+: >sync
+wait -n
+echo $?
+__IN__
+3
+5
+__OUT__
+
+test_x -e 127 'wait -n without jobs'
+wait -n
+__IN__
+
+test_oE -e 0 'wait -p assigns process ID of finished job'
+exit 4 &
+pid=$!
+wait -n -p finished
+echo $? $((finished == pid))
+__IN__
+4 1
+__OUT__
+
+test_oE -e 0 'wait -l returns immediately if fewer jobs are running'
+cat sync &
+finished=X
+wait -l 2 -p finished
+echo $? "[$finished]"
+: >sync
+wait -l 1 -p finished
+echo $? $((finished == $!))
+__IN__
+0 []
+0 1
+__OUT__
+
+test_oE -e 0 'wait -l waits for job if as many jobs are running'
+exit 1 &
+pid=$!
+cat sync &
+wait -l 2 -p finished
+echo $? $((finished == pid))
+: >sync
+wait
+__IN__
+1 1
+__OUT__
+
+test_Oe -e 2 'non-positive limit for -l'
+wait -l 0
+__IN__
+wait: `0' is not a positive integer
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'non-numeric limit for -l'
+wait -l x
+__IN__
+wait: `x' is not a valid integer
+__ERR__
+#'
+#`
+
+test_Oe -e 2 'operand with -n'
+wait -n %1
+__IN__
+wait: no operand is expected
+__ERR__
+
 test_Oe -e 2 'invalid option --xxx'
 wait --no-such=option
 __IN__
@@ -45,6 +45,17 @@ int xunsetenv(const char *name)
 
 /********** Memory Functions **********/
 
+//#define DEBUG_ARENA 1
+/* If DEBUG_ARENA is defined non-zero, the calls to `xcalloc', `xmalloc' and
+ * `xrealloc' (including their variants) are counted so that the statistics of
+ * the word expansion arena can report them (see arena.h). */
+#if DEBUG_ARENA
+extern unsigned long xmalloc_count, xrealloc_count;
+# define COUNT_ALLOC(counter) ((void) (counter)++)
+#else
+# define COUNT_ALLOC(counter) ((void) 0)
+#endif
+
 static inline size_t add(size_t a, size_t b)
     __attribute__((pure));
 static inline size_t mul(size_t a, size_t b)
@@ -96,6 +107,7 @@ size_t mul(size_t a, size_t b)
 /* Attempts `calloc' and aborts the program on failure. */
 void *xcalloc(size_t nmemb, size_t size)
 {
+    COUNT_ALLOC(xmalloc_count);
     void *result = calloc(nmemb, size);
     if (result == NULL && nmemb > 0 && size > 0)
 	alloc_failed();
@@ -105,6 +117,7 @@ void *xcalloc(size_t nmemb, size_t size)
 /* Attempts `malloc' and aborts the program on failure. */
 void *xmalloc(size_t size)
 {
+    COUNT_ALLOC(xmalloc_count);
     void *result = malloc(size);
     if (result == NULL && size > 0)
 	alloc_failed();
@@ -147,6 +160,7 @@ void *xrealloc(void *ptr, size_t size)
 	return NULL;
     }
 
+    COUNT_ALLOC(xrealloc_count);
     void *result = realloc(ptr, size);
     if (result == NULL)
 	alloc_failed();
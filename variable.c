@@ -72,6 +72,7 @@ typedef struct environ_T {
     struct hashtable_T contents;   /* hashtable containing variables */
     bool is_temporary;             /* for temporary assignment? */
     char **paths[PA_count];
+    kvpair_T spare_positional;     /* positional parameters for reuse */
 } environ_T;
 /* `contents' is a hashtable from (wchar_t *) to (variable_T *).
  * A variable name may contain any characters except L'\0' and L'=', though
@@ -83,7 +84,11 @@ typedef struct environ_T {
  * An environment whose `is_temporary' is true is used for temporary variables. 
  * The elements of `paths' are arrays of the pathnames contained in the
  * $PATH, $CDPATH and $YASH_LOADPATH variables. They are NULL if the
- * corresponding variables are not set. */
+ * corresponding variables are not set.
+ * `spare_positional' is the key and the (empty) variable of the positional
+ * parameters that were removed when the environment was closed. They are put
+ * back when the environment is reused for a function call so that
+ * `set_positional_parameters' does not have to allocate them again. */
 #define VAR_positional "="
 
 /* flags for variable attributes */
@@ -138,6 +143,10 @@ static variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     __attribute__((pure,nonnull));
 static void update_environment(const wchar_t *name)
     __attribute__((nonnull));
+static bool is_libc_variable(const wchar_t *name)
+    __attribute__((nonnull,pure));
+static char *get_exported_value_of(const variable_T *var)
+    __attribute__((nonnull,malloc,warn_unused_result));
 static void reset_locale(const wchar_t *name)
     __attribute__((nonnull));
 static void reset_locale_category(const wchar_t *name, int category)
@@ -169,6 +178,9 @@ static unsigned next_random(void);
 static void variable_set(const wchar_t *name, variable_T *var)
     __attribute__((nonnull(1)));
 
+static variable_T *copy_variable(const variable_T *var)
+    __attribute__((nonnull,malloc,warn_unused_result));
+
 static char **convert_path_array(void **ary)
     __attribute__((malloc,warn_unused_result));
 static void add_to_list_no_dup(plist_T *list, char *s)
@@ -193,9 +205,31 @@ static environ_T *first_env;
 /* whether $RANDOM is functioning as a random number */
 static bool random_active;
 
+/* closed environments kept for reuse, linked by the `parent' member */
+static environ_T *env_pool;
+/* number of environments in `env_pool' */
+static size_t env_pool_count;
+/* maximum number of environments kept in `env_pool' */
+#define ENV_POOL_MAX 16
+/* maximum capacity of the hashtable of an environment kept in `env_pool' */
+#define ENV_POOL_MAX_CAPACITY 64
+
 /* hashtable from function names (wchar_t *) to functions (function_T *). */
 static hashtable_T functions;
 
+/* The generation number of the exported variables, incremented whenever an
+ * exported variable may have been changed. */
+static unsigned long export_generation = 1;
+/* The array of environment variables passed to external commands, made from
+ * the exported variables by `get_environment' and the value of
+ * `export_generation' when it was made. */
+static char **envp;
+static unsigned long envp_generation = 0;
+/* The environment variables inherited from the invoker of the shell that
+ * cannot be converted to variables. They are always passed to external
+ * commands. */
+static plist_T unconvertible_environ;
+
 
 /* Frees the value of the specified variable (but not the variable itself). */
 /* This function does not change the value of `*v'. */
@@ -256,10 +290,13 @@ void init_environment(void)
     ht_init(&functions, hashwcs, htwcscmp);
 
     /* add all the existing environment variables to the variable environment */
+    pl_init(&unconvertible_environ);
     for (char **e = environ; *e != NULL; e++) {
 	wchar_t *we = malloc_mbstowcs(*e);
-	if (we == NULL)
+	if (we == NULL) {
+	    pl_add(&unconvertible_environ, xstrdup(*e));
 	    continue;
+	}
 
 	wchar_t *eqp = wcschr(we, L'=');
 	variable_T *v = xmalloc(sizeof *v);
@@ -408,10 +445,18 @@ variable_T *search_array_and_check_if_changeable(const wchar_t *name)
     return array;
 }
 
-/* Update the value in `environ' for the variable with the specified name.
- * `name' must not contain '='. */
+/* Notifies that the exported value of the variable with the specified name
+ * may have been changed. The array returned by `get_environment' will be
+ * re-made when it is next requested.
+ * If the variable may affect the C library, the value in `environ' is also
+ * updated. An empty name is also passed to `setenv' so that it is rejected
+ * with an error message. `name' must not contain '='. */
 void update_environment(const wchar_t *name)
 {
+    export_generation++;
+    if (name[0] != L'\0' && !is_libc_variable(name))
+	return;
+
     char *mname = malloc_wcstombs(name);
     if (mname == NULL)
 	return;
@@ -430,6 +475,29 @@ void update_environment(const wchar_t *name)
     free(value);
 }
 
+/* Checks if the specified variable may affect the behavior of the C library
+ * functions called in the shell process. Such variables are kept up to date in
+ * `environ' while the others are only passed to external commands. */
+bool is_libc_variable(const wchar_t *name)
+{
+    switch (name[0]) {
+	case L'C':
+	    return wcscmp(name, L VAR_COLUMNS) == 0;
+	case L'L':
+	    return wcsncmp(name, L"LC_", 3) == 0
+		|| wcscmp(name, L VAR_LANG) == 0
+		|| wcscmp(name, L"LANGUAGE") == 0
+		|| wcscmp(name, L VAR_LINES) == 0;
+	case L'N':
+	    return wcscmp(name, L VAR_NLSPATH) == 0;
+	case L'T':
+	    return wcsncmp(name, L VAR_TERM, 4) == 0  /* TERM, TERMINFO, ... */
+		|| wcscmp(name, L"TZ") == 0;
+	default:
+	    return false;
+    }
+}
+
 /* Returns the value of variable `name' that should be exported.
  * If the variable is not exported or the variable value cannot be converted to
  * a multibyte string, NULL is returned. */
@@ -438,21 +506,80 @@ char *get_exported_value(const wchar_t *name)
     for (environ_T *env = current_env; env != NULL; env = env->parent) {
 	const variable_T *var = ht_get(&env->contents, name).value;
 	if (var != NULL && (var->v_type & VF_EXPORT)) {
-	    switch (var->v_type & VF_MASK) {
-		case VF_SCALAR:
-		    if (var->v_value == NULL)
-			continue;
-		    return malloc_wcstombs(var->v_value);
-		case VF_ARRAY:
-		    return realloc_wcstombs(joinwcsarray(var->v_vals, L":"));
-		default:
-		    assert(false);
-	    }
+	    if ((var->v_type & VF_MASK) == VF_SCALAR && var->v_value == NULL)
+		continue;
+	    return get_exported_value_of(var);
 	}
     }
     return NULL;
 }
 
+/* Converts the value of the specified variable to a newly-malloced multibyte
+ * string. Returns NULL if the value is not set or cannot be converted. */
+char *get_exported_value_of(const variable_T *var)
+{
+    switch (var->v_type & VF_MASK) {
+	case VF_SCALAR:
+	    if (var->v_value == NULL)
+		return NULL;
+	    return malloc_wcstombs(var->v_value);
+	case VF_ARRAY:
+	    return realloc_wcstombs(joinwcsarray(var->v_vals, L":"));
+    }
+    assert(false);
+    return NULL;
+}
+
+/* Returns an array of environment variables that should be passed to external
+ * commands. The array is made from the exported variables when this function
+ * is called for the first time after any exported variable was changed, and is
+ * reused until then. The returned array must not be modified or freed by the
+ * caller and is valid until this function is called again. */
+char **get_environment(void)
+{
+    if (envp != NULL && envp_generation == export_generation)
+	return envp;
+
+    plfree((void **) envp, free);
+
+    plist_T list;
+    hashtable_T names;
+    pl_initwithmax(&list, unconvertible_environ.length + 50);
+    ht_init(&names, hashwcs, htwcscmp);
+
+    for (environ_T *env = current_env; env != NULL; env = env->parent) {
+	size_t i = 0;
+	kvpair_T kv;
+	while ((kv = ht_next(&env->contents, &i)).key != NULL) {
+	    const wchar_t *name = kv.key;
+	    const variable_T *var = kv.value;
+	    if (!(var->v_type & VF_EXPORT) || name[0] == L'\0')
+		continue;
+	    if ((var->v_type & VF_MASK) == VF_SCALAR && var->v_value == NULL)
+		continue;
+	    if (ht_get(&names, name).key != NULL)
+		continue;  /* shadowed by a variable in an inner environment */
+	    ht_set(&names, name, NULL);
+
+	    char *value = get_exported_value_of(var);
+	    if (value != NULL) {
+		char *entry = malloc_printf("%ls=%s", name, value);
+		if (entry != NULL)
+		    pl_add(&list, entry);
+		free(value);
+	    }
+	}
+    }
+    ht_destroy(&names);
+
+    for (size_t i = 0; i < unconvertible_environ.length; i++)
+	pl_add(&list, xstrdup(unconvertible_environ.contents[i]));
+
+    envp = (char **) pl_toary(&list);
+    envp_generation = export_generation;
+    return envp;
+}
+
 /* Resets the locate settings for the specified variable.
  * If `name' is not any of "LANG", "LC_ALL", etc., does nothing. */
 void reset_locale(const wchar_t *name)
@@ -990,13 +1117,28 @@ void get_all_variables_rec(hashtable_T *table, environ_T *env, bool global)
 /* Don't forget to call `set_positional_parameters'! */
 void open_new_environment(bool temp)
 {
-    environ_T *newenv = xmalloc(sizeof *newenv);
+    environ_T *newenv;
+
+    if (env_pool != NULL) {
+	/* reuse a closed environment, whose hashtable is empty */
+	newenv = env_pool;
+	env_pool = newenv->parent;
+	env_pool_count--;
+	if (!temp && newenv->spare_positional.key != NULL) {
+	    ht_set(&newenv->contents, newenv->spare_positional.key,
+		    newenv->spare_positional.value);
+	    newenv->spare_positional = (kvpair_T) { NULL, NULL };
+	}
+    } else {
+	newenv = xmalloc(sizeof *newenv);
+	ht_init(&newenv->contents, hashwcs, htwcscmp);
+	for (size_t i = 0; i < PA_count; i++)
+	    newenv->paths[i] = NULL;
+	newenv->spare_positional = (kvpair_T) { NULL, NULL };
+    }
 
     newenv->parent = current_env;
     newenv->is_temporary = temp;
-    ht_init(&newenv->contents, hashwcs, htwcscmp);
-    for (size_t i = 0; i < PA_count; i++)
-	newenv->paths[i] = NULL;
     current_env = newenv;
 }
 
@@ -1008,11 +1150,218 @@ void close_current_environment(void)
 
     assert(oldenv != first_env);
     current_env = oldenv->parent;
+    if (ht_get(&oldenv->contents, L VAR_PATH).value != NULL)
+	cmdsearch_generation++;
+    if (oldenv->spare_positional.key == NULL) {
+	kvpair_T kv = ht_remove(&oldenv->contents, L VAR_positional);
+	if (kv.key != NULL) {
+	    variable_T *var = kv.value;
+	    varvaluefree(var);
+	    var->v_type = VF_SCALAR;
+	    var->v_value = NULL;
+	    var->v_getter = NULL;
+	    oldenv->spare_positional = kv;
+	}
+    }
     ht_clear(&oldenv->contents, varkvfree_reexport);
-    ht_destroy(&oldenv->contents);
-    for (size_t i = 0; i < PA_count; i++)
+    for (size_t i = 0; i < PA_count; i++) {
 	plfree((void **) oldenv->paths[i], free);
-    free(oldenv);
+	oldenv->paths[i] = NULL;
+    }
+
+    if (env_pool_count < ENV_POOL_MAX
+	    && oldenv->contents.capacity <= ENV_POOL_MAX_CAPACITY) {
+	oldenv->parent = env_pool;
+	env_pool = oldenv;
+	env_pool_count++;
+    } else {
+	varkvfree(oldenv->spare_positional);
+	ht_destroy(&oldenv->contents);
+	free(oldenv);
+    }
+}
+
+/* Moves the variables in the current environment to its parent, replacing
+ * variables of the same names in the parent. The positional parameters of the
+ * current environment are removed, so `set_positional_parameters' must be
+ * called after this function.
+ * This function is used to reuse the environment of a function for a tail
+ * call: the local variables of the calling functions are kept in the parent
+ * environment so that the called function can see them. */
+void merge_current_environment(void)
+{
+    environ_T *env = current_env, *parent = env->parent;
+    assert(parent != NULL);
+    assert(!env->is_temporary);
+
+    for (size_t i = 0; i < PA_count; i++) {
+	if (ht_get(&env->contents, path_variables[i]).value != NULL) {
+	    plfree((void **) parent->paths[i], free);
+	    parent->paths[i] = env->paths[i];
+	    env->paths[i] = NULL;
+	}
+    }
+
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&env->contents, &i)).key != NULL) {
+	if (wcscmp(kv.key, L VAR_positional) == 0)
+	    varkvfree(kv);
+	else
+	    varkvfree(ht_set(&parent->contents, kv.key, kv.value));
+    }
+    ht_clear(&env->contents, NULL);
+
+    export_generation++;
+}
+
+
+/********** Saving and Restoring Variables **********/
+
+/* saved binding of a variable in an environment */
+struct savedvar_T {
+    struct savedvar_T *next;
+    environ_T *env;    /* the environment that contained the binding */
+    wchar_t *name;     /* the name of the variable */
+    variable_T *var;   /* copy of the variable, or NULL if not bound */
+};
+
+/* Returns true if the variable with the specified name exists and is read-
+ * only. */
+bool is_readonly_variable(const wchar_t *name)
+{
+    const variable_T *var = search_variable(name);
+    return var != NULL && (var->v_type & VF_READONLY);
+}
+
+/* Returns true if the variable with the specified name exists and has a
+ * getter, which may change the state of the shell when the value is read. */
+bool is_variable_with_getter(const wchar_t *name)
+{
+    const variable_T *var = search_variable(name);
+    return var != NULL && var->v_getter != NULL;
+}
+
+/* Saves the current state of the variables with the specified names so that
+ * they can be restored by `restore_variables'.
+ * `names' is a NULL-terminated array of pointers to wide strings.
+ * The bindings in all the environments from the current to the top-level are
+ * saved, so the variables are restored correctly even if they are unset and
+ * then reassigned in another scope. */
+struct savedvar_T *save_variables(void *const *names)
+{
+    struct savedvar_T *saved = NULL;
+    for (; *names != NULL; names++) {
+	for (environ_T *env = current_env; env != NULL; env = env->parent) {
+	    struct savedvar_T *s = xmalloc(sizeof *s);
+	    const variable_T *var = ht_get(&env->contents, *names).value;
+	    s->next = saved;
+	    s->env = env;
+	    s->name = xwcsdup(*names);
+	    s->var = (var != NULL) ? copy_variable(var) : NULL;
+	    saved = s;
+	}
+    }
+    return saved;
+}
+
+/* Restores the variables saved by `save_variables' and frees `saved'.
+ * The current environment must be the same as when the variables were saved. */
+void restore_variables(struct savedvar_T *saved)
+{
+    bool exported = false;
+    while (saved != NULL) {
+	struct savedvar_T *next = saved->next;
+
+	kvpair_T kv = ht_remove(&saved->env->contents, saved->name);
+	if (kv.value != NULL && (((variable_T *) kv.value)->v_type & VF_EXPORT))
+	    exported = true;
+	varkvfree(kv);
+	if (saved->var != NULL) {
+	    if (saved->var->v_type & VF_EXPORT)
+		exported = true;
+	    ht_set(&saved->env->contents, xwcsdup(saved->name), saved->var);
+	}
+
+	/* The bindings of each name are saved from the current environment
+	 * toward the top-level, so the current one is restored last. */
+	if (saved->env == current_env) {
+	    variable_set(saved->name, search_variable(saved->name));
+	    if (exported)
+		update_environment(saved->name);
+	    exported = false;
+	}
+
+	free(saved->name);
+	free(saved);
+	saved = next;
+    }
+}
+
+/* Saves all the variables in the top-level environment so that they can be
+ * restored by `restore_global_variables'.
+ * The current environment must be the top-level. */
+struct savedvar_T *save_global_variables(void)
+{
+    assert(current_env == first_env);
+
+    plist_T names;
+    pl_init(&names);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&first_env->contents, &i)).key != NULL)
+	pl_add(&names, kv.key);
+
+    struct savedvar_T *saved = save_variables(names.contents);
+    pl_destroy(&names);
+    return saved;
+}
+
+/* Restores the variables saved by `save_global_variables' and frees `saved'.
+ * Variables that have been created in the top-level environment since they
+ * were saved are removed, even if they are read-only.
+ * The current environment must be the top-level. */
+void restore_global_variables(struct savedvar_T *saved)
+{
+    assert(current_env == first_env);
+
+    hashtable_T savednames;
+    ht_init(&savednames, hashwcs, htwcscmp);
+    for (const struct savedvar_T *s = saved; s != NULL; s = s->next)
+	ht_set(&savednames, s->name, NULL);
+
+    plist_T newnames;
+    pl_init(&newnames);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&first_env->contents, &i)).key != NULL)
+	if (ht_get(&savednames, kv.key).key == NULL)
+	    pl_add(&newnames, xwcsdup(kv.key));
+    ht_destroy(&savednames);
+
+    for (i = 0; i < newnames.length; i++)
+	varkvfree_reexport(
+		ht_remove(&first_env->contents, newnames.contents[i]));
+    plfree(pl_toary(&newnames), free);
+
+    restore_variables(saved);
+}
+
+/* Returns a newly malloced copy of the specified variable. */
+variable_T *copy_variable(const variable_T *var)
+{
+    variable_T *copy = xmalloc(sizeof *copy);
+    *copy = *var;
+    switch (var->v_type & VF_MASK) {
+	case VF_SCALAR:
+	    if (var->v_value != NULL)
+		copy->v_value = xwcsdup(var->v_value);
+	    break;
+	case VF_ARRAY:
+	    copy->v_vals = pldup(var->v_vals, copyaswcs);
+	    break;
+    }
+    return copy;
 }
 
 
@@ -1268,9 +1617,37 @@ bool define_function(const wchar_t *name, command_T *body)
     if (shopt_hashondef)
 	hash_all_commands_recursively(body);
     funckvfree(ht_set(&functions, xwcsdup(name), f));
+    cmdsearch_generation++;
     return true;
 }
 
+/* Saves all the functions so that they can be restored by
+ * `restore_functions'. */
+hashtable_T *save_functions(void)
+{
+    hashtable_T *saved = ht_init(xmalloc(sizeof *saved), hashwcs, htwcscmp);
+    size_t i = 0;
+    kvpair_T kv;
+    while ((kv = ht_next(&functions, &i)).key != NULL) {
+	const function_T *f = kv.value;
+	function_T *copy = xmalloc(sizeof *copy);
+	copy->f_type = f->f_type;
+	copy->f_body = comsdup(f->f_body);
+	ht_set(saved, xwcsdup(kv.key), copy);
+    }
+    return saved;
+}
+
+/* Replaces all the functions with the ones saved by `save_functions' and frees
+ * `saved'. Read-only functions are also replaced. */
+void restore_functions(hashtable_T *saved)
+{
+    ht_destroy(ht_clear(&functions, funckvfree));
+    functions = *saved;
+    free(saved);
+    cmdsearch_generation++;
+}
+
 /* Gets the body of the function with the specified name.
  * Returns NULL if there is no such a function. */
 command_T *get_function(const wchar_t *name)
@@ -1314,6 +1691,9 @@ void hash_all_commands_recursively(const command_T *c)
 #endif
 	    case CT_FUNCDEF:
 		break;
+	    case CT_COPROC:
+		hash_all_commands_recursively(c->c_cocmd);
+		break;
 	}
     }
 }
@@ -2346,6 +2726,7 @@ bool unset_function(const wchar_t *name)
     if (f != NULL) {
 	if (!(f->f_type & VF_NODELETE)) {
 	    funckvfree(kv);
+	    cmdsearch_generation++;
 	} else {
 	    xerror(0, Ngt("function `%ls' is read-only"), name);
 	    ht_set(&functions, kv.key, kv.value);
@@ -70,6 +70,7 @@ extern char **environ;
 #define VAR_YASH_AFTER_CD             "YASH_AFTER_CD"
 #define VAR_YASH_LE_TIMEOUT           "YASH_LE_TIMEOUT"
 #define VAR_YASH_LOADPATH             "YASH_LOADPATH"
+#define VAR_YASH_PIPE_SIZE            "YASH_PIPE_SIZE"
 #define VAR_YASH_VERSION              "YASH_VERSION"
 #define L                             L""
 
@@ -87,6 +88,8 @@ extern void init_variables(void);
 
 extern char *get_exported_value(const wchar_t *name)
     __attribute__((nonnull,malloc,warn_unused_result));
+extern char **get_environment(void)
+    __attribute__((warn_unused_result));
 
 typedef enum scope_T {
     SCOPE_GLOBAL, SCOPE_LOCAL, SCOPE_TEMP,
@@ -121,6 +124,19 @@ extern void save_get_variable_values(struct get_variable_T *gv)
 
 extern void open_new_environment(_Bool temp);
 extern void close_current_environment(void);
+extern void merge_current_environment(void);
+
+struct savedvar_T;
+extern _Bool is_readonly_variable(const wchar_t *name)
+    __attribute__((nonnull,pure));
+extern _Bool is_variable_with_getter(const wchar_t *name)
+    __attribute__((nonnull,pure));
+extern struct savedvar_T *save_variables(void *const *names)
+    __attribute__((nonnull,warn_unused_result));
+extern void restore_variables(struct savedvar_T *saved);
+extern struct savedvar_T *save_global_variables(void)
+    __attribute__((warn_unused_result));
+extern void restore_global_variables(struct savedvar_T *saved);
 
 extern void update_lineno(unsigned long lineno);
 
@@ -132,6 +148,11 @@ extern _Bool define_function(const wchar_t *name, struct command_T *body)
     __attribute__((nonnull));
 extern struct command_T *get_function(const wchar_t *name)
     __attribute__((nonnull));
+struct hashtable_T;
+extern struct hashtable_T *save_functions(void)
+    __attribute__((malloc,warn_unused_result));
+extern void restore_functions(struct hashtable_T *saved)
+    __attribute__((nonnull));
 
 #if YASH_ENABLE_DIRSTACK
 extern _Bool parse_dirstack_index(
@@ -45,6 +45,9 @@
 #include "parser.h"
 #include "path.h"
 #include "redir.h"
+#if YASH_ENABLE_SOCKET
+# include "server.h"
+#endif
 #include "sig.h"
 #include "strbuf.h"
 #include "util.h"
@@ -53,6 +56,15 @@
 
 extern int main(int argc, char **argv)
     __attribute__((nonnull));
+static void convert_arguments(int argc, char **argv, void **wargv)
+    __attribute__((nonnull));
+#if YASH_ENABLE_SOCKET
+static void start_server(struct shell_invocation_T *options, void **wargv)
+    __attribute__((nonnull));
+#endif
+static void start_shell(int argc, char **argv, void **wargv,
+	const struct shell_invocation_T *options)
+    __attribute__((nonnull,noreturn));
 static struct input_file_info_T *new_input_file_info(int fd, size_t bufsize)
     __attribute__((malloc,warn_unused_result));
 static void execute_profile(const wchar_t *profile);
@@ -104,21 +116,7 @@ int main(int argc, char **argv)
     textdomain(PACKAGE_NAME);
 #endif
 
-    /* convert arguments into wide strings */
-    for (int i = 0; i < argc; i++) {
-	wargv[i] = malloc_mbstowcs(argv[i]);
-	if (wargv[i] == NULL) {
-	    fprintf(stderr,
-		    gt("%s: cannot convert the argument `%s' "
-			"into a wide character string"),
-		    argv[0], argv[i]);
-	    fprintf(stderr,
-		    gt("%s: the argument is replaced with an empty string\n"),
-		    argv[0]);
-	    wargv[i] = xwcsdup(L"");
-	}
-    }
-    wargv[argc] = NULL;
+    convert_arguments(argc, argv, wargv);
 
     /* parse argv[0] */
     yash_program_invocation_name = wargv[0] != NULL ? wargv[0] : L"";
@@ -136,6 +134,41 @@ int main(int argc, char **argv)
     if (wcscmp(shortest_name, L"sh") == 0)
 	posixly_correct = true;
 
+    init_shell();
+
+    struct shell_invocation_T options = {
+	.profile = NULL, .rcfile = NULL,
+    };
+
+    int optresult = parse_shell_options(argc, wargv, &options);
+    if (optresult != Exit_SUCCESS)
+	exit(optresult);
+    if (options.version)
+	print_version();
+    if (options.help)
+	print_help();
+    if (options.version || options.help)
+	exit(yash_error_message_count == 0 ? Exit_SUCCESS : Exit_FAILURE);
+
+#if YASH_ENABLE_SOCKET
+    if (options.client != NULL)
+	exit(run_client(options.client, argv));
+#endif
+
+    init_variables();
+
+#if YASH_ENABLE_SOCKET
+    if (options.server != NULL)
+	start_server(&options, wargv);
+#endif
+
+    start_shell(argc, argv, wargv, &options);
+}
+
+/* Initializes the internal state of the shell that does not depend on the
+ * invocation options. This function must be called only once. */
+void init_shell(void)
+{
     shell_pid = getpid();
     shell_pgid = getpgrp();
     stdin_input_file_info = new_input_file_info(STDIN_FILENO, 1);
@@ -147,23 +180,85 @@ int main(int argc, char **argv)
     init_job();
     init_builtin();
     init_alias();
+}
 
-    struct shell_invocation_T options = {
+/* Converts the arguments into wide strings.
+ * `wargv' must have room for `argc + 1' elements. */
+void convert_arguments(int argc, char **argv, void **wargv)
+{
+    for (int i = 0; i < argc; i++) {
+	wargv[i] = malloc_mbstowcs(argv[i]);
+	if (wargv[i] == NULL) {
+	    fprintf(stderr,
+		    gt("%s: cannot convert the argument `%s' "
+			"into a wide character string"),
+		    argv[0], argv[i]);
+	    fprintf(stderr,
+		    gt("%s: the argument is replaced with an empty string\n"),
+		    argv[0]);
+	    wargv[i] = xwcsdup(L"");
+	}
+    }
+    wargv[argc] = NULL;
+}
+
+#if YASH_ENABLE_SOCKET
+
+/* Initializes the shell and then serves clients as a server.
+ * This function returns only in a child process that serves a client, in which
+ * case the shell starts over with the client's arguments as if it were newly
+ * invoked. The initialization files are not read again and the shell is never
+ * interactive in the child. */
+void start_server(struct shell_invocation_T *options, void **wargv)
+{
+    if (wargv[xoptind] != NULL) {
+	xerror(0, Ngt("no operand is expected"));
+	exit(Exit_ERROR);
+    }
+
+    set_signals();
+    set_positional_parameters(&wargv[xoptind]);
+    if (getuid() == geteuid() && getgid() == getegid()) {
+	if (is_login_shell && !posixly_correct && !options->noprofile)
+	    execute_profile(options->profile);
+	if (!options->norcfile)
+	    execute_rcfile(options->rcfile);
+    }
+
+    shell_initialized = true;
+
+    int argc;
+    char **argv;
+    if (!serve(options->server, &argc, &argv))
+	exit(Exit_FAILURE);
+
+    /* Now we are in the child process serving the client. */
+    wargv = xmallocn(argc + 1, sizeof *wargv);
+    convert_arguments(argc, argv, wargv);
+    command_name = argc > 0 ? wargv[0] : L"";
+
+    struct shell_invocation_T clientoptions = {
 	.profile = NULL, .rcfile = NULL,
     };
-
-    int optresult = parse_shell_options(argc, wargv, &options);
+    shopt_cmdline = shopt_stdin = false;
+    laststatus = Exit_SUCCESS;
+    int optresult = parse_shell_options(argc, wargv, &clientoptions);
     if (optresult != Exit_SUCCESS)
 	exit(optresult);
-    if (options.version)
-	print_version();
-    if (options.help)
-	print_help();
-    if (options.version || options.help)
-	exit(yash_error_message_count == 0 ? Exit_SUCCESS : Exit_FAILURE);
+    clientoptions.noprofile = clientoptions.norcfile = true;
+    clientoptions.is_interactive_set = clientoptions.do_job_control_set = true;
+    is_interactive = do_job_control = false;
 
-    init_variables();
+    start_shell(argc, argv, wargv, &clientoptions);
+}
 
+#endif /* YASH_ENABLE_SOCKET */
+
+/* Starts executing commands as specified by the arguments and options.
+ * `xoptind' must be the index of the first operand in `argv'. */
+void start_shell(int argc, char **argv, void **wargv,
+	const struct shell_invocation_T *options)
+{
     union {
 	wchar_t *command;
 	int fd;
@@ -192,7 +287,7 @@ int main(int argc, char **argv)
 	if (shopt_stdin) {
 	    input.fd = STDIN_FILENO;
 	    inputname = NULL;
-	    if (!options.is_interactive_set && argc == xoptind
+	    if (!options->is_interactive_set && argc == xoptind
 		    && isatty(STDIN_FILENO) && isatty(STDERR_FILENO))
 		is_interactive = true;
 	    unset_nonblocking(STDIN_FILENO);
@@ -211,13 +306,13 @@ int main(int argc, char **argv)
 
 #if YASH_ENABLE_LINEEDIT
     /* enable line editing if interactive and connected to a terminal */
-    if (!options.lineedit_set && shopt_lineedit == SHOPT_NOLINEEDIT)
+    if (!options->lineedit_set && shopt_lineedit == SHOPT_NOLINEEDIT)
 	if (is_interactive && isatty(STDIN_FILENO) && isatty(STDERR_FILENO))
 	    set_lineedit_option(SHOPT_VI);
 #endif
 
     is_interactive_now = is_interactive;
-    if (!options.do_job_control_set)
+    if (!options->do_job_control_set)
 	do_job_control = is_interactive;
     if (do_job_control) {
 	open_ttyfd();
@@ -227,12 +322,12 @@ int main(int argc, char **argv)
     set_signals();
     set_positional_parameters(&wargv[xoptind]);
 
-    if (is_login_shell && !posixly_correct && !options.noprofile)
+    if (is_login_shell && !posixly_correct && !options->noprofile)
 	if (getuid() == geteuid() && getgid() == getegid())
-	    execute_profile(options.profile);
-    if (is_interactive && !options.norcfile)
+	    execute_profile(options->profile);
+    if (is_interactive && !options->norcfile)
 	if (getuid() == geteuid() && getgid() == getegid())
-	    execute_rcfile(options.rcfile);
+	    execute_rcfile(options->rcfile);
 
     shell_initialized = true;
 
@@ -243,6 +338,7 @@ int main(int argc, char **argv)
 		(is_interactive ? XIO_INTERACTIVE : 0));
 
     assert(false);
+    exit_shell();
 }
 
 struct input_file_info_T *new_input_file_info(int fd, size_t bufsize)
@@ -550,7 +646,8 @@ void parse_and_exec(parseparam_T *pinfo, bool finally_exit)
 		}
 		break;
 	    case PR_SYNTAX_ERROR:
-		if (shell_initialized && !is_interactive_now)
+		if (shell_initialized && !is_interactive_now
+			&& !exit_inline_subshell(Exit_SYNERROR))
 		    exit_shell_with_status(Exit_SYNERROR);
 		if (!pinfo->interactive) {
 		    laststatus = Exit_SYNERROR;
@@ -590,7 +687,8 @@ const struct xgetopt_T force_help_options[] = {
 
 /* The "exit" built-in.
  * If the shell is interactive, there are stopped jobs and the -f flag is not
- * specified, then prints a warning message and does not exit. */
+ * specified, then prints a warning message and does not exit.
+ * In a subshell executed in the shell process, only the subshell is exited. */
 int exit_builtin(int argc, void **argv)
 {
     const struct xgetopt_T *opt;
@@ -613,7 +711,8 @@ int exit_builtin(int argc, void **argv)
 	return special_builtin_error(Exit_ERROR);
 
     size_t sjc;
-    if (is_interactive_now && !forceexit && (sjc = stopped_job_count()) > 0) {
+    if (is_interactive_now && !forceexit && !is_in_inline_subshell()
+	    && (sjc = stopped_job_count()) > 0) {
 	fprintf(stderr,
 		ngt("You have a stopped job!",
 		    "You have %zu stopped jobs!",
@@ -635,6 +734,8 @@ int exit_builtin(int argc, void **argv)
     } else {
 	status = -1;
     }
+    if (exit_inline_subshell(status))
+	return laststatus;
     exit_shell_with_status(status);
     assert(false);
 }